@@ -0,0 +1,44 @@
+/*
+ * The arena interface hands out memory from large chunks that are all
+ * released together, for data that lives exactly as long as the structure
+ * that holds it: the words and nodes of a word count list, for instance.
+ */
+
+#ifndef arena_h
+#define arena_h
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef struct arena_chunk {
+  struct arena_chunk *next;
+  size_t size; /* Bytes of data following this header */
+  size_t used;
+} arena_chunk_t;
+
+typedef struct arena {
+  arena_chunk_t *chunks; /* Allocations are carved from the first chunk */
+  arena_chunk_t *last;
+  size_t n_chunks;
+  size_t allocs;       /* Number of arena_alloc() calls */
+  size_t requested;    /* Bytes those calls asked for */
+  size_t reserved;     /* Bytes of chunk memory obtained from malloc() */
+  size_t malloc_bytes; /* Heap the same allocations would take as separate malloc()s */
+} arena_t;
+
+/* Initialize an empty arena. */
+void arena_init(arena_t *arena);
+
+/* Allocate size bytes aligned to align, a power of two. Returns NULL if out of memory. */
+void *arena_alloc(arena_t *arena, size_t size, size_t align);
+
+/* Copy the len bytes at str into the arena as a NUL-terminated string. */
+char *arena_strndup(arena_t *arena, const char *str, size_t len);
+
+/* Release everything allocated from arena at once. */
+void arena_free(arena_t *arena);
+
+/* Print allocation counts and the bytes saved over one malloc() per allocation. */
+void arena_report(arena_t *arena, FILE *outfile);
+
+#endif /* arena_h */
@@ -30,6 +30,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdbool.h>
 #include <stdlib.h>
 
+#include "tokenize.h"
 #include "word_count.h"
 
 /* Global data structure tracking the words encountered */
@@ -42,25 +43,17 @@ WordCount *word_counts = NULL;
  * 3.1.1 Total Word Count
  *
  * Returns the total amount of words found in infile.
- * Useful functions: fgetc(), isalpha().
+ * Words are found by tokenize(), which reads infile in large blocks.
  */
+static void count_one(char *word, size_t len, void *aux) {
+  (void) word;
+  (void) len;
+  (*(int *) aux)++;
+}
+
 int num_words(FILE* infile) {
   int num_words = 0;
-  int c;
-  int word_start = 0;
-  while ((c = fgetc(infile)) != EOF) {
-    if (isalpha(c)) {
-      word_start = 1;
-    } else if (word_start) {
-      num_words++;
-      word_start = 0;
-    }
-  }
-  // check the end of file
-  if (word_start) {
-    num_words++;
-  }
-
+  tokenize(infile, count_one, &num_words);
   return num_words;
 }
 
@@ -68,49 +61,39 @@ int num_words(FILE* infile) {
  * 3.1.2 Word Frequency Count
  *
  * Given infile, extracts and adds each word in the FILE to `wclist`.
- * Useful functions: fgetc(), isalpha(), tolower(), add_word().
+ * Words longer than MAX_WORD_LEN are cut down to their first MAX_WORD_LEN
+ * letters.
  * 
  * As mentioned in the spec, your code should not panic or
  * segfault on errors. Thus, this function should return
  * 1 in the event of any errors (e.g. wclist or infile is NULL)
  * and 0 otherwise.
  */
+typedef struct add_state {
+  WordCount **wclist;
+  int failed;
+} add_state;
+
+static void add_one(char *word, size_t len, void *aux) {
+  add_state *state = aux;
+  if (state->failed) {
+    return;
+  }
+  /* tokenize() lets us terminate the word in place, so nothing is copied */
+  word[len < MAX_WORD_LEN ? len : MAX_WORD_LEN] = '\0';
+  state->failed = add_word(state->wclist, word);
+}
+
 int count_words(WordCount **wclist, FILE *infile) {
   if (wclist == NULL || infile == NULL) {
     return 1;
   }
 
-  int c;
-  char* word = malloc(sizeof(char) * (MAX_WORD_LEN + 1));
-  if (word == NULL) {
+  add_state state = {wclist, 0};
+  if (tokenize(infile, add_one, &state) != 0) {
     return 1;
   }
-  int word_start = 0;
-  while ((c = fgetc(infile)) != EOF) {
-    if (isalpha(c)) {
-      if (word_start < MAX_WORD_LEN) {
-        word[word_start++] = tolower(c);
-      }
-    } else if (word_start > 0) {
-      word[word_start] = '\0';
-      if (add_word(wclist, word) != 0) {
-        free(word);
-        return 1;
-      }
-      word_start = 0;
-    }
-  }
-  // check the end of file
-  if (word_start > 0) {
-    word[word_start] = '\0';
-    if (add_word(wclist, word) != 0) {
-      free(word);
-      return 1;
-    }
-  }
-
-  free(word);
-  return 0;
+  return state.failed;
 }
 
 /*
@@ -215,5 +198,11 @@ int main (int argc, char *argv[]) {
     printf("The frequencies of each word are: \n");
     fprint_words(word_counts, stdout);
   }
+
+  // Set ARENA_STATS to see what allocating from an arena saved
+  if (getenv("ARENA_STATS") != NULL) {
+    fprint_words_memory(stderr);
+  }
+  free_words(&word_counts);
   return 0;
 }
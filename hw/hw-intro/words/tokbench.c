@@ -0,0 +1,156 @@
+/*
+
+Measures how fast words are found in a stream: the per-byte fgetc() loop
+that num_words() used to run, against tokenize() with each kernel this CPU
+supports. The input files are concatenated and repeated in memory up to the
+requested size, and every pass reads them through fmemopen() so that all
+paths pay the same stdio costs.
+
+usage: tokbench [-s megabytes] [-n passes] file...
+
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tokenize.h"
+
+/* The fgetc() and isalpha() loop num_words() ran before tokenize() */
+static long fgetc_words(FILE *infile) {
+  long words = 0;
+  int c;
+  int in_word = 0;
+  while ((c = fgetc(infile)) != EOF) {
+    if (isalpha(c)) {
+      in_word = 1;
+    } else if (in_word) {
+      words++;
+      in_word = 0;
+    }
+  }
+  return words + in_word;
+}
+
+static void count_one(char *word, size_t len, void *aux) {
+  (void) word;
+  (void) len;
+  (*(long *) aux)++;
+}
+
+static long tokenize_words(FILE *infile) {
+  long words = 0;
+  tokenize(infile, count_one, &words);
+  return words;
+}
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Best of passes runs of count over data; stores the word count in *words */
+static double best_seconds(long (*count)(FILE *), char *data, size_t size, int passes,
+                           long *words) {
+  double best = 0;
+  for (int i = 0; i < passes; i++) {
+    FILE *infile = fmemopen(data, size, "r");
+    if (infile == NULL) {
+      perror("fmemopen");
+      exit(1);
+    }
+    double start = now_seconds();
+    *words = count(infile);
+    double elapsed = now_seconds() - start;
+    fclose(infile);
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+/* Reads every file and repeats their concatenation to fill size bytes */
+static char *load_corpus(char **paths, int n_paths, size_t size) {
+  size_t sample_len = 0, sample_cap = 1 << 20;
+  char *sample = malloc(sample_cap);
+  for (int i = 0; i < n_paths; i++) {
+    FILE *infile = fopen(paths[i], "r");
+    if (infile == NULL) {
+      perror(paths[i]);
+      exit(1);
+    }
+    size_t got;
+    while ((got = fread(sample + sample_len, 1, sample_cap - sample_len, infile)) > 0) {
+      sample_len += got;
+      if (sample_len == sample_cap) {
+        sample_cap *= 2;
+        sample = realloc(sample, sample_cap);
+      }
+    }
+    fclose(infile);
+  }
+  if (sample_len == 0) {
+    fprintf(stderr, "tokbench: input is empty\n");
+    exit(1);
+  }
+
+  char *data = malloc(size);
+  for (size_t off = 0; off < size; off += sample_len) {
+    memcpy(data + off, sample, off + sample_len <= size ? sample_len : size - off);
+  }
+  free(sample);
+  return data;
+}
+
+int main(int argc, char *argv[]) {
+  size_t megabytes = 256;
+  int passes = 3;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:n:h")) != -1) {
+    switch (opt) {
+      case 's':
+        megabytes = strtoul(optarg, NULL, 10);
+        break;
+      case 'n':
+        passes = atoi(optarg);
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-s megabytes] [-n passes] file...\n", argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc || megabytes == 0 || passes <= 0) {
+    fprintf(stderr, "usage: %s [-s megabytes] [-n passes] file...\n", argv[0]);
+    return 1;
+  }
+
+  size_t size = megabytes << 20;
+  /* tokenize() lowercases its own buffer, not data, so every pass sees the same input */
+  char *data = load_corpus(argv + optind, argc - optind, size);
+
+  printf("%-10s %10s %12s %8s\n", "path", "seconds", "words", "GB/s");
+  long expected;
+  double seconds = best_seconds(fgetc_words, data, size, passes, &expected);
+  printf("%-10s %10.3f %12ld %8.2f\n", "fgetc", seconds, expected, size / seconds / 1e9);
+
+  int failed = 0;
+  for (tokenize_kernel k = KERNEL_SCALAR; k <= KERNEL_AVX2; k++) {
+    if (!tokenize_use_kernel(k)) {
+      printf("%-10s %10s\n", tokenize_kernel_name(k), "unsupported");
+      continue;
+    }
+    long words;
+    seconds = best_seconds(tokenize_words, data, size, passes, &words);
+    printf("%-10s %10.3f %12ld %8.2f%s\n", tokenize_kernel_name(k), seconds, words,
+           size / seconds / 1e9, words == expected ? "" : "  (word count differs)");
+    failed |= words != expected;
+  }
+
+  free(data);
+  return failed;
+}
@@ -0,0 +1,201 @@
+/*
+
+Block-based tokenizer; see tokenize.h.
+
+*/
+
+#include "tokenize.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+
+/* Bytes classified per kernel call; one bit of the returned mask each */
+#define BLOCK 64
+
+/* Initial read buffer size; it grows for words longer than half of it */
+#define BUF_SIZE (1 << 20)
+
+typedef uint64_t kernel_fn(char *block);
+
+/* isalpha() in the C locale: A-Z and a-z only */
+static inline bool is_letter(unsigned char c) {
+  return (unsigned char) ((c | 0x20) - 'a') < 26;
+}
+
+static uint64_t classify_scalar(char *block) {
+  uint64_t mask = 0;
+  for (int i = 0; i < BLOCK; i++) {
+    if (is_letter(block[i])) {
+      block[i] |= 0x20;
+      mask |= (uint64_t) 1 << i;
+    }
+  }
+  return mask;
+}
+
+#ifdef HAVE_X86_KERNELS
+/*
+ * Both vector kernels use the same trick: OR-ing in 0x20 folds upper case onto
+ * lower case, and adding 0x80 - 'a' moves 'a'..'z' to the bottom of the signed
+ * byte range, so one signed compare finds every letter.
+ */
+static uint64_t classify_sse2(char *block) {
+  const __m128i fold = _mm_set1_epi8(0x20);
+  const __m128i shift = _mm_set1_epi8((char) (0x80 - 'a'));
+  const __m128i limit = _mm_set1_epi8((char) (0x80 + 26));
+  uint64_t mask = 0;
+  for (int i = 0; i < BLOCK; i += 16) {
+    __m128i bytes = _mm_loadu_si128((__m128i *) (block + i));
+    __m128i folded = _mm_add_epi8(_mm_or_si128(bytes, fold), shift);
+    __m128i letters = _mm_cmplt_epi8(folded, limit);
+    bytes = _mm_or_si128(bytes, _mm_and_si128(letters, fold));
+    _mm_storeu_si128((__m128i *) (block + i), bytes);
+    mask |= (uint64_t) (uint16_t) _mm_movemask_epi8(letters) << i;
+  }
+  return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t classify_avx2(char *block) {
+  const __m256i fold = _mm256_set1_epi8(0x20);
+  const __m256i shift = _mm256_set1_epi8((char) (0x80 - 'a'));
+  const __m256i limit = _mm256_set1_epi8((char) (0x80 + 26));
+  uint64_t mask = 0;
+  for (int i = 0; i < BLOCK; i += 32) {
+    __m256i bytes = _mm256_loadu_si256((__m256i *) (block + i));
+    __m256i folded = _mm256_add_epi8(_mm256_or_si256(bytes, fold), shift);
+    __m256i letters = _mm256_cmpgt_epi8(limit, folded);
+    bytes = _mm256_or_si256(bytes, _mm256_and_si256(letters, fold));
+    _mm256_storeu_si256((__m256i *) (block + i), bytes);
+    mask |= (uint64_t) (uint32_t) _mm256_movemask_epi8(letters) << i;
+  }
+  return mask;
+}
+#endif /* HAVE_X86_KERNELS */
+
+static kernel_fn *kernel = NULL;
+
+static bool kernel_supported(tokenize_kernel k) {
+  switch (k) {
+    case KERNEL_SCALAR:
+      return true;
+#ifdef HAVE_X86_KERNELS
+    case KERNEL_SSE2:
+      return __builtin_cpu_supports("sse2");
+    case KERNEL_AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+bool tokenize_use_kernel(tokenize_kernel k) {
+  if (!kernel_supported(k)) {
+    return false;
+  }
+  switch (k) {
+#ifdef HAVE_X86_KERNELS
+    case KERNEL_AVX2:
+      kernel = classify_avx2;
+      break;
+    case KERNEL_SSE2:
+      kernel = classify_sse2;
+      break;
+#endif
+    default:
+      kernel = classify_scalar;
+      break;
+  }
+  return true;
+}
+
+const char *tokenize_kernel_name(tokenize_kernel k) {
+  static const char *names[] = {"scalar", "sse2", "avx2"};
+  return names[k];
+}
+
+int tokenize(FILE *infile, word_fn *fn, void *aux) {
+  if (kernel == NULL) {
+    tokenize_kernel k = KERNEL_AVX2;
+    while (!tokenize_use_kernel(k)) {
+      k--;
+    }
+  }
+
+  /* BLOCK spare bytes hold the zero padding classified after end of file */
+  size_t cap = BUF_SIZE;
+  char *buf = malloc(cap + BLOCK);
+  if (buf == NULL) {
+    return 1;
+  }
+  size_t len = 0;
+
+  for (;;) {
+    size_t want = cap - len;
+    size_t got = fread(buf + len, 1, want, infile);
+    len += got;
+    bool eof = got < want;
+    if (eof && ferror(infile)) {
+      free(buf);
+      return 1;
+    }
+
+    /*
+     * Only whole blocks are classified until end of file; the rest waits for
+     * more input. At end of file a zero-padded block closes the last word.
+     */
+    size_t end = len & ~(size_t) (BLOCK - 1);
+    if (eof) {
+      memset(buf + len, 0, BLOCK);
+      end += BLOCK;
+    }
+
+    bool in_word = false;
+    size_t word_start = 0;
+    for (size_t base = 0; base < end; base += BLOCK) {
+      uint64_t letters = kernel(buf + base);
+      unsigned pos = 0;
+      while (pos < BLOCK) {
+        /* Bits from pos on that would end (or start) the current run */
+        uint64_t rest = (in_word ? ~letters : letters) >> pos;
+        if (rest == 0) {
+          break;
+        }
+        pos += __builtin_ctzll(rest);
+        if (in_word) {
+          fn(buf + word_start, base + pos - word_start, aux);
+        } else {
+          word_start = base + pos;
+        }
+        in_word = !in_word;
+      }
+    }
+    if (eof) {
+      break;
+    }
+
+    /* Carry the unfinished word and the unclassified tail to the front */
+    size_t carry = in_word ? word_start : end;
+    memmove(buf, buf + carry, len - carry);
+    len -= carry;
+    if (len > cap / 2) {
+      char *bigger = realloc(buf, 2 * cap + BLOCK);
+      if (bigger == NULL) {
+        free(buf);
+        return 1;
+      }
+      buf = bigger;
+      cap *= 2;
+    }
+  }
+
+  free(buf);
+  return 0;
+}
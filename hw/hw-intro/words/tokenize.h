@@ -0,0 +1,41 @@
+/*
+
+tokenize splits a stream into words: maximal runs of letters (what isalpha()
+accepts in the C locale), lowercased.
+
+Input is read in large blocks and classified 64 bytes at a time by a kernel
+that lowercases the letters in place and returns a bitmask of where they are.
+Words are then found from the mask transitions, so no per-byte stdio call or
+ctype lookup is made.
+*/
+
+#ifndef tokenize_h
+#define tokenize_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Called once per word. word points into tokenize()'s own buffer and is only
+ * valid during the call; it is not NUL-terminated, but word[len] may be
+ * overwritten (with a '\0', for instance).
+ */
+typedef void word_fn(char *word, size_t len, void *aux);
+
+/* Block classification kernels, slowest first */
+typedef enum { KERNEL_SCALAR, KERNEL_SSE2, KERNEL_AVX2 } tokenize_kernel;
+
+/* Reads infile to the end and calls fn on every word. Returns 0, or 1 on errors. */
+int tokenize(FILE *infile, word_fn *fn, void *aux);
+
+/*
+ * Chooses the kernel tokenize() uses. The default is the fastest one this CPU
+ * supports. Returns false, changing nothing, if kernel is not supported.
+ */
+bool tokenize_use_kernel(tokenize_kernel kernel);
+
+/* Name of a kernel, for reports */
+const char *tokenize_kernel_name(tokenize_kernel kernel);
+
+#endif /* tokenize_h */
@@ -20,16 +20,21 @@ Functional methods take the head of a list as first arg.
 Mutators take a reference to a list as first arg.
 */
 
+#include "arena.h"
 #include "word_count.h"
 
+/*
+ * Every node and word lives in this arena: two allocations per new word cost
+ * a pointer bump instead of two malloc()s, and free_words() releases them all
+ * at once. wordcount_sort() calls init_words() for its scratch list, so
+ * init_words() must leave the arena alone.
+ */
+static arena_t words_arena;
+
 /* Basic utilities */
 
 char *new_string(char *str) {
-  char *new_str = (char *) malloc(strlen(str) + 1);
-  if (new_str == NULL) {
-    return NULL;
-  }
-  return strcpy(new_str, str);
+  return arena_strndup(&words_arena, str, strlen(str));
 }
 
 int init_words(WordCount **wclist) {
@@ -72,11 +77,14 @@ int add_word(WordCount **wclist, char *word) {
   */
   WordCount *wc = find_word(*wclist, word);
   if (wc == NULL) {
-    wc = (WordCount *) malloc(sizeof(WordCount));
+    wc = arena_alloc(&words_arena, sizeof(WordCount), _Alignof(WordCount));
     if (wc == NULL) {
       return 1;
     }
     wc->word = new_string(word);
+    if (wc->word == NULL) {
+      return 1;
+    }
     wc->count = 1;
     wc->next = *wclist;
     *wclist = wc;
@@ -93,3 +101,13 @@ void fprint_words(WordCount *wchead, FILE *ofile) {
     fprintf(ofile, "%i\t%s\n", wc->count, wc->word);
   }
 }
+
+void free_words(WordCount **wclist) {
+  /* Nodes and words all come from the arena, so there is nothing to walk */
+  arena_free(&words_arena);
+  *wclist = NULL;
+}
+
+void fprint_words_memory(FILE *ofile) {
+  arena_report(&words_arena, ofile);
+}
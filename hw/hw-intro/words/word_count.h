@@ -69,6 +69,12 @@ void wordcount_insert_ordered(WordCount **wclist, WordCount *elem, bool less(con
 /* Sort a word count list in place */
 void wordcount_sort(WordCount **wclist, bool less(const WordCount *, const WordCount *));
 
+/* Release every word count, emptying the list */
+void free_words(WordCount **wclist);
+
+/* Print how much memory the word counts take, and what the arena saved */
+void fprint_words_memory(FILE *ofile);
+
 #endif /* word_count_h */
 
 
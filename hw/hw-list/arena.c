@@ -0,0 +1,123 @@
+/*
+ * Implementation of the arena interface.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/* Size of an ordinary chunk; bigger requests get a chunk of their own. */
+#define CHUNK_SIZE (64 * 1024)
+
+/* What glibc malloc() takes for a request: an 8-byte header, 16-byte granules, 32 at least. */
+static size_t malloc_cost(size_t size) {
+  size_t chunk = (size + 8 + 15) & ~(size_t)15;
+  return chunk < 32 ? 32 : chunk;
+}
+
+static arena_chunk_t* new_chunk(arena_t* arena, size_t size) {
+  arena_chunk_t* chunk = malloc(sizeof(arena_chunk_t) + size);
+  if (chunk == NULL)
+    return NULL;
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+  arena->n_chunks++;
+  arena->reserved += malloc_cost(sizeof(arena_chunk_t) + size);
+  return chunk;
+}
+
+/* Offset into chunk at which size bytes aligned to align fit, or -1 if they do not. */
+static ptrdiff_t fit(arena_chunk_t* chunk, size_t size, size_t align) {
+  if (chunk == NULL)
+    return -1;
+  uintptr_t data = (uintptr_t)(chunk + 1);
+  size_t offset = ((data + chunk->used + align - 1) & ~(uintptr_t)(align - 1)) - data;
+  return offset + size <= chunk->size ? (ptrdiff_t)offset : -1;
+}
+
+void arena_init(arena_t* arena) { memset(arena, 0, sizeof(arena_t)); }
+
+void* arena_alloc(arena_t* arena, size_t size, size_t align) {
+  ptrdiff_t offset = fit(arena->chunks, size, align);
+  arena_chunk_t* chunk = arena->chunks;
+
+  if (offset < 0 && size + align > CHUNK_SIZE / 4) {
+    /* Large requests get their own chunk behind the current one, which stays in use. */
+    chunk = new_chunk(arena, size + align);
+    if (chunk == NULL)
+      return NULL;
+    if (arena->chunks == NULL) {
+      arena->chunks = arena->last = chunk;
+    } else {
+      chunk->next = arena->chunks->next;
+      arena->chunks->next = chunk;
+      if (arena->last == arena->chunks)
+        arena->last = chunk;
+    }
+    offset = fit(chunk, size, align);
+  } else if (offset < 0) {
+    chunk = new_chunk(arena, CHUNK_SIZE);
+    if (chunk == NULL)
+      return NULL;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    if (arena->last == NULL)
+      arena->last = chunk;
+    offset = fit(chunk, size, align);
+  }
+
+  chunk->used = offset + size;
+  arena->allocs++;
+  arena->requested += size;
+  arena->malloc_bytes += malloc_cost(size);
+  return (char*)(chunk + 1) + offset;
+}
+
+char* arena_strndup(arena_t* arena, const char* str, size_t len) {
+  char* copy = arena_alloc(arena, len + 1, 1);
+  if (copy == NULL)
+    return NULL;
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+void arena_absorb(arena_t* arena, arena_t* other) {
+  if (other->chunks == NULL)
+    return;
+  /* Appended, so arena keeps allocating from its own current chunk. */
+  if (arena->chunks == NULL) {
+    arena->chunks = other->chunks;
+  } else {
+    arena->last->next = other->chunks;
+  }
+  arena->last = other->last;
+  arena->n_chunks += other->n_chunks;
+  arena->allocs += other->allocs;
+  arena->requested += other->requested;
+  arena->reserved += other->reserved;
+  arena->malloc_bytes += other->malloc_bytes;
+  arena_init(other);
+}
+
+void arena_free(arena_t* arena) {
+  arena_chunk_t* chunk = arena->chunks;
+  while (chunk != NULL) {
+    arena_chunk_t* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  arena_init(arena);
+}
+
+void arena_report(arena_t* arena, FILE* outfile) {
+  long saved = (long)arena->malloc_bytes - (long)arena->reserved;
+  fprintf(outfile, "arena: %zu allocations, %zu bytes requested, %zu bytes in %zu chunks\n",
+          arena->allocs, arena->requested, arena->reserved, arena->n_chunks);
+  fprintf(outfile, "arena: one malloc() each would take %zu bytes, %ld bytes saved (%.1f%%)\n",
+          arena->malloc_bytes, saved,
+          arena->malloc_bytes > 0 ? 100.0 * saved / arena->malloc_bytes : 0.0);
+}
@@ -0,0 +1,117 @@
+#!/bin/bash
+
+# Benchmark harness: every word count backend on synthetic Zipf corpora
+# For each corpus size and exponent, ./wcgen writes one reproducible stream
+# of words, split into 1, 2, 4, ... files. The single-threaded programs
+# (./words, ./lwords, ./hwords) read it as one file; the threaded ones run
+# one thread per file (./cpwords splits the files across PWORDS_THREADS).
+# Each run goes through ./wcrun, which records wall time, peak RSS and the
+# time threads spent blocked on mutexes, and its output is checked against
+# ./hwords on the same corpus. Results are printed as CSV; progress goes to
+# stderr.
+#
+# The list backends search linearly for every word, so they only run on
+# corpora of at most -l megabytes.
+#
+# Usage: ./bench.sh [-s "sizes_mb"] [-v vocabulary] [-z "exponents"]
+#                   [-t "threads"] [-p "programs"] [-l list_limit_mb]
+
+SIZES="1 16"
+VOCABULARY=10000
+EXPONENTS="0.8 1.2"
+THREADS="1 2 4"
+PROGRAMS="words lwords pwords hwords hpwords spwords mpwords cpwords"
+LIST_LIMIT_MB=1
+
+while getopts "s:v:z:t:p:l:h" opt; do
+    case $opt in
+        s) SIZES=$OPTARG ;;
+        v) VOCABULARY=$OPTARG ;;
+        z) EXPONENTS=$OPTARG ;;
+        t) THREADS=$OPTARG ;;
+        p) PROGRAMS=$OPTARG ;;
+        l) LIST_LIMIT_MB=$OPTARG ;;
+        *)
+            echo "usage: $0 [-s \"sizes_mb\"] [-v vocabulary] [-z \"exponents\"] [-t \"threads\"] [-p \"programs\"] [-l list_limit_mb]" >&2
+            exit 1
+            ;;
+    esac
+done
+
+CORPUS_DIR=$(mktemp -d)
+
+# Cleanup function
+cleanup() {
+    rm -rf "$CORPUS_DIR"
+}
+
+# Register cleanup function
+trap cleanup EXIT
+
+for prog in wcgen wcrun lockstat.so hwords $PROGRAMS; do
+    if [ ! -f "./$prog" ]; then
+        echo "Error: ./$prog does not exist, run make first" >&2
+        exit 1
+    fi
+done
+
+is_list() {
+    [ "$1" = words ] || [ "$1" = lwords ] || [ "$1" = pwords ]
+}
+
+is_threaded() {
+    [ "$1" != words ] && [ "$1" != lwords ] && [ "$1" != hwords ]
+}
+
+# Runs $2... through wcrun and prints one CSV row; $1 is the thread count
+run() {
+    local threads=$1
+    local prog=$2
+    shift 2
+    local stats
+    stats=$(PWORDS_THREADS=$threads ./wcrun -o "$CORPUS_DIR/out" -- "./$prog" "$@")
+    # ./words pads its counts; the other programs print them unpadded
+    local result=differs
+    if sed 's/^ *//' "$CORPUS_DIR/out" | cmp -s - "$CORPUS_DIR/expected"; then
+        result=match
+    fi
+    IFS=, read -r wall rss calls contended wait status <<< "$stats"
+    awk -v p="$prog" -v mb="$size" -v v="$VOCABULARY" -v z="$exponent" -v t="$threads" \
+        -v w="$wall" -v words="$words" -v rss="$rss" -v c="$calls" -v cc="$contended" \
+        -v lw="$wait" -v st="$status" -v r="$result" 'BEGIN {
+            if (st != 0) r = "failed"
+            printf "%s,%s,%s,%s,%s,%s,%.2f,%.2f,%s,%s,%s,%s,%s\n", p, mb, v, z, t, w,
+                (w > 0 ? mb / w : 0), (w > 0 ? words / w / 1e6 : 0), rss, c, cc, lw, r
+        }'
+    echo "  $prog, $threads thread(s): ${wall}s, $result" >&2
+}
+
+echo "program,corpus_mb,vocabulary,exponent,threads,wall_s,mb_per_s,mwords_per_s,peak_rss_kb,lock_calls,lock_contended,lock_wait_s,output"
+
+for size in $SIZES; do
+    for exponent in $EXPONENTS; do
+        echo "Corpus: $size MB, $VOCABULARY words, exponent $exponent ($(nproc) cores)" >&2
+        for t in $THREADS; do
+            ./wcgen -s "$size" -v "$VOCABULARY" -z "$exponent" -f "$t" "$CORPUS_DIR/t$t" > "$CORPUS_DIR/words"
+        done
+        words=$(cat "$CORPUS_DIR/words")
+        whole="$CORPUS_DIR/whole"
+        ./wcgen -s "$size" -v "$VOCABULARY" -z "$exponent" "$whole" > /dev/null
+        ./hwords "$whole.0" > "$CORPUS_DIR/expected"
+
+        for prog in $PROGRAMS; do
+            if is_list "$prog" && awk -v s="$size" -v l="$LIST_LIMIT_MB" 'BEGIN { exit !(s > l) }'; then
+                echo "  $prog: skipped, corpus is larger than $LIST_LIMIT_MB MB" >&2
+                continue
+            fi
+            if is_threaded "$prog"; then
+                for t in $THREADS; do
+                    run "$t" "$prog" "$CORPUS_DIR/t$t".*
+                done
+            else
+                run 1 "$prog" "$whole.0"
+            fi
+        done
+        rm -f "$CORPUS_DIR"/t* "$whole".*
+    done
+done
@@ -0,0 +1,306 @@
+/*
+ * Word count application using the hash table backend.
+ *
+ * Same command line and output as words and lwords: counts the words in each
+ * file named on the command line (or stdin), then prints them sorted by count.
+ *
+ * --top N prints only the N most frequent words, the last N lines of the full
+ * output, selected with a bounded heap instead of sorting every word.
+ * --approx[=WIDTH] with --top estimates them with a count-min sketch of WIDTH
+ * counters per row instead of counting every word, so memory stays fixed
+ * however large the vocabulary. Counts printed are then upper bounds.
+ * --spill=BUDGET counts in about BUDGET bytes (suffix K, M or G), writing
+ * sorted runs to $TMPDIR whenever the table outgrows it. Every word is then
+ * printed in alphabetical order, or with --top only the N most frequent.
+ * --snapshot=PATH writes every count to PATH as a binary snapshot instead of
+ * printing them; see snapshot.h and wcsnap.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sketch.h"
+#include "snapshot.h"
+#include "spill.h"
+#include "topk.h"
+#include "word_count.h"
+#include "word_helpers.h"
+#include "word_stream.h"
+
+#define SKETCH_WIDTH (1 << 16)
+#define SKETCH_DEPTH 4
+
+static void usage(const char* prog) {
+  fprintf(stderr,
+          "usage: %s [--top N | --snapshot=PATH] [--approx[=WIDTH] | --spill=BUDGET] [file...]\n",
+          prog);
+}
+
+/* Parses a byte count with an optional K, M or G suffix; returns 0 if malformed. */
+static size_t parse_bytes(const char* str) {
+  char* end;
+  size_t bytes = strtoul(str, &end, 10);
+  switch (*end) {
+    case 'G':
+    case 'g':
+      bytes *= 1024;
+      /* fall through */
+    case 'M':
+    case 'm':
+      bytes *= 1024;
+      /* fall through */
+    case 'K':
+    case 'k':
+      bytes *= 1024;
+      end++;
+  }
+  return *end == '\0' ? bytes : 0;
+}
+
+/* Scans every file named in argv[1..argc-1], or stdin if there are none. */
+static int scan_inputs(int argc, char* argv[], word_fn fn, void* aux) {
+  if (argc <= 1) {
+    return scan_words(stdin, fn, aux) ? 0 : 1;
+  }
+  for (int i = 1; i < argc; i++) {
+    FILE* infile = fopen(argv[i], "r");
+    if (infile == NULL) {
+      perror("fopen");
+      return 1;
+    }
+    bool ok = scan_words(infile, fn, aux);
+    fclose(infile);
+    if (!ok) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static bool add_to_sketch(const char* word, size_t len, void* aux) {
+  return sketch_add(aux, word, len);
+}
+
+/* Prints the approximate top words of every input; returns the exit status. */
+static int approx_top(int argc, char* argv[], size_t top, size_t width) {
+  sketch_t sketch;
+  if (!sketch_init(&sketch, top, width, SKETCH_DEPTH)) {
+    perror("sketch_init");
+    return 1;
+  }
+  int status = scan_inputs(argc, argv, add_to_sketch, &sketch);
+  if (status == 0) {
+    sketch_fprint_top(&sketch, stdout);
+  }
+  if (getenv("ARENA_STATS") != NULL) {
+    fprintf(stderr, "sketch: %zu words, %zu bytes\n", (size_t)sketch.total, sketch_bytes(&sketch));
+  }
+  sketch_free(&sketch);
+  return status;
+}
+
+static bool add_to_spill(const char* word, size_t len, void* aux) {
+  return spill_add(aux, word, len);
+}
+
+static bool print_entry(const word_count_t* wc, void* aux) {
+  return fprintf(aux, "%i\t%s\n", wc->count, wc->word) >= 0;
+}
+
+static bool less_entry(const void* a, const void* b, void* aux) {
+  return less_count(a, b);
+}
+
+/* Keeps a copy of wc if it is among the most frequent so far. */
+static bool offer_entry(const word_count_t* wc, void* aux) {
+  topk_t* topk = aux;
+  if (topk->len == topk->k && (topk->k == 0 || !less_count(topk->heap[0], wc))) {
+    return true;
+  }
+  size_t len = strlen(wc->word);
+  word_count_t* copy = malloc(sizeof(word_count_t) + len + 1);
+  if (copy == NULL) {
+    return false;
+  }
+  copy->word = (char*)(copy + 1);
+  memcpy(copy->word, wc->word, len + 1);
+  copy->count = wc->count;
+  free((void*)topk_offer(topk, copy));
+  return true;
+}
+
+static bool write_entry(const word_count_t* wc, void* aux) {
+  return snapshot_write(aux, wc->word, strlen(wc->word), wc->count);
+}
+
+/* Writes the merged counts of spill to a snapshot at path. */
+static bool spill_snapshot(spill_t* spill, const char* path) {
+  FILE* outfile = fopen(path, "w");
+  if (outfile == NULL) {
+    return false;
+  }
+  snapshot_writer_t writer;
+  bool ok = snapshot_writer_init(&writer, outfile);
+  if (ok) {
+    ok = spill_merge(spill, write_entry, &writer);
+    ok = snapshot_writer_finish(&writer) && ok;
+  }
+  return fclose(outfile) == 0 && ok;
+}
+
+/*
+ * Counts every input in budget bytes and prints the result, or writes it to
+ * a snapshot at snapshot_path if that is not NULL; returns the exit status.
+ */
+static int spill_count(int argc, char* argv[], long top, size_t budget, const char* snapshot_path) {
+  const char* dir = getenv("TMPDIR") != NULL ? getenv("TMPDIR") : "/tmp";
+  spill_t spill;
+  if (!spill_init(&spill, budget, dir)) {
+    perror("spill_init");
+    return 1;
+  }
+  int status = scan_inputs(argc, argv, add_to_spill, &spill);
+  if (status != 0) {
+    perror("spill");
+  } else if (snapshot_path != NULL) {
+    status = spill_snapshot(&spill, snapshot_path) ? 0 : 1;
+    if (status != 0) {
+      perror(snapshot_path);
+    }
+  } else if (top < 0) {
+    status = spill_merge(&spill, print_entry, stdout) ? 0 : 1;
+  } else {
+    topk_t topk;
+    if (!topk_init(&topk, top, less_entry, NULL)) {
+      status = 1;
+    } else {
+      status = spill_merge(&spill, offer_entry, &topk) ? 0 : 1;
+      const void** words = malloc((top > 0 ? top : 1) * sizeof(void*));
+      size_t n = words != NULL ? topk_finish(&topk, words) : 0;
+      for (size_t i = 0; i < n; i++) {
+        if (status == 0) {
+          print_entry(words[i], stdout);
+        }
+        free((void*)words[i]);
+      }
+      free(words);
+      topk_destroy(&topk);
+    }
+  }
+  if (getenv("ARENA_STATS") != NULL) {
+    fprintf(stderr, "spill: %zu entries written to runs, budget %zu bytes\n", spill.spilled,
+            budget);
+  }
+  spill_free(&spill);
+  return status;
+}
+
+int main(int argc, char* argv[]) {
+  static struct option long_options[] = {{"top", required_argument, NULL, 't'},
+                                         {"approx", optional_argument, NULL, 'a'},
+                                         {"spill", required_argument, NULL, 's'},
+                                         {"snapshot", required_argument, NULL, 'o'},
+                                         {"help", no_argument, NULL, 'h'},
+                                         {NULL, 0, NULL, 0}};
+  long top = -1;
+  size_t width = 0, budget = 0;
+  const char* snapshot_path = NULL;
+  int opt;
+  while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+    switch (opt) {
+      case 't': {
+        char* end;
+        top = strtol(optarg, &end, 10);
+        if (end == optarg || *end != '\0' || top < 0) {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      }
+      case 'a': {
+        char* end = NULL;
+        long parsed = optarg != NULL ? strtol(optarg, &end, 10) : SKETCH_WIDTH;
+        if (optarg != NULL && (end == optarg || *end != '\0' || parsed <= 0)) {
+          usage(argv[0]);
+          return 1;
+        }
+        width = parsed;
+        break;
+      }
+      case 's':
+        budget = parse_bytes(optarg);
+        if (budget == 0) {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'o':
+        snapshot_path = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (top < -1 || (width > 0 && top < 0) || (width > 0 && budget > 0) ||
+      (snapshot_path != NULL && (top >= 0 || width > 0))) {
+    usage(argv[0]);
+    return 1;
+  }
+  /* Leave the file names in argv[1..argc-1], as if there were no options */
+  argc -= optind - 1;
+  argv += optind - 1;
+
+  if (width > 0) {
+    return approx_top(argc, argv, top, width);
+  }
+  if (budget > 0) {
+    return spill_count(argc, argv, top, budget, snapshot_path);
+  }
+
+  word_count_list_t word_counts;
+  init_words(&word_counts);
+
+  if (argc <= 1) {
+    count_words(&word_counts, stdin);
+  } else {
+    for (int i = 1; i < argc; i++) {
+      FILE* infile = fopen(argv[i], "r");
+      if (infile == NULL) {
+        perror("fopen");
+        return 1;
+      }
+      count_words(&word_counts, infile);
+      fclose(infile);
+    }
+  }
+
+  if (snapshot_path != NULL) {
+    FILE* outfile = fopen(snapshot_path, "w");
+    if (outfile == NULL || !fsnapshot_words(&word_counts, outfile) || fclose(outfile) != 0) {
+      perror(snapshot_path);
+      return 1;
+    }
+  } else if (top >= 0) {
+    word_count_t** words = malloc((top > 0 ? top : 1) * sizeof(word_count_t*));
+    if (words == NULL) {
+      perror("malloc");
+      return 1;
+    }
+    size_t n = top_words(&word_counts, top, less_count, words);
+    for (size_t i = 0; i < n; i++) {
+      fprintf(stdout, "%i\t%s\n", words[i]->count, words[i]->word);
+    }
+    free(words);
+  } else {
+    wordcount_sort(&word_counts, less_count);
+    fprint_words(&word_counts, stdout);
+  }
+
+  if (getenv("ARENA_STATS") != NULL) {
+    arena_report(&word_counts.arena, stderr);
+  }
+  free_words(&word_counts);
+  return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * Preloadable counter of pthread mutex contention:
+ *
+ *   LOCKSTAT_FILE=stats LD_PRELOAD=./lockstat.so ./pwords ...
+ *
+ * Every pthread_mutex_lock() first tries the lock; only when that fails is
+ * the blocking call timed, so uncontended locking costs one extra trylock.
+ * At exit "calls contended wait_ns" is written to LOCKSTAT_FILE: how many
+ * locks were taken, how many had to wait, and the nanoseconds spent waiting
+ * summed over all threads.
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static int (*real_lock)(pthread_mutex_t*);
+static uint64_t calls;
+static uint64_t contended;
+static uint64_t wait_ns;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+__attribute__((constructor)) static void lockstat_init(void) {
+  if (real_lock == NULL)
+    real_lock = dlsym(RTLD_NEXT, "pthread_mutex_lock");
+}
+
+__attribute__((destructor)) static void lockstat_fini(void) {
+  const char* path = getenv("LOCKSTAT_FILE");
+  if (path == NULL)
+    return;
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return;
+  char line[96];
+  int len = snprintf(line, sizeof(line), "%llu %llu %llu\n", (unsigned long long)calls,
+                     (unsigned long long)contended, (unsigned long long)wait_ns);
+  if (write(fd, line, len) < 0)
+    perror(path);
+  close(fd);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+  if (real_lock == NULL)
+    lockstat_init();
+  __atomic_fetch_add(&calls, 1, __ATOMIC_RELAXED);
+  if (pthread_mutex_trylock(mutex) == 0)
+    return 0;
+
+  uint64_t start = now_ns();
+  int result = real_lock(mutex);
+  __atomic_fetch_add(&wait_ns, now_ns() - start, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&contended, 1, __ATOMIC_RELAXED);
+  return result;
+}
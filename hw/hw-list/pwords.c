@@ -22,6 +22,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <getopt.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <string.h>
@@ -31,7 +32,56 @@
 
 #include "word_count.h"
 #include "word_helpers.h"
+#ifdef CHUNKED
+#include <unistd.h>
 
+#include "word_chunks.h"
+#endif
+
+#if defined(CHUNKED)
+/*
+ * Files are read one at a time, each split across every core so that a single
+ * large input is counted in parallel too. PWORDS_THREADS overrides the number
+ * of threads.
+ */
+static int chunk_threads(void) {
+  const char* env = getenv("PWORDS_THREADS");
+  if (env != NULL && atoi(env) > 0)
+    return atoi(env);
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 0 ? cores : 1;
+}
+#elif defined(MERGE_COUNTS)
+/*
+ * Each thread counts its file into a private table, so counting takes no
+ * shared lock. The tables are then merged pairwise in parallel: in round r,
+ * thread i (a multiple of 2^(r+1)) joins thread i + 2^r and absorbs its table,
+ * so all tables meet in thread 0's after log2(threads) rounds.
+ */
+typedef struct file_task {
+  char* filename;
+  int index;
+  int n_tasks;
+  pthread_t* threads;
+  word_count_list_t* tables;
+} file_task_t;
+
+static void* process_file(void* arg) {
+  file_task_t* task = arg;
+  FILE* file = fopen(task->filename, "r");
+  if (file != NULL) {
+    count_words(&task->tables[task->index], file);
+    fclose(file);
+  }
+
+  for (int stride = 1; (task->index & stride) == 0 && task->index + stride < task->n_tasks;
+       stride *= 2) {
+    pthread_join(task->threads[task->index + stride], NULL);
+    merge_words(&task->tables[task->index], &task->tables[task->index + stride]);
+  }
+  return NULL;
+}
+#else  /* MERGE_COUNTS */
 // Global word count list shared by all threads
 static word_count_list_t* g_word_counts = NULL;
 
@@ -45,20 +95,111 @@ static void* process_file(void* arg) {
   }
   return NULL;
 }
+#endif /* CHUNKED */
+
+/*
+ * Prints the top most frequent words, the last top lines fprint_words() would
+ * print after sorting, without sorting the rest.
+ */
+static int print_top_words(word_count_list_t* wclist, size_t top) {
+  word_count_t** words = malloc((top > 0 ? top : 1) * sizeof(word_count_t*));
+  if (words == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  size_t n = top_words(wclist, top, less_count, words);
+  for (size_t i = 0; i < n; i++) {
+    fprintf(stdout, "%i\t%s\n", words[i]->count, words[i]->word);
+  }
+  free(words);
+  return 0;
+}
 
 /*
  * main - handle command line, spawning one thread per file.
+ * --top N prints only the N most frequent words.
+ * --snapshot=PATH writes the counts to PATH as a binary snapshot instead.
  */
 int main(int argc, char* argv[]) {
+  static struct option long_options[] = {{"top", required_argument, NULL, 't'},
+                                         {"snapshot", required_argument, NULL, 'o'},
+                                         {"help", no_argument, NULL, 'h'},
+                                         {NULL, 0, NULL, 0}};
+  long top = -1;
+  const char* snapshot_path = NULL;
+  int opt;
+  while ((opt = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+    switch (opt) {
+      case 't': {
+        char* end;
+        top = strtol(optarg, &end, 10);
+        if (end == optarg || *end != '\0' || top < 0) {
+          fprintf(stderr, "usage: %s [--top N | --snapshot=PATH] [file...]\n", argv[0]);
+          return 1;
+        }
+        break;
+      }
+      case 'o':
+        snapshot_path = optarg;
+        break;
+      default:
+        fprintf(stderr, "usage: %s [--top N | --snapshot=PATH] [file...]\n", argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (top < -1 || (top >= 0 && snapshot_path != NULL)) {
+    fprintf(stderr, "usage: %s [--top N | --snapshot=PATH] [file...]\n", argv[0]);
+    return 1;
+  }
+  /* Leave the file names in argv[1..argc-1], as if there were no options. */
+  argc -= optind - 1;
+  argv += optind - 1;
+
   /* Create the empty data structure. */
   word_count_list_t word_counts;
   init_words(&word_counts);
-  g_word_counts = &word_counts;
 
   if (argc <= 1) {
     /* Process stdin in a single thread. */
     count_words(&word_counts, stdin);
   } else {
+#if defined(CHUNKED)
+    int n_threads = chunk_threads();
+    for (int i = 1; i < argc; i++) {
+      if (count_words_chunked(&word_counts, argv[i], n_threads) < 0) {
+        perror("fopen");
+        return 1;
+      }
+    }
+#elif defined(MERGE_COUNTS)
+    int n_tasks = argc - 1;
+    pthread_t* threads = malloc(n_tasks * sizeof(pthread_t));
+    file_task_t* tasks = malloc(n_tasks * sizeof(file_task_t));
+    word_count_list_t* tables = malloc(n_tasks * sizeof(word_count_list_t));
+    if (threads == NULL || tasks == NULL || tables == NULL) {
+      return 1;
+    }
+
+    // Spawn the threads last to first, so every thread a thread may join
+    // already exists when it starts
+    for (int i = n_tasks - 1; i >= 0; i--) {
+      init_words(&tables[i]);
+      tasks[i] = (file_task_t){argv[i + 1], i, n_tasks, threads, tables};
+      if (pthread_create(&threads[i], NULL, process_file, &tasks[i]) != 0) {
+        return 1;
+      }
+    }
+
+    // Thread 0 joins everyone else and ends up holding every count
+    pthread_join(threads[0], NULL);
+    merge_words(&word_counts, &tables[0]);
+
+    free(threads);
+    free(tasks);
+    free(tables);
+#else  /* MERGE_COUNTS */
+    g_word_counts = &word_counts;
+
     /* TODO */
     // Create an array to store thread IDs
     pthread_t* threads = (pthread_t*)malloc((argc - 1) * sizeof(pthread_t));
@@ -80,10 +221,36 @@ int main(int argc, char* argv[]) {
     }
     
     free(threads);
+#endif /* CHUNKED */
   }
 
   /* Output final result of all threads' work. */
-  wordcount_sort(&word_counts, less_count);
-  fprint_words(&word_counts, stdout);
+  if (snapshot_path != NULL) {
+    FILE* outfile = fopen(snapshot_path, "w");
+    if (outfile == NULL || !fsnapshot_words(&word_counts, outfile) || fclose(outfile) != 0) {
+      perror(snapshot_path);
+      return 1;
+    }
+  } else if (top >= 0) {
+    if (print_top_words(&word_counts, top) != 0) {
+      return 1;
+    }
+  } else {
+    wordcount_sort(&word_counts, less_count);
+    fprint_words(&word_counts, stdout);
+  }
+
+  /* Set ARENA_STATS to see what allocating entries from an arena saved. */
+  if (getenv("ARENA_STATS") != NULL) {
+#ifdef STRIPED
+    /* Every stripe has an arena of its own */
+    for (int s = 0; s < WORD_STRIPES; s++) {
+      arena_report(&word_counts.stripes[s].arena, stderr);
+    }
+#else
+    arena_report(&word_counts.arena, stderr);
+#endif
+  }
+  free_words(&word_counts);
   return 0;
 }
@@ -0,0 +1,107 @@
+#!/bin/bash
+
+# Scaling benchmark: shared-table pwords vs thread-local counting
+# Replicates the gutenberg/ books into a corpus of the given size, splits it
+# into one file per thread, and times ./hpwords (one locked table),
+# ./spwords (one lock-striped table), ./mpwords (private tables merged at the
+# end) and ./cpwords (every file split across PWORDS_THREADS threads) at 1, 2,
+# 4, ... threads.
+#
+# Usage: ./scale.sh [size_mb] [max_threads]
+
+# Set color output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+NC='\033[0m' # No Color
+
+SIZE_MB=${1:-1024}
+MAX_THREADS=${2:-$(nproc)}
+PROGRAMS=("./hpwords" "./spwords" "./mpwords" "./cpwords")
+
+CORPUS_DIR=$(mktemp -d)
+BASE="$CORPUS_DIR/base.txt"
+
+# Cleanup function
+cleanup() {
+    rm -rf "$CORPUS_DIR"
+}
+
+# Register cleanup function
+trap cleanup EXIT
+
+for prog in "${PROGRAMS[@]}"; do
+    if [ ! -f "$prog" ]; then
+        echo -e "${RED}Error: $prog does not exist, run make first${NC}"
+        exit 1
+    fi
+done
+
+# Thread counts to measure: powers of two, then MAX_THREADS itself
+THREADS=()
+for ((t = 1; t < MAX_THREADS; t *= 2)); do
+    THREADS+=("$t")
+done
+THREADS+=("$MAX_THREADS")
+
+echo -e "${BLUE}Scaling benchmark: ${SIZE_MB} MB corpus, up to ${MAX_THREADS} threads ($(nproc) cores)${NC}"
+echo "=============================================="
+
+cat gutenberg/*.txt > "$BASE"
+base_bytes=$(stat -c %s "$BASE")
+
+# Splits the corpus into $1 files made of whole copies of the base text
+make_corpus() {
+    local threads=$1
+    local copies=$(( (SIZE_MB * 1024 * 1024 / threads + base_bytes - 1) / base_bytes ))
+    rm -f "$CORPUS_DIR"/part.*
+    for ((p = 0; p < threads; p++)); do
+        for ((c = 0; c < copies; c++)); do
+            cat "$BASE"
+        done > "$CORPUS_DIR/part.$p"
+    done
+}
+
+# Prints the wall time of $@ in seconds
+time_run() {
+    local TIMEFORMAT=%R
+    { time "$@" > /dev/null 2>&1 ; } 2>&1
+}
+
+printf "%-8s" "threads"
+for prog in "${PROGRAMS[@]}"; do
+    printf " %12s %8s" "$(basename "$prog") (s)" "speedup"
+done
+printf " %s\n" "output"
+
+declare -A BASELINE
+for t in "${THREADS[@]}"; do
+    make_corpus "$t"
+    printf "%-8s" "$t"
+    for prog in "${PROGRAMS[@]}"; do
+        seconds=$(PWORDS_THREADS=$t time_run "$prog" "$CORPUS_DIR"/part.*)
+        # One thread reads the whole corpus, so the speedup is against that run
+        if [ -z "${BASELINE[$prog]}" ]; then
+            BASELINE[$prog]=$seconds
+        fi
+        printf " %12s %8s" "$seconds" "$(awk -v b="${BASELINE[$prog]}" -v s="$seconds" 'BEGIN { printf "%.2fx", (s > 0 ? b / s : 0) }')"
+    done
+
+    "${PROGRAMS[0]}" "$CORPUS_DIR"/part.* > "$CORPUS_DIR/expected"
+    same=1
+    for prog in "${PROGRAMS[@]:1}"; do
+        if ! PWORDS_THREADS=$t "$prog" "$CORPUS_DIR"/part.* | diff -q - "$CORPUS_DIR/expected" > /dev/null; then
+            same=0
+        fi
+    done
+    if [ $same -eq 1 ]; then
+        printf " ${GREEN}%s${NC}\n" "identical"
+    else
+        printf " ${RED}%s${NC}\n" "differs"
+    fi
+done
+
+echo "=============================================="
+echo -e "${YELLOW}Note: speedup is bounded by the $(nproc) cores of this machine${NC}"
+echo -e "${BLUE}Scaling benchmark completed${NC}"
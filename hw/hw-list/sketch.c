@@ -0,0 +1,229 @@
+/*
+ * Implementation of the sketch interface.
+ *
+ * Counters use the conservative update: adding a word raises only the rows
+ * holding its current minimum, which keeps estimates of rare words that
+ * share counters with common ones much closer to the truth.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sketch.h"
+
+/* 64-bit FNV-1a. */
+static uint64_t hash_word(const char* word, size_t len) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (unsigned char)word[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/* Column of row for hash; rows are derived from two halves of one hash. */
+static size_t column(sketch_t* sketch, uint64_t hash, size_t row) {
+  uint32_t h1 = hash, h2 = (hash >> 32) | 1;
+  return (h1 + row * h2) & (sketch->width - 1);
+}
+
+/* Order of less_count(): by count, then alphabetically. */
+static bool less_entry(const sketch_entry_t* a, const sketch_entry_t* b) {
+  if (a->count != b->count)
+    return a->count < b->count;
+  return strcmp(a->word, b->word) < 0;
+}
+
+static void swap(sketch_t* sketch, size_t i, size_t j) {
+  sketch_entry_t tmp = sketch->heavy[i];
+  sketch->heavy[i] = sketch->heavy[j];
+  sketch->heavy[j] = tmp;
+  sketch->index[sketch->heavy[i].slot] = i + 1;
+  sketch->index[sketch->heavy[j].slot] = j + 1;
+}
+
+static void sift_up(sketch_t* sketch, size_t i) {
+  while (i > 0 && less_entry(&sketch->heavy[i], &sketch->heavy[(i - 1) / 2])) {
+    swap(sketch, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+static void sift_down(sketch_t* sketch, size_t i) {
+  for (;;) {
+    size_t least = i;
+    size_t left = 2 * i + 1, right = 2 * i + 2;
+    if (left < sketch->n_heavy && less_entry(&sketch->heavy[left], &sketch->heavy[least]))
+      least = left;
+    if (right < sketch->n_heavy && less_entry(&sketch->heavy[right], &sketch->heavy[least]))
+      least = right;
+    if (least == i)
+      return;
+    swap(sketch, i, least);
+    i = least;
+  }
+}
+
+/* Heap position of the candidate for word, or -1 if it is not one. */
+static ptrdiff_t find_candidate(sketch_t* sketch, const char* word, size_t len, uint64_t hash) {
+  size_t mask = sketch->index_capacity - 1;
+  for (size_t i = hash & mask; sketch->index[i] != 0; i = (i + 1) & mask) {
+    sketch_entry_t* entry = &sketch->heavy[sketch->index[i] - 1];
+    if (entry->hash == hash && strncmp(entry->word, word, len) == 0 && entry->word[len] == '\0')
+      return sketch->index[i] - 1;
+  }
+  return -1;
+}
+
+static void index_insert(sketch_t* sketch, size_t pos) {
+  size_t mask = sketch->index_capacity - 1;
+  size_t i = sketch->heavy[pos].hash & mask;
+  while (sketch->index[i] != 0)
+    i = (i + 1) & mask;
+  sketch->index[i] = pos + 1;
+  sketch->heavy[pos].slot = i;
+}
+
+/* Backward-shift deletion keeps linear probing free of tombstones. */
+static void index_remove(sketch_t* sketch, size_t slot) {
+  size_t mask = sketch->index_capacity - 1;
+  sketch->index[slot] = 0;
+  size_t hole = slot;
+  for (size_t j = (slot + 1) & mask; sketch->index[j] != 0; j = (j + 1) & mask) {
+    size_t home = sketch->heavy[sketch->index[j] - 1].hash & mask;
+    if (((j - home) & mask) >= ((j - hole) & mask)) {
+      sketch->index[hole] = sketch->index[j];
+      sketch->heavy[sketch->index[hole] - 1].slot = hole;
+      sketch->index[j] = 0;
+      hole = j;
+    }
+  }
+}
+
+bool sketch_init(sketch_t* sketch, size_t k, size_t width, size_t depth) {
+  memset(sketch, 0, sizeof(sketch_t));
+  sketch->width = 1;
+  while (sketch->width < width)
+    sketch->width *= 2;
+  sketch->depth = depth > 0 ? depth : 1;
+  sketch->k = k;
+  sketch->index_capacity = 4;
+  while (sketch->index_capacity < 2 * k)
+    sketch->index_capacity *= 2;
+
+  sketch->counters = calloc(sketch->width * sketch->depth, sizeof(uint32_t));
+  sketch->heavy = malloc((k > 0 ? k : 1) * sizeof(sketch_entry_t));
+  sketch->index = calloc(sketch->index_capacity, sizeof(size_t));
+  if (sketch->counters == NULL || sketch->heavy == NULL || sketch->index == NULL) {
+    sketch_free(sketch);
+    return false;
+  }
+  return true;
+}
+
+uint32_t sketch_estimate(sketch_t* sketch, const char* word, size_t len) {
+  uint64_t hash = hash_word(word, len);
+  uint32_t estimate = UINT32_MAX;
+  for (size_t row = 0; row < sketch->depth; row++) {
+    uint32_t c = sketch->counters[row * sketch->width + column(sketch, hash, row)];
+    if (c < estimate)
+      estimate = c;
+  }
+  return estimate;
+}
+
+bool sketch_add(sketch_t* sketch, const char* word, size_t len) {
+  uint64_t hash = hash_word(word, len);
+  uint32_t* cells[sketch->depth];
+  uint32_t least = UINT32_MAX;
+  for (size_t row = 0; row < sketch->depth; row++) {
+    cells[row] = &sketch->counters[row * sketch->width + column(sketch, hash, row)];
+    if (*cells[row] < least)
+      least = *cells[row];
+  }
+  if (least == UINT32_MAX)
+    return true; /* Saturated */
+  uint32_t estimate = least + 1;
+  for (size_t row = 0; row < sketch->depth; row++) {
+    if (*cells[row] < estimate)
+      *cells[row] = estimate;
+  }
+  sketch->total++;
+  if (sketch->k == 0)
+    return true;
+
+  /*
+   * Estimates only grow, so a candidate's estimate is at least the count it
+   * was kept with, which is at least the root's. Anything below the root of a
+   * full heap cannot be a candidate and needs no lookup.
+   */
+  bool full = sketch->n_heavy == sketch->k;
+  if (full && estimate < sketch->heavy[0].count)
+    return true;
+
+  ptrdiff_t pos = find_candidate(sketch, word, len, hash);
+  if (pos >= 0) {
+    sketch->heavy[pos].count = estimate;
+    sift_down(sketch, pos);
+    return true;
+  }
+
+  sketch_entry_t entry = {NULL, hash, estimate, 0};
+  entry.word = malloc(len + 1);
+  if (entry.word == NULL)
+    return false;
+  memcpy(entry.word, word, len);
+  entry.word[len] = '\0';
+
+  if (!full) {
+    pos = sketch->n_heavy++;
+    sketch->heavy[pos] = entry;
+    index_insert(sketch, pos);
+    sift_up(sketch, pos);
+  } else if (less_entry(&sketch->heavy[0], &entry)) {
+    index_remove(sketch, sketch->heavy[0].slot);
+    free(sketch->heavy[0].word);
+    sketch->heavy[0] = entry;
+    index_insert(sketch, 0);
+    sift_down(sketch, 0);
+  } else {
+    free(entry.word);
+  }
+  return true;
+}
+
+static int compare_entries(const void* a, const void* b) {
+  const sketch_entry_t* e1 = a;
+  const sketch_entry_t* e2 = b;
+  if (less_entry(e1, e2))
+    return -1;
+  return less_entry(e2, e1) ? 1 : 0;
+}
+
+void sketch_fprint_top(sketch_t* sketch, FILE* outfile) {
+  sketch_entry_t* sorted = malloc((sketch->n_heavy > 0 ? sketch->n_heavy : 1) * sizeof(sketch_entry_t));
+  if (sorted == NULL)
+    return;
+  memcpy(sorted, sketch->heavy, sketch->n_heavy * sizeof(sketch_entry_t));
+  qsort(sorted, sketch->n_heavy, sizeof(sketch_entry_t), compare_entries);
+  for (size_t i = 0; i < sketch->n_heavy; i++)
+    fprintf(outfile, "%i\t%s\n", (int)sorted[i].count, sorted[i].word);
+  free(sorted);
+}
+
+size_t sketch_bytes(sketch_t* sketch) {
+  size_t bytes = sketch->width * sketch->depth * sizeof(uint32_t);
+  bytes += sketch->k * sizeof(sketch_entry_t) + sketch->index_capacity * sizeof(size_t);
+  for (size_t i = 0; i < sketch->n_heavy; i++)
+    bytes += strlen(sketch->heavy[i].word) + 1;
+  return bytes;
+}
+
+void sketch_free(sketch_t* sketch) {
+  for (size_t i = 0; i < sketch->n_heavy; i++)
+    free(sketch->heavy[i].word);
+  free(sketch->counters);
+  free(sketch->heavy);
+  free(sketch->index);
+  memset(sketch, 0, sizeof(sketch_t));
+}
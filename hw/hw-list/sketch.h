@@ -0,0 +1,65 @@
+/*
+ * The sketch interface finds the most frequent words of a stream in memory
+ * that does not grow with the vocabulary, for inputs too large to count
+ * exactly.
+ *
+ * A count-min sketch (depth rows of width counters) estimates the count of
+ * every word; estimates never fall below the true count and exceed it by at
+ * most e/width of the stream length with probability 1 - e^-depth. Alongside
+ * it, the k words with the highest estimates so far are kept as heavy-hitter
+ * candidates in a min-heap, indexed by hash so a candidate is found in O(1).
+ */
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct sketch_entry {
+  char* word;
+  uint64_t hash;
+  uint32_t count; /* Estimate when last seen */
+  size_t slot;    /* Position in the index */
+} sketch_entry_t;
+
+typedef struct sketch {
+  uint32_t* counters; /* depth rows of width counters */
+  size_t width;       /* A power of two */
+  size_t depth;
+  sketch_entry_t* heavy; /* Min-heap of candidates by (count, word) */
+  size_t n_heavy;
+  size_t k;
+  size_t* index; /* Open addressing: heap position + 1, or 0 if empty */
+  size_t index_capacity;
+  uint64_t total; /* Words added */
+} sketch_t;
+
+/*
+ * Initialize a sketch that reports the k most frequent words, with depth rows
+ * of width counters; width is rounded up to a power of two. Returns false if
+ * out of memory.
+ */
+bool sketch_init(sketch_t* sketch, size_t k, size_t width, size_t depth);
+
+/* Count the len bytes at word. Returns false if out of memory. */
+bool sketch_add(sketch_t* sketch, const char* word, size_t len);
+
+/* Estimated count of the len bytes at word. Never less than the true count. */
+uint32_t sketch_estimate(sketch_t* sketch, const char* word, size_t len);
+
+/*
+ * Print the candidates with their estimated counts, in the format and order
+ * of fprint_words() after wordcount_sort() with less_count().
+ */
+void sketch_fprint_top(sketch_t* sketch, FILE* outfile);
+
+/* Bytes held by the sketch, its candidates and their words. */
+size_t sketch_bytes(sketch_t* sketch);
+
+/* Release the sketch. */
+void sketch_free(sketch_t* sketch);
+
+#endif /* SKETCH_H */
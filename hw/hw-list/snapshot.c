@@ -0,0 +1,404 @@
+/*
+ * Implementation of the snapshot interface.
+ *
+ * Readers treat the mapped file as untrusted: every varint and length is
+ * checked against the end of the records, so a truncated or corrupt file
+ * makes lookups and iteration fail rather than read out of bounds.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+
+#define MAGIC_SIZE 8
+
+static uint32_t crc_table[256];
+
+/* Table for the reflected CRC-32 polynomial used by zlib and Ethernet. */
+__attribute__((constructor)) static void init_crc_table(void) {
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int bit = 0; bit < 8; bit++)
+      c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+    crc_table[i] = c;
+  }
+}
+
+/* Continues a CRC-32 started at 0 over len more bytes. */
+static uint32_t crc32_update(uint32_t crc, const void* data, size_t len) {
+  const unsigned char* p = data;
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++)
+    crc = crc_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+static void put_le(unsigned char* out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++)
+    out[i] = value >> (8 * i);
+}
+
+static uint64_t get_le(const unsigned char* in, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; i++)
+    value |= (uint64_t)in[i] << (8 * i);
+  return value;
+}
+
+/* Orders byte strings the way strcmp() orders words. */
+static int compare_bytes(const char* a, size_t a_len, const char* b, size_t b_len) {
+  int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+  if (cmp != 0)
+    return cmp;
+  return a_len < b_len ? -1 : a_len > b_len;
+}
+
+/* Writer */
+
+static bool put_bytes(snapshot_writer_t* writer, const void* data, size_t len) {
+  if (writer->failed)
+    return false;
+  writer->crc = crc32_update(writer->crc, data, len);
+  writer->offset += len;
+  if (fwrite(data, 1, len, writer->file) != len)
+    writer->failed = true;
+  return !writer->failed;
+}
+
+static bool put_varint(snapshot_writer_t* writer, uint64_t value) {
+  unsigned char buf[10];
+  size_t n = 0;
+  while (value >= 0x80) {
+    buf[n++] = value | 0x80;
+    value >>= 7;
+  }
+  buf[n++] = value;
+  return put_bytes(writer, buf, n);
+}
+
+bool snapshot_writer_init(snapshot_writer_t* writer, FILE* file) {
+  memset(writer, 0, sizeof(snapshot_writer_t));
+  writer->file = file;
+  writer->prev_size = 64;
+  writer->prev = malloc(writer->prev_size);
+  writer->restarts_capacity = 64;
+  writer->restarts = malloc(writer->restarts_capacity * sizeof(uint64_t));
+  if (writer->prev == NULL || writer->restarts == NULL) {
+    free(writer->prev);
+    free(writer->restarts);
+    return false;
+  }
+  /* A failed write is reported by snapshot_writer_finish() */
+  put_bytes(writer, SNAPSHOT_MAGIC, MAGIC_SIZE);
+  return true;
+}
+
+bool snapshot_write(snapshot_writer_t* writer, const char* word, size_t len, uint64_t count) {
+  if (writer->failed)
+    return false;
+  if (writer->n_entries > 0 && compare_bytes(writer->prev, writer->prev_len, word, len) >= 0) {
+    writer->failed = true;
+    return false;
+  }
+
+  size_t shared = 0;
+  if (writer->n_entries % RESTART_INTERVAL == 0) {
+    if (writer->n_restarts == writer->restarts_capacity) {
+      uint64_t* bigger =
+          realloc(writer->restarts, 2 * writer->restarts_capacity * sizeof(uint64_t));
+      if (bigger == NULL) {
+        writer->failed = true;
+        return false;
+      }
+      writer->restarts = bigger;
+      writer->restarts_capacity *= 2;
+    }
+    writer->restarts[writer->n_restarts++] = writer->offset;
+  } else {
+    while (shared < len && shared < writer->prev_len && word[shared] == writer->prev[shared])
+      shared++;
+  }
+
+  put_varint(writer, shared);
+  put_varint(writer, len - shared);
+  put_bytes(writer, word + shared, len - shared);
+  put_varint(writer, count);
+
+  if (len > writer->prev_size) {
+    char* bigger = realloc(writer->prev, 2 * len);
+    if (bigger == NULL) {
+      writer->failed = true;
+      return false;
+    }
+    writer->prev = bigger;
+    writer->prev_size = 2 * len;
+  }
+  memcpy(writer->prev, word, len);
+  writer->prev_len = len;
+  writer->n_entries++;
+  writer->total += count;
+  return !writer->failed;
+}
+
+bool snapshot_writer_finish(snapshot_writer_t* writer) {
+  uint64_t index_offset = writer->offset;
+  for (size_t i = 0; i < writer->n_restarts; i++) {
+    unsigned char buf[8];
+    put_le(buf, writer->restarts[i], 8);
+    put_bytes(writer, buf, 8);
+  }
+
+  unsigned char footer[SNAPSHOT_FOOTER_SIZE];
+  put_le(footer, index_offset, 8);
+  put_le(footer + 8, writer->n_entries, 8);
+  put_le(footer + 16, writer->total, 8);
+  put_le(footer + 24, writer->n_restarts, 4);
+  put_bytes(writer, footer, 28);
+  put_le(footer + 28, writer->crc, 4);
+  memcpy(footer + 32, SNAPSHOT_MAGIC, MAGIC_SIZE);
+  put_bytes(writer, footer + 28, 12);
+  if (fflush(writer->file) != 0)
+    writer->failed = true;
+
+  free(writer->prev);
+  free(writer->restarts);
+  writer->prev = NULL;
+  writer->restarts = NULL;
+  return !writer->failed;
+}
+
+/* Reader */
+
+bool snapshot_open(snapshot_t* snapshot, const char* path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < MAGIC_SIZE + SNAPSHOT_FOOTER_SIZE) {
+    close(fd);
+    return false;
+  }
+  snapshot->size = st.st_size;
+  void* data = mmap(NULL, snapshot->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+  snapshot->data = data;
+
+  const unsigned char* footer = snapshot->data + snapshot->size - SNAPSHOT_FOOTER_SIZE;
+  snapshot->index_offset = get_le(footer, 8);
+  snapshot->n_entries = get_le(footer + 8, 8);
+  snapshot->total = get_le(footer + 16, 8);
+  snapshot->n_restarts = get_le(footer + 24, 4);
+  uint64_t index_end = snapshot->size - SNAPSHOT_FOOTER_SIZE;
+  if (memcmp(snapshot->data, SNAPSHOT_MAGIC, MAGIC_SIZE) != 0 ||
+      memcmp(footer + 32, SNAPSHOT_MAGIC, MAGIC_SIZE) != 0 ||
+      snapshot->index_offset < MAGIC_SIZE || snapshot->index_offset > index_end ||
+      (index_end - snapshot->index_offset) / 8 != snapshot->n_restarts ||
+      (index_end - snapshot->index_offset) % 8 != 0) {
+    snapshot_close(snapshot);
+    return false;
+  }
+  return true;
+}
+
+bool snapshot_verify(const snapshot_t* snapshot) {
+  size_t covered = snapshot->size - 12;
+  return crc32_update(0, snapshot->data, covered) == get_le(snapshot->data + covered, 4);
+}
+
+void snapshot_close(snapshot_t* snapshot) {
+  if (snapshot->data != NULL)
+    munmap((void*)snapshot->data, snapshot->size);
+  snapshot->data = NULL;
+  snapshot->size = 0;
+}
+
+/* Decodes a varint at *offset, which must stay inside the records. */
+static bool get_varint(const snapshot_t* snapshot, uint64_t* offset, uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*offset >= snapshot->index_offset)
+      return false;
+    unsigned char byte = snapshot->data[(*offset)++];
+    *value |= (uint64_t)(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+bool snapshot_iter_init(snapshot_iter_t* iter, const snapshot_t* snapshot) {
+  iter->snapshot = snapshot;
+  iter->offset = MAGIC_SIZE;
+  iter->len = 0;
+  iter->size = 64;
+  iter->count = 0;
+  iter->word = malloc(iter->size);
+  return iter->word != NULL;
+}
+
+bool snapshot_next(snapshot_iter_t* iter) {
+  const snapshot_t* snapshot = iter->snapshot;
+  uint64_t shared, suffix;
+  if (iter->offset >= snapshot->index_offset || !get_varint(snapshot, &iter->offset, &shared) ||
+      !get_varint(snapshot, &iter->offset, &suffix) || shared > iter->len ||
+      suffix > snapshot->index_offset - iter->offset)
+    return false;
+
+  size_t len = shared + suffix;
+  if (len + 1 > iter->size) {
+    char* bigger = realloc(iter->word, 2 * (len + 1));
+    if (bigger == NULL)
+      return false;
+    iter->word = bigger;
+    iter->size = 2 * (len + 1);
+  }
+  memcpy(iter->word + shared, snapshot->data + iter->offset, suffix);
+  iter->word[len] = '\0';
+  iter->len = len;
+  iter->offset += suffix;
+  return get_varint(snapshot, &iter->offset, &iter->count);
+}
+
+void snapshot_iter_free(snapshot_iter_t* iter) {
+  free(iter->word);
+  iter->word = NULL;
+}
+
+/*
+ * Compares word with the first word of restart block i, which shares nothing
+ * and so can be read straight from the mapping. Returns -2 if it is corrupt.
+ */
+static int compare_restart(const snapshot_t* snapshot, uint32_t i, const char* word, size_t len) {
+  uint64_t offset = get_le(snapshot->data + snapshot->index_offset + 8 * (uint64_t)i, 8);
+  uint64_t shared, suffix;
+  if (offset < MAGIC_SIZE || !get_varint(snapshot, &offset, &shared) ||
+      !get_varint(snapshot, &offset, &suffix) || shared != 0 ||
+      suffix > snapshot->index_offset - offset)
+    return -2;
+  int cmp = compare_bytes((const char*)snapshot->data + offset, suffix, word, len);
+  return cmp < 0 ? -1 : cmp > 0;
+}
+
+bool snapshot_find(const snapshot_t* snapshot, const char* word, size_t len, uint64_t* count) {
+  /* Find the last restart whose word is at most word */
+  uint32_t lo = 0, hi = snapshot->n_restarts;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    int cmp = compare_restart(snapshot, mid, word, len);
+    if (cmp == -2)
+      return false;
+    if (cmp <= 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0)
+    return false;
+
+  snapshot_iter_t iter;
+  if (!snapshot_iter_init(&iter, snapshot))
+    return false;
+  iter.offset = get_le(snapshot->data + snapshot->index_offset + 8 * (uint64_t)(lo - 1), 8);
+  bool found = false;
+  for (int i = 0; i < RESTART_INTERVAL && snapshot_next(&iter); i++) {
+    int cmp = compare_bytes(iter.word, iter.len, word, len);
+    if (cmp >= 0) {
+      found = cmp == 0;
+      *count = iter.count;
+      break;
+    }
+  }
+  snapshot_iter_free(&iter);
+  return found;
+}
+
+/* Merge */
+
+static bool less_iter(snapshot_iter_t* iters, size_t* heap, size_t i, size_t j) {
+  snapshot_iter_t* a = &iters[heap[i]];
+  snapshot_iter_t* b = &iters[heap[j]];
+  return compare_bytes(a->word, a->len, b->word, b->len) < 0;
+}
+
+static void sift_down(snapshot_iter_t* iters, size_t* heap, size_t len, size_t i) {
+  for (;;) {
+    size_t least = i;
+    size_t left = 2 * i + 1, right = 2 * i + 2;
+    if (left < len && less_iter(iters, heap, left, least))
+      least = left;
+    if (right < len && less_iter(iters, heap, right, least))
+      least = right;
+    if (least == i)
+      return;
+    size_t tmp = heap[i];
+    heap[i] = heap[least];
+    heap[least] = tmp;
+    i = least;
+  }
+}
+
+/* An iterator stopped early by a corrupt record, not the end of its input. */
+static bool iter_failed(snapshot_iter_t* iter) {
+  return iter->offset < iter->snapshot->index_offset;
+}
+
+bool snapshot_merge(const snapshot_t* inputs, size_t n, snapshot_writer_t* writer) {
+  snapshot_iter_t* iters = calloc(n > 0 ? n : 1, sizeof(snapshot_iter_t));
+  size_t* heap = malloc((n > 0 ? n : 1) * sizeof(size_t));
+  char* current = NULL;
+  size_t current_size = 0;
+  bool ok = iters != NULL && heap != NULL;
+
+  size_t len = 0;
+  for (size_t i = 0; ok && i < n; i++) {
+    ok = snapshot_iter_init(&iters[i], &inputs[i]);
+    if (ok && snapshot_next(&iters[i]))
+      heap[len++] = i;
+    else if (ok)
+      ok = !iter_failed(&iters[i]);
+  }
+  for (size_t i = len / 2; ok && i-- > 0;)
+    sift_down(iters, heap, len, i);
+
+  while (ok && len > 0) {
+    /* Sum the least word across every input that has it */
+    snapshot_iter_t* least = &iters[heap[0]];
+    size_t word_len = least->len;
+    if (word_len + 1 > current_size) {
+      free(current);
+      current_size = 2 * (word_len + 1);
+      current = malloc(current_size);
+      if (current == NULL) {
+        ok = false;
+        break;
+      }
+    }
+    memcpy(current, least->word, word_len);
+    uint64_t count = 0;
+    while (len > 0 && compare_bytes(iters[heap[0]].word, iters[heap[0]].len, current, word_len) == 0) {
+      snapshot_iter_t* iter = &iters[heap[0]];
+      count += iter->count;
+      if (!snapshot_next(iter)) {
+        if (iter_failed(iter))
+          ok = false;
+        heap[0] = heap[--len];
+      }
+      sift_down(iters, heap, len, 0);
+    }
+    ok = ok && snapshot_write(writer, current, word_len, count);
+  }
+
+  for (size_t i = 0; iters != NULL && i < n; i++)
+    snapshot_iter_free(&iters[i]);
+  free(iters);
+  free(heap);
+  free(current);
+  return ok;
+}
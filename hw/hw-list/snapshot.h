@@ -0,0 +1,119 @@
+/*
+ * The snapshot interface stores word counts in a compact binary file that can
+ * be searched in place and merged with others in one streaming pass, so
+ * counts from many runs or machines combine without re-parsing text or
+ * re-hashing words.
+ *
+ * A snapshot holds words in strictly increasing byte order. Each record is
+ *
+ *   varint shared   bytes shared with the previous word
+ *   varint length   bytes that follow
+ *   bytes  suffix
+ *   varint count
+ *
+ * Every RESTART_INTERVAL-th record shares nothing, and its offset goes into
+ * an index after the records, so a lookup binary-searches the index and then
+ * decodes at most RESTART_INTERVAL records. A fixed footer closes the file:
+ *
+ *   u64 index offset, u64 entries, u64 total count, u32 restarts,
+ *   u32 CRC-32 of every byte before it, 8-byte magic
+ *
+ * All fixed-width integers are little-endian. The file also starts with the
+ * magic.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SNAPSHOT_MAGIC "WCSNAP1\n"
+#define SNAPSHOT_FOOTER_SIZE 40
+#define RESTART_INTERVAL 32
+
+typedef struct snapshot_writer {
+  FILE* file;
+  uint64_t offset; /* Bytes written so far */
+  uint32_t crc;
+  char* prev; /* Previous word, to share its prefix */
+  size_t prev_len;
+  size_t prev_size;
+  uint64_t n_entries;
+  uint64_t total;
+  uint64_t* restarts;
+  size_t n_restarts;
+  size_t restarts_capacity;
+  bool failed; /* Sticky: set by an error or a word out of order */
+} snapshot_writer_t;
+
+typedef struct snapshot {
+  const unsigned char* data; /* The whole file, mapped read-only */
+  size_t size;
+  uint64_t index_offset;
+  uint64_t n_entries;
+  uint64_t total;
+  uint32_t n_restarts;
+} snapshot_t;
+
+/* Walks a snapshot's records in order. */
+typedef struct snapshot_iter {
+  const snapshot_t* snapshot;
+  uint64_t offset; /* Next record */
+  char* word;      /* Current word, NUL-terminated */
+  size_t len;
+  size_t size;
+  uint64_t count;
+} snapshot_iter_t;
+
+/* Start a snapshot at the current position of file. Returns false if out of memory. */
+bool snapshot_writer_init(snapshot_writer_t* writer, FILE* file);
+
+/*
+ * Append the len bytes at word with count. Words must come in strictly
+ * increasing byte order. Returns false if one did not or a write failed.
+ */
+bool snapshot_write(snapshot_writer_t* writer, const char* word, size_t len, uint64_t count);
+
+/*
+ * Write the index and footer and release the writer. Returns false if any
+ * snapshot_write() failed or the tail could not be written; the file is
+ * then not a valid snapshot.
+ */
+bool snapshot_writer_finish(snapshot_writer_t* writer);
+
+/*
+ * Map the snapshot at path and check its header and footer. The records are
+ * not checksummed until snapshot_verify(), so opening is O(1). Returns false
+ * if the file cannot be mapped or is not a snapshot.
+ */
+bool snapshot_open(snapshot_t* snapshot, const char* path);
+
+/* Check the snapshot's CRC over the whole file. */
+bool snapshot_verify(const snapshot_t* snapshot);
+
+/* Store the count of the len bytes at word in *count. Returns false if it is absent. */
+bool snapshot_find(const snapshot_t* snapshot, const char* word, size_t len, uint64_t* count);
+
+/* Unmap the snapshot. */
+void snapshot_close(snapshot_t* snapshot);
+
+/* Position iter before the first record. Returns false if out of memory. */
+bool snapshot_iter_init(snapshot_iter_t* iter, const snapshot_t* snapshot);
+
+/* Advance to the next record. Returns false at the end or on a corrupt record. */
+bool snapshot_next(snapshot_iter_t* iter);
+
+/* Release the iterator. */
+void snapshot_iter_free(snapshot_iter_t* iter);
+
+/*
+ * Write to writer every word of the n snapshots with its total count, in one
+ * pass holding one record per input. Returns false on a corrupt input or a
+ * failed write. writer is not finished.
+ */
+bool snapshot_merge(const snapshot_t* inputs, size_t n, snapshot_writer_t* writer);
+
+#endif /* SNAPSHOT_H */
@@ -0,0 +1,202 @@
+/*
+ * Implementation of the spill interface on top of the hash table word_count
+ * backend.
+ *
+ * A run is a text file of "word count" lines in alphabetical order. Runs are
+ * unlinked as soon as they are created, so they vanish with the process
+ * however it exits. At most MAX_RUNS are kept open: when another would be
+ * needed, the runs so far are merged into one first.
+ */
+
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "spill.h"
+#include "word_helpers.h"
+
+#define MAX_RUNS 64
+
+/* An empty table and its first arena chunk take about 90K; leave room for words */
+#define MIN_BUDGET (256 * 1024)
+
+/* Creates an empty run file in dir, already unlinked. */
+static FILE* open_run(const char* dir) {
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/words.XXXXXX", dir);
+  int fd = mkstemp(path);
+  if (fd < 0)
+    return NULL;
+  unlink(path);
+  FILE* file = fdopen(fd, "w+");
+  if (file == NULL)
+    close(fd);
+  return file;
+}
+
+static bool write_entry(const word_count_t* wc, void* aux) {
+  return fprintf(aux, "%s %d\n", wc->word, wc->count) >= 0;
+}
+
+/* Reads the next line of run. Returns false at the end of the run. */
+static bool next_entry(spill_run_t* run) {
+  ssize_t n = getline(&run->word, &run->word_size, run->file);
+  if (n <= 0)
+    return false;
+  char* space = strrchr(run->word, ' ');
+  if (space == NULL)
+    return false;
+  *space = '\0';
+  run->count = atoi(space + 1);
+  return true;
+}
+
+static bool less_run(spill_t* spill, size_t* heap, size_t i, size_t j) {
+  return strcmp(spill->runs[heap[i]].word, spill->runs[heap[j]].word) < 0;
+}
+
+static void sift_down(spill_t* spill, size_t* heap, size_t len, size_t i) {
+  for (;;) {
+    size_t least = i;
+    size_t left = 2 * i + 1, right = 2 * i + 2;
+    if (left < len && less_run(spill, heap, left, least))
+      least = left;
+    if (right < len && less_run(spill, heap, right, least))
+      least = right;
+    if (least == i)
+      return;
+    size_t tmp = heap[i];
+    heap[i] = heap[least];
+    heap[least] = tmp;
+    i = least;
+  }
+}
+
+/* Merges every run into fn, then closes them all. */
+static bool merge_runs(spill_t* spill, spill_fn fn, void* aux) {
+  size_t* heap = malloc(spill->n_runs * sizeof(size_t));
+  char* current = NULL;
+  size_t current_size = 0;
+  bool ok = heap != NULL;
+
+  /* Every run starts at its first line; heapify them by word */
+  size_t len = 0;
+  for (size_t i = 0; ok && i < spill->n_runs; i++) {
+    rewind(spill->runs[i].file);
+    if (next_entry(&spill->runs[i]))
+      heap[len++] = i;
+  }
+  for (size_t i = len / 2; ok && i-- > 0;)
+    sift_down(spill, heap, len, i);
+
+  while (ok && len > 0) {
+    /* Sum the counts of the least word across every run that has it */
+    size_t word_len = strlen(spill->runs[heap[0]].word);
+    if (word_len + 1 > current_size) {
+      current_size = 2 * (word_len + 1);
+      free(current);
+      current = malloc(current_size);
+      if (current == NULL) {
+        ok = false;
+        break;
+      }
+    }
+    memcpy(current, spill->runs[heap[0]].word, word_len + 1);
+    word_count_t wc = {current, 0};
+    while (len > 0 && strcmp(spill->runs[heap[0]].word, current) == 0) {
+      wc.count += spill->runs[heap[0]].count;
+      if (!next_entry(&spill->runs[heap[0]]))
+        heap[0] = heap[--len];
+      sift_down(spill, heap, len, 0);
+    }
+    ok = fn(&wc, aux);
+  }
+
+  for (size_t i = 0; i < spill->n_runs; i++) {
+    if (ferror(spill->runs[i].file))
+      ok = false;
+    fclose(spill->runs[i].file);
+    free(spill->runs[i].word);
+  }
+  spill->n_runs = 0;
+  free(current);
+  free(heap);
+  return ok;
+}
+
+/* Sorts the table into a new run and empties it. */
+static bool write_run(spill_t* spill) {
+  if (spill->n_runs == MAX_RUNS) {
+    /* Fold the open runs into one, so open files stay bounded */
+    FILE* file = open_run(spill->dir);
+    if (file == NULL)
+      return false;
+    if (!merge_runs(spill, write_entry, file) || fflush(file) != 0) {
+      fclose(file);
+      return false;
+    }
+    spill->runs[spill->n_runs++] = (spill_run_t){file, NULL, 0, 0};
+  }
+
+  FILE* file = open_run(spill->dir);
+  if (file == NULL)
+    return false;
+  wordcount_sort(&spill->table, less_word);
+  bool ok = true;
+  for (size_t i = 0; ok && i < spill->table.len; i++)
+    ok = write_entry(spill->table.words[i], file);
+  if (!ok || fflush(file) != 0) {
+    fclose(file);
+    return false;
+  }
+  spill->runs[spill->n_runs++] = (spill_run_t){file, NULL, 0, 0};
+  spill->spilled += spill->table.len;
+
+  free_words(&spill->table);
+  init_words(&spill->table);
+  return spill->table.slots != NULL && spill->table.words != NULL;
+}
+
+bool spill_init(spill_t* spill, size_t budget, const char* dir) {
+  init_words(&spill->table);
+  spill->budget = budget > MIN_BUDGET ? budget : MIN_BUDGET;
+  spill->dir = dir;
+  spill->runs = malloc(MAX_RUNS * sizeof(spill_run_t));
+  spill->n_runs = 0;
+  spill->spilled = 0;
+  return spill->runs != NULL && spill->table.slots != NULL && spill->table.words != NULL;
+}
+
+bool spill_add(spill_t* spill, const char* word, size_t len) {
+  if (add_word_span(&spill->table, word, len) == NULL)
+    return false;
+  if (words_bytes(&spill->table) > spill->budget)
+    return write_run(spill);
+  return true;
+}
+
+bool spill_merge(spill_t* spill, spill_fn fn, void* aux) {
+  if (spill->n_runs == 0) {
+    /* Everything fit in the budget: no need to touch the disk */
+    wordcount_sort(&spill->table, less_word);
+    for (size_t i = 0; i < spill->table.len; i++) {
+      if (!fn(spill->table.words[i], aux))
+        return false;
+    }
+    return true;
+  }
+  if (spill->table.len > 0 && !write_run(spill))
+    return false;
+  return merge_runs(spill, fn, aux);
+}
+
+void spill_free(spill_t* spill) {
+  for (size_t i = 0; i < spill->n_runs; i++) {
+    fclose(spill->runs[i].file);
+    free(spill->runs[i].word);
+  }
+  free(spill->runs);
+  free_words(&spill->table);
+  spill->runs = NULL;
+  spill->n_runs = 0;
+}
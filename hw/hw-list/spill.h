@@ -0,0 +1,59 @@
+/*
+ * The spill interface counts words in bounded memory, for vocabularies too
+ * large to hold in one table.
+ *
+ * Words are counted into an ordinary hash table until it holds more than the
+ * budget. The table is then sorted alphabetically, written to a run file
+ * and emptied. At the end a k-way merge over the runs streams every word
+ * with its total count in alphabetical order, holding one word per run.
+ */
+
+#ifndef SPILL_H
+#define SPILL_H
+
+#ifndef HASH_TABLE
+#error "HASH_TABLE must be #define'd to use the spill interface"
+#endif
+
+#include "word_count.h"
+
+typedef struct spill_run {
+  FILE* file; /* Unlinked temporary file, closed once it is used up */
+  char* word; /* Current line: a word and its count in this run */
+  size_t word_size;
+  int count;
+} spill_run_t;
+
+typedef struct spill {
+  word_count_list_t table;
+  size_t budget;   /* Bytes the table may hold before it is written out */
+  const char* dir; /* Where run files go */
+  spill_run_t* runs;
+  size_t n_runs;
+  size_t spilled; /* Entries written across all runs */
+} spill_t;
+
+/* Called with each word and its total count; returns false to stop. */
+typedef bool (*spill_fn)(const word_count_t* wc, void* aux);
+
+/*
+ * Initialize an empty count that writes runs to dir whenever its table holds
+ * more than budget bytes, or 256K if budget is smaller. Returns false if out
+ * of memory.
+ */
+bool spill_init(spill_t* spill, size_t budget, const char* dir);
+
+/* Count the len bytes at word. Returns false if out of memory or a run could not be written. */
+bool spill_add(spill_t* spill, const char* word, size_t len);
+
+/*
+ * Pass every word counted and its total to fn, in alphabetical order. Words
+ * passed to fn are only valid during the call. Returns false if a run could
+ * not be read or fn stopped early.
+ */
+bool spill_merge(spill_t* spill, spill_fn fn, void* aux);
+
+/* Release the table and close and remove every run. */
+void spill_free(spill_t* spill);
+
+#endif /* SPILL_H */
@@ -0,0 +1,246 @@
+/*
+ * Stress test for concurrent adds to one word count list.
+ *
+ * For each thread count, that many threads add their share of a Zipf
+ * distributed stream of words to a single shared table at once. Afterwards
+ * every word's count is checked against an exact tally, and the throughput is
+ * printed. Built twice: stress_global uses the hash table behind one mutex
+ * (HASH_TABLE and PTHREADS), stress_striped the lock-striped table (STRIPED
+ * as well), so the two can be compared on the same workload.
+ *
+ * usage: stress [-t threads,threads,...] [-n words] [-v vocabulary] [-s exponent]
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "word_count.h"
+
+typedef struct vocabulary {
+  char* pool;      /* Every word, NUL-terminated, back to back */
+  size_t* offsets; /* Start of word i in pool */
+  size_t* lengths;
+  size_t size;
+} vocabulary_t;
+
+typedef struct producer {
+  word_count_list_t* wclist;
+  vocabulary_t* vocabulary;
+  const uint32_t* tokens; /* This thread's share of the stream */
+  size_t n_tokens;
+  pthread_barrier_t* start;
+  bool failed;
+} producer_t;
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Word i is i + 26 in base 26 written with letters, so every word has two or more. */
+static size_t spell(size_t i, char* out) {
+  char digits[16];
+  size_t len = 0;
+  for (size_t n = i + 26; n > 0; n /= 26)
+    digits[len++] = 'a' + n % 26;
+  for (size_t j = 0; j < len; j++)
+    out[j] = digits[len - 1 - j];
+  out[len] = '\0';
+  return len;
+}
+
+static bool make_vocabulary(vocabulary_t* vocabulary, size_t size) {
+  vocabulary->size = size;
+  vocabulary->pool = malloc(size * 8);
+  vocabulary->offsets = malloc(size * sizeof(size_t));
+  vocabulary->lengths = malloc(size * sizeof(size_t));
+  if (vocabulary->pool == NULL || vocabulary->offsets == NULL || vocabulary->lengths == NULL)
+    return false;
+  size_t used = 0;
+  for (size_t i = 0; i < size; i++) {
+    vocabulary->offsets[i] = used;
+    vocabulary->lengths[i] = spell(i, vocabulary->pool + used);
+    used += vocabulary->lengths[i] + 1;
+  }
+  return true;
+}
+
+/* Draws n_tokens word indices from a Zipf distribution and tallies them in expected. */
+static uint32_t* make_stream(size_t n_tokens, size_t size, double exponent, int* expected) {
+  uint32_t* tokens = malloc(n_tokens * sizeof(uint32_t));
+  double* cdf = malloc(size * sizeof(double));
+  if (tokens == NULL || cdf == NULL) {
+    free(tokens);
+    free(cdf);
+    return NULL;
+  }
+  double sum = 0;
+  for (size_t i = 0; i < size; i++) {
+    sum += 1 / pow(i + 1, exponent);
+    cdf[i] = sum;
+  }
+  srand(162);
+  for (size_t t = 0; t < n_tokens; t++) {
+    double u = (double)rand() / RAND_MAX * sum;
+    size_t lo = 0, hi = size - 1;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (cdf[mid] < u)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    tokens[t] = lo;
+    expected[lo]++;
+  }
+  free(cdf);
+  return tokens;
+}
+
+static void* produce(void* arg) {
+  producer_t* producer = arg;
+  vocabulary_t* vocabulary = producer->vocabulary;
+  pthread_barrier_wait(producer->start);
+  for (size_t t = 0; t < producer->n_tokens; t++) {
+    uint32_t i = producer->tokens[t];
+    if (add_word_span(producer->wclist, vocabulary->pool + vocabulary->offsets[i],
+                      vocabulary->lengths[i]) == NULL) {
+      producer->failed = true;
+      break;
+    }
+  }
+  return NULL;
+}
+
+/* Runs one round with n_threads producers; returns the number of wrong counts, or -1. */
+static long run(int n_threads, vocabulary_t* vocabulary, const uint32_t* tokens, size_t n_tokens,
+                const int* expected, double* seconds) {
+  /* The striped table asks for cache-line alignment, which malloc() does not promise */
+  void* table;
+  if (posix_memalign(&table, 64, sizeof(word_count_list_t)) != 0)
+    return -1;
+  word_count_list_t* wclist = table;
+  pthread_t* threads = malloc(n_threads * sizeof(pthread_t));
+  producer_t* producers = malloc(n_threads * sizeof(producer_t));
+  if (threads == NULL || producers == NULL)
+    return -1;
+  init_words(wclist);
+
+  pthread_barrier_t start;
+  pthread_barrier_init(&start, NULL, n_threads + 1);
+  size_t share = n_tokens / n_threads;
+  for (int i = 0; i < n_threads; i++) {
+    size_t first = share * i;
+    size_t n = i == n_threads - 1 ? n_tokens - first : share;
+    producers[i] = (producer_t){wclist, vocabulary, tokens + first, n, &start, false};
+    if (pthread_create(&threads[i], NULL, produce, &producers[i]) != 0)
+      return -1;
+  }
+  pthread_barrier_wait(&start);
+  double begin = now_seconds();
+  for (int i = 0; i < n_threads; i++)
+    pthread_join(threads[i], NULL);
+  *seconds = now_seconds() - begin;
+  pthread_barrier_destroy(&start);
+
+  long wrong = 0;
+  size_t seen = 0;
+  for (size_t i = 0; i < vocabulary->size; i++) {
+    word_count_t* wc = find_word(wclist, vocabulary->pool + vocabulary->offsets[i]);
+    int count = wc != NULL ? wc->count : 0;
+    if (count != expected[i])
+      wrong++;
+    if (count > 0)
+      seen++;
+  }
+  /* A word inserted twice would pass find_word() but show up here */
+  if (seen != len_words(wclist))
+    wrong++;
+  for (int i = 0; i < n_threads; i++) {
+    if (producers[i].failed)
+      wrong++;
+  }
+
+  free_words(wclist);
+  free(wclist);
+  free(threads);
+  free(producers);
+  return wrong;
+}
+
+static void usage(const char* prog) {
+  fprintf(stderr, "usage: %s [-t threads,threads,...] [-n words] [-v vocabulary] [-s exponent]\n",
+          prog);
+}
+
+int main(int argc, char* argv[]) {
+  size_t n_tokens = 4000000, size = 100000;
+  double exponent = 1.0;
+  char default_threads[] = "1,2,4,8,16,32";
+  char* thread_list = default_threads;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:n:v:s:h")) != -1) {
+    switch (opt) {
+      case 't':
+        thread_list = optarg;
+        break;
+      case 'n':
+        n_tokens = strtoul(optarg, NULL, 10);
+        break;
+      case 'v':
+        size = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        exponent = atof(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || n_tokens == 0 || size == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  vocabulary_t vocabulary;
+  int* expected = calloc(size, sizeof(int));
+  uint32_t* tokens = NULL;
+  if (expected == NULL || !make_vocabulary(&vocabulary, size) ||
+      (tokens = make_stream(n_tokens, size, exponent, expected)) == NULL) {
+    perror("malloc");
+    return 1;
+  }
+
+#ifdef STRIPED
+  const char* table = "striped";
+#else
+  const char* table = "global";
+#endif
+  printf("%-8s %8s %10s %12s %s\n", "table", "threads", "time (s)", "Mwords/s", "counts");
+  int status = 0;
+  for (char* t = strtok(thread_list, ","); t != NULL; t = strtok(NULL, ",")) {
+    int n_threads = atoi(t);
+    if (n_threads < 1)
+      continue;
+    double seconds;
+    long wrong = run(n_threads, &vocabulary, tokens, n_tokens, expected, &seconds);
+    if (wrong != 0)
+      status = 1;
+    printf("%-8s %8d %10.3f %12.2f %s\n", table, n_threads, seconds, n_tokens / seconds / 1e6,
+           wrong == 0 ? "ok" : "WRONG");
+  }
+
+  free(tokens);
+  free(expected);
+  free(vocabulary.pool);
+  free(vocabulary.offsets);
+  free(vocabulary.lengths);
+  return status;
+}
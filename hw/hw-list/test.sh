@@ -16,12 +16,14 @@ FILES=("gutenberg/alice.txt" "gutenberg/metamorphosis.txt" "gutenberg/peter.txt"
 # Temporary files
 TMP_PWORDS="/tmp/pwords_output.txt"
 TMP_WORDS="/tmp/words_output.txt"
+TMP_SNAPSHOTS=$(mktemp -d)
 TIME_PWORDS="/tmp/pwords_time.txt"
 TIME_WORDS="/tmp/words_time.txt"
 
 # Cleanup function
 cleanup() {
     rm -f "$TMP_PWORDS" "$TMP_WORDS" "$TIME_PWORDS" "$TIME_WORDS"
+    rm -rf "$TMP_SNAPSHOTS"
 }
 
 # Register cleanup function
@@ -125,5 +127,124 @@ else
     echo -e "${YELLOW}Note: 'bc' calculator not available, skipping speed ratio calculation${NC}"
 fi
 
+echo "=============================================="
+
+# Check the hash table backends against ./lwords
+echo -e "${BLUE}Hash table backends:${NC}"
+for prog in ./hwords ./hpwords ./mpwords ./cpwords ./spwords; do
+    if [ ! -f "$prog" ]; then
+        echo -e "${RED}Error: $prog does not exist${NC}"
+        continue
+    fi
+    { time $prog "${FILES[@]}" > "$TMP_PWORDS" 2>&1 ; } 2> "$TIME_PWORDS"
+    prog_time=$(grep real "$TIME_PWORDS" | awk '{print $2}')
+    if diff -q "$TMP_PWORDS" "$TMP_WORDS" > /dev/null; then
+        echo -e "${GREEN}✓ $prog output matches ./lwords${NC} (real $prog_time)"
+    else
+        echo -e "${RED}✗ $prog output differs from ./lwords${NC}"
+    fi
+done
+
+echo "=============================================="
+
+# --top N must print exactly the last N lines of the full output
+echo -e "${BLUE}Top-K selection:${NC}"
+for prog in ./hwords ./pwords ./hpwords ./mpwords ./cpwords ./spwords; do
+    if [ ! -f "$prog" ]; then
+        echo -e "${RED}Error: $prog does not exist${NC}"
+        continue
+    fi
+    $prog --top 100 "${FILES[@]}" > "$TMP_PWORDS" 2>&1
+    if tail -n 100 "$TMP_WORDS" | diff -q "$TMP_PWORDS" - > /dev/null; then
+        echo -e "${GREEN}✓ $prog --top 100 matches the last 100 lines${NC}"
+    else
+        echo -e "${RED}✗ $prog --top 100 differs from the last 100 lines${NC}"
+    fi
+    if $prog --top abc "${FILES[@]}" > /dev/null 2>&1; then
+        echo -e "${RED}✗ $prog accepts --top abc${NC}"
+    else
+        echo -e "${GREEN}✓ $prog rejects --top abc${NC}"
+    fi
+done
+# The sketch's estimates are upper bounds, but at this size they are exact
+./hwords --top 10 --approx "${FILES[@]}" > "$TMP_PWORDS" 2>&1
+if tail -n 10 "$TMP_WORDS" | diff -q "$TMP_PWORDS" - > /dev/null; then
+    echo -e "${GREEN}✓ ./hwords --top 10 --approx matches the last 10 lines${NC}"
+else
+    echo -e "${YELLOW}! ./hwords --top 10 --approx differs from the last 10 lines${NC}"
+fi
+for width in abc 0 -1; do
+    if ./hwords --top 10 --approx=$width "${FILES[@]}" > /dev/null 2>&1; then
+        echo -e "${RED}✗ ./hwords accepts --approx=$width${NC}"
+    else
+        echo -e "${GREEN}✓ ./hwords rejects --approx=$width${NC}"
+    fi
+done
+
+echo "=============================================="
+
+# A budget far below the vocabulary forces many runs through the merge
+echo -e "${BLUE}Spill to disk:${NC}"
+./hwords --spill=256K "${FILES[@]}" > "$TMP_PWORDS" 2>&1
+if LC_ALL=C sort -t$'\t' -k2,2 "$TMP_WORDS" | diff -q "$TMP_PWORDS" - > /dev/null; then
+    echo -e "${GREEN}✓ ./hwords --spill=256K matches ./lwords in alphabetical order${NC}"
+else
+    echo -e "${RED}✗ ./hwords --spill=256K differs from ./lwords in alphabetical order${NC}"
+fi
+./hwords --spill=256K --top 100 "${FILES[@]}" > "$TMP_PWORDS" 2>&1
+if tail -n 100 "$TMP_WORDS" | diff -q "$TMP_PWORDS" - > /dev/null; then
+    echo -e "${GREEN}✓ ./hwords --spill=256K --top 100 matches the last 100 lines${NC}"
+else
+    echo -e "${RED}✗ ./hwords --spill=256K --top 100 differs from the last 100 lines${NC}"
+fi
+
+echo "=============================================="
+
+# Many threads adding to one table must not lose or duplicate a count
+echo -e "${BLUE}Concurrent adds:${NC}"
+for prog in ./stress_global ./stress_striped; do
+    if $prog -n 200000 -t 1,8,32 > "$TMP_PWORDS" 2>&1; then
+        echo -e "${GREEN}✓ $prog counts are exact with 1, 8 and 32 threads${NC}"
+    else
+        echo -e "${RED}✗ $prog counts are wrong${NC}"
+        cat "$TMP_PWORDS"
+    fi
+done
+
+echo "=============================================="
+
+# Snapshots of parts of the input, from different backends, must merge into
+# the same counts as one run over all of it
+echo -e "${BLUE}Binary snapshots:${NC}"
+HALF=$(( (${#FILES[@]} + 1) / 2 ))
+./pwords --snapshot="$TMP_SNAPSHOTS/first" "${FILES[@]:0:$HALF}"
+./hwords --spill=256K --snapshot="$TMP_SNAPSHOTS/second" "${FILES[@]:$HALF}"
+./wcsnap merge "$TMP_SNAPSHOTS/all" "$TMP_SNAPSHOTS/first" "$TMP_SNAPSHOTS/second"
+if ./wcsnap verify "$TMP_SNAPSHOTS/all" > /dev/null &&
+    ./wcsnap dump "$TMP_SNAPSHOTS/all" > "$TMP_PWORDS" &&
+    LC_ALL=C sort -t$'\t' -k2,2 "$TMP_WORDS" | diff -q "$TMP_PWORDS" - > /dev/null; then
+    echo -e "${GREEN}✓ merged snapshots match ./lwords in alphabetical order${NC}"
+else
+    echo -e "${RED}✗ merged snapshots differ from ./lwords in alphabetical order${NC}"
+fi
+WORD=$(tail -n 1 "$TMP_WORDS")
+if [ "$(./wcsnap lookup "$TMP_SNAPSHOTS/all" "${WORD#*$'\t'}")" = "$WORD" ]; then
+    echo -e "${GREEN}✓ ./wcsnap lookup finds the most frequent word${NC}"
+else
+    echo -e "${RED}✗ ./wcsnap lookup of the most frequent word is wrong${NC}"
+fi
+
+echo "=============================================="
+
+# Every program in the benchmark harness must agree on a small synthetic corpus
+echo -e "${BLUE}Benchmark harness:${NC}"
+if ./bench.sh -s 0.1 -z 1.0 -t "1 2" -l 0.1 > "$TMP_PWORDS" 2> /dev/null &&
+    ! tail -n +2 "$TMP_PWORDS" | grep -v ',match$' > /dev/null; then
+    echo -e "${GREEN}✓ ./bench.sh runs every program and all outputs match${NC}"
+else
+    echo -e "${RED}✗ ./bench.sh failed or an output differs${NC}"
+    cat "$TMP_PWORDS"
+fi
+
 echo "=============================================="
 echo -e "${BLUE}Comparison completed${NC}"
\ No newline at end of file
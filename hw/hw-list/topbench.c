@@ -0,0 +1,256 @@
+/*
+ * Benchmark of top-K selection against sorting every word.
+ *
+ * Builds a Zipf-distributed corpus in memory, counts it exactly with the hash
+ * table backend, then for each K times top_words() against wordcount_sort()
+ * over the same table. The same corpus is also fed to a count-min sketch with
+ * K heavy-hitter candidates, reporting its time, memory and how many of the
+ * true top K it found.
+ *
+ * usage: topbench [-n words] [-v vocabulary] [-s exponent] [-w sketch width] [-k K,K,...]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sketch.h"
+#include "word_count.h"
+#include "word_helpers.h"
+
+#define PASSES 3
+#define SKETCH_DEPTH 4
+
+typedef struct corpus {
+  char* pool;       /* Every vocabulary word, NUL-terminated, back to back */
+  size_t* offsets;  /* Start of word i in pool */
+  uint32_t* tokens; /* The text, as vocabulary indices */
+  size_t n_tokens;
+  size_t vocabulary;
+} corpus_t;
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Word i is i + 26 in base 26 written with letters, so every word has two or more. */
+static size_t spell(size_t i, char* out) {
+  char digits[16];
+  size_t len = 0;
+  for (size_t n = i + 26; n > 0; n /= 26)
+    digits[len++] = 'a' + n % 26;
+  for (size_t j = 0; j < len; j++)
+    out[j] = digits[len - 1 - j];
+  out[len] = '\0';
+  return len;
+}
+
+static bool make_corpus(corpus_t* corpus, size_t n_tokens, size_t vocabulary, double exponent) {
+  corpus->n_tokens = n_tokens;
+  corpus->vocabulary = vocabulary;
+  corpus->pool = malloc(vocabulary * 8);
+  corpus->offsets = malloc(vocabulary * sizeof(size_t));
+  corpus->tokens = malloc(n_tokens * sizeof(uint32_t));
+  double* cdf = malloc(vocabulary * sizeof(double));
+  if (corpus->pool == NULL || corpus->offsets == NULL || corpus->tokens == NULL || cdf == NULL) {
+    free(cdf);
+    return false;
+  }
+
+  size_t used = 0;
+  double sum = 0;
+  for (size_t i = 0; i < vocabulary; i++) {
+    corpus->offsets[i] = used;
+    used += spell(i, corpus->pool + used) + 1;
+    sum += 1 / pow(i + 1, exponent);
+    cdf[i] = sum;
+  }
+
+  srand(162);
+  for (size_t t = 0; t < n_tokens; t++) {
+    double u = (double)rand() / RAND_MAX * sum;
+    size_t lo = 0, hi = vocabulary - 1;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (cdf[mid] < u)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    corpus->tokens[t] = lo;
+  }
+  free(cdf);
+  return true;
+}
+
+static const char* token(corpus_t* corpus, size_t t) {
+  return corpus->pool + corpus->offsets[corpus->tokens[t]];
+}
+
+/* Puts the entry array in a random order, so no pass sees presorted input. */
+static void shuffle(word_count_list_t* wclist) {
+  for (size_t i = wclist->len; i > 1; i--) {
+    size_t j = rand() % i;
+    word_count_t* tmp = wclist->words[i - 1];
+    wclist->words[i - 1] = wclist->words[j];
+    wclist->words[j] = tmp;
+  }
+}
+
+static double time_sort(word_count_list_t* wclist) {
+  double best = 0;
+  for (int pass = 0; pass < PASSES; pass++) {
+    shuffle(wclist);
+    double start = now_seconds();
+    wordcount_sort(wclist, less_count);
+    double elapsed = now_seconds() - start;
+    if (pass == 0 || elapsed < best)
+      best = elapsed;
+  }
+  return best;
+}
+
+static double time_top(word_count_list_t* wclist, size_t k, word_count_t** top) {
+  double best = 0;
+  for (int pass = 0; pass < PASSES; pass++) {
+    shuffle(wclist);
+    double start = now_seconds();
+    top_words(wclist, k, less_count, top);
+    double elapsed = now_seconds() - start;
+    if (pass == 0 || elapsed < best)
+      best = elapsed;
+  }
+  return best;
+}
+
+/*
+ * Counts the corpus into a sketch with k candidates and prints how it did
+ * against the exact top k, which is the tail of the sorted table.
+ */
+static void run_sketch(corpus_t* corpus, word_count_list_t* exact, size_t k, size_t width) {
+  sketch_t sketch;
+  if (!sketch_init(&sketch, k, width, SKETCH_DEPTH)) {
+    perror("sketch_init");
+    exit(1);
+  }
+  double start = now_seconds();
+  for (size_t t = 0; t < corpus->n_tokens; t++) {
+    const char* word = token(corpus, t);
+    sketch_add(&sketch, word, strlen(word));
+  }
+  double elapsed = now_seconds() - start;
+
+  size_t n = k < exact->len ? k : exact->len;
+  size_t found = 0;
+  double worst_error = 0;
+  for (size_t i = exact->len - n; i < exact->len; i++) {
+    word_count_t* wc = exact->words[i];
+    for (size_t j = 0; j < sketch.n_heavy; j++) {
+      if (strcmp(sketch.heavy[j].word, wc->word) == 0) {
+        found++;
+        break;
+      }
+    }
+    double error = (double)sketch_estimate(&sketch, wc->word, strlen(wc->word)) / wc->count - 1;
+    if (error > worst_error)
+      worst_error = error;
+  }
+  printf("%-10s %8zu %10.1f %12.1f %9.1f%% %9.2f%%\n", "sketch", k, elapsed * 1e3,
+         sketch_bytes(&sketch) / 1024.0, n > 0 ? 100.0 * found / n : 100.0, 100 * worst_error);
+  sketch_free(&sketch);
+}
+
+static void usage(const char* prog) {
+  fprintf(stderr,
+          "usage: %s [-n words] [-v vocabulary] [-s exponent] [-w sketch width] [-k K,K,...]\n",
+          prog);
+}
+
+int main(int argc, char* argv[]) {
+  size_t n_tokens = 10000000, vocabulary = 1000000, width = 1 << 16;
+  double exponent = 1.0;
+  char default_ks[] = "10,100,1000,10000";
+  char* ks = default_ks;
+  int opt;
+  while ((opt = getopt(argc, argv, "n:v:s:w:k:h")) != -1) {
+    switch (opt) {
+      case 'n':
+        n_tokens = strtoul(optarg, NULL, 10);
+        break;
+      case 'v':
+        vocabulary = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        exponent = atof(optarg);
+        break;
+      case 'w':
+        width = strtoul(optarg, NULL, 10);
+        break;
+      case 'k':
+        ks = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc || n_tokens == 0 || vocabulary == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  corpus_t corpus;
+  if (!make_corpus(&corpus, n_tokens, vocabulary, exponent)) {
+    perror("make_corpus");
+    return 1;
+  }
+
+  word_count_list_t exact;
+  init_words(&exact);
+  double start = now_seconds();
+  for (size_t t = 0; t < corpus.n_tokens; t++) {
+    const char* word = token(&corpus, t);
+    add_word_span(&exact, word, strlen(word));
+  }
+  double count_seconds = now_seconds() - start;
+
+  printf("Corpus: %zu words, Zipf exponent %.2f, %zu of %zu vocabulary words seen\n", n_tokens,
+         exponent, exact.len, vocabulary);
+  printf("Exact count: %.1f ms, table %.1f KB\n", count_seconds * 1e3, words_bytes(&exact) / 1024.0);
+  printf("Sketch: %d rows of %zu counters\n", SKETCH_DEPTH, width);
+  printf("%-10s %8s %10s %12s %10s %10s\n", "method", "K", "time (ms)", "memory (KB)", "recall",
+         "max error");
+
+  /* Sorting copies the entry array into a scratch buffer of the same size. */
+  double sort_seconds = time_sort(&exact);
+  printf("%-10s %8s %10.1f %12.1f %10s %10s\n", "sort", "all", sort_seconds * 1e3,
+         exact.len * sizeof(word_count_t*) / 1024.0, "-", "-");
+
+  for (char* k_str = strtok(ks, ","); k_str != NULL; k_str = strtok(NULL, ",")) {
+    size_t k = strtoul(k_str, NULL, 10);
+    word_count_t** top = malloc((k > 0 ? k : 1) * sizeof(word_count_t*));
+    if (top == NULL) {
+      perror("malloc");
+      return 1;
+    }
+    double top_seconds = time_top(&exact, k, top);
+    printf("%-10s %8zu %10.1f %12.1f %10s %10s\n", "heap", k, top_seconds * 1e3,
+           k * sizeof(word_count_t*) / 1024.0, "-", "-");
+    free(top);
+
+    /* Leave the table sorted so the sketch can be checked against its tail */
+    wordcount_sort(&exact, less_count);
+    run_sketch(&corpus, &exact, k, width);
+  }
+
+  free_words(&exact);
+  free(corpus.pool);
+  free(corpus.offsets);
+  free(corpus.tokens);
+  return 0;
+}
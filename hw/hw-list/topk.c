@@ -0,0 +1,80 @@
+/*
+ * Implementation of the topk interface as a binary min-heap in an array.
+ */
+
+#include <stdlib.h>
+
+#include "topk.h"
+
+static bool less_at(topk_t* topk, size_t i, size_t j) {
+  return topk->less(topk->heap[i], topk->heap[j], topk->aux);
+}
+
+static void swap(topk_t* topk, size_t i, size_t j) {
+  const void* tmp = topk->heap[i];
+  topk->heap[i] = topk->heap[j];
+  topk->heap[j] = tmp;
+}
+
+static void sift_up(topk_t* topk, size_t i) {
+  while (i > 0 && less_at(topk, i, (i - 1) / 2)) {
+    swap(topk, i, (i - 1) / 2);
+    i = (i - 1) / 2;
+  }
+}
+
+static void sift_down(topk_t* topk, size_t i) {
+  for (;;) {
+    size_t least = i;
+    size_t left = 2 * i + 1, right = 2 * i + 2;
+    if (left < topk->len && less_at(topk, left, least))
+      least = left;
+    if (right < topk->len && less_at(topk, right, least))
+      least = right;
+    if (least == i)
+      return;
+    swap(topk, i, least);
+    i = least;
+  }
+}
+
+bool topk_init(topk_t* topk, size_t k, topk_less_fn less, void* aux) {
+  topk->heap = malloc((k > 0 ? k : 1) * sizeof(void*));
+  topk->len = 0;
+  topk->k = k;
+  topk->less = less;
+  topk->aux = aux;
+  return topk->heap != NULL;
+}
+
+const void* topk_offer(topk_t* topk, const void* item) {
+  if (topk->len < topk->k) {
+    topk->heap[topk->len++] = item;
+    sift_up(topk, topk->len - 1);
+    return NULL;
+  }
+  if (topk->k > 0 && topk->less(topk->heap[0], item, topk->aux)) {
+    /* Most items lose to the root, so this is the only comparison they cost */
+    const void* dropped = topk->heap[0];
+    topk->heap[0] = item;
+    sift_down(topk, 0);
+    return dropped;
+  }
+  return item;
+}
+
+size_t topk_finish(topk_t* topk, const void** out) {
+  size_t n = topk->len;
+  for (size_t i = 0; i < n; i++) {
+    out[i] = topk->heap[0];
+    topk->heap[0] = topk->heap[--topk->len];
+    sift_down(topk, 0);
+  }
+  return n;
+}
+
+void topk_destroy(topk_t* topk) {
+  free(topk->heap);
+  topk->heap = NULL;
+  topk->len = topk->k = 0;
+}
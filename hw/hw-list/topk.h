@@ -0,0 +1,43 @@
+/*
+ * The topk interface keeps the k greatest of a stream of items in a bounded
+ * min-heap, so selecting them costs O(n log k) time and O(k) space instead of
+ * sorting all n.
+ */
+
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Returns true if a orders before b; aux is passed through from topk_init(). */
+typedef bool (*topk_less_fn)(const void* a, const void* b, void* aux);
+
+typedef struct topk {
+  const void** heap; /* Min-heap: heap[0] is the least item kept */
+  size_t len;
+  size_t k;
+  topk_less_fn less;
+  void* aux;
+} topk_t;
+
+/* Initialize an empty selection of at most k items. Returns false if out of memory. */
+bool topk_init(topk_t* topk, size_t k, topk_less_fn less, void* aux);
+
+/*
+ * Offer item, keeping it if fewer than k items are kept or it beats the least
+ * of them. Returns the item that is no longer kept: item itself, the least
+ * item it displaced, or NULL if nothing was dropped.
+ */
+const void* topk_offer(topk_t* topk, const void* item);
+
+/*
+ * Store the kept items in out, least first, and empty the selection.
+ * Returns how many were stored.
+ */
+size_t topk_finish(topk_t* topk, const void** out);
+
+/* Release the heap. */
+void topk_destroy(topk_t* topk);
+
+#endif /* TOPK_H */
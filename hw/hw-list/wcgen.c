@@ -0,0 +1,162 @@
+/*
+ * Writes a synthetic corpus for the word count benchmarks.
+ *
+ * Words are drawn from a vocabulary of the given size with Zipf-distributed
+ * frequencies: the word of rank r turns up in proportion to 1 / r^exponent,
+ * so 1.0 is roughly English and larger exponents are more skewed. Lines of
+ * about a dozen words start with a capital and end with a full stop, so
+ * counting exercises lowercasing and punctuation too.
+ *
+ * The stream depends only on the size, vocabulary, exponent and seed. It is
+ * cut at line boundaries into files PREFIX.0 ... PREFIX.(files-1) of about
+ * equal size, so splitting the same corpus into more files changes nothing
+ * but where the cuts fall. Prints the number of words written.
+ *
+ * usage: wcgen [-s megabytes] [-v vocabulary] [-z exponent] [-f files] [-r seed] prefix
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define WORDS_PER_LINE 12
+
+typedef struct gen_opts {
+  size_t bytes;
+  size_t vocabulary;
+  double exponent;
+  int files;
+  unsigned seed;
+} gen_opts_t;
+
+/* Word i is i + 26 in base 26 written with letters, so every word has two or more. */
+static size_t spell(size_t i, char* out) {
+  char digits[16];
+  size_t len = 0;
+  for (size_t n = i + 26; n > 0; n /= 26)
+    digits[len++] = 'a' + n % 26;
+  for (size_t j = 0; j < len; j++)
+    out[j] = digits[len - 1 - j];
+  return len;
+}
+
+/* xorshift64*: rand() is too coarse to reach deep into a large vocabulary. */
+static uint64_t next_random(uint64_t* state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 2685821657736338717ULL;
+}
+
+static double* make_cdf(size_t vocabulary, double exponent) {
+  double* cdf = malloc(vocabulary * sizeof(double));
+  if (cdf == NULL)
+    return NULL;
+  double sum = 0;
+  for (size_t i = 0; i < vocabulary; i++) {
+    sum += 1 / pow(i + 1, exponent);
+    cdf[i] = sum;
+  }
+  return cdf;
+}
+
+static size_t draw(double* cdf, size_t vocabulary, uint64_t* state) {
+  double u = (next_random(state) >> 11) * (1.0 / 9007199254740992.0) * cdf[vocabulary - 1];
+  size_t lo = 0, hi = vocabulary - 1;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (cdf[mid] < u)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static int generate(gen_opts_t* opts, const char* prefix) {
+  double* cdf = make_cdf(opts->vocabulary, opts->exponent);
+  char* path = malloc(strlen(prefix) + 16);
+  if (cdf == NULL || path == NULL) {
+    perror("malloc");
+    return 1;
+  }
+
+  uint64_t state = opts->seed * 0x9e3779b97f4a7c15ULL + 1;
+  size_t written = 0, words = 0;
+  char line[WORDS_PER_LINE * 16 + 2];
+  for (int f = 0; f < opts->files; f++) {
+    sprintf(path, "%s.%d", prefix, f);
+    FILE* outfile = fopen(path, "w");
+    if (outfile == NULL) {
+      perror(path);
+      return 1;
+    }
+    size_t limit = opts->bytes / opts->files * (f + 1);
+    if (f == opts->files - 1)
+      limit = opts->bytes;
+    while (written < limit) {
+      size_t len = 0;
+      for (int w = 0; w < WORDS_PER_LINE; w++) {
+        size_t start = len;
+        len += spell(draw(cdf, opts->vocabulary, &state), line + len);
+        if (w == 0)
+          line[start] += 'A' - 'a';
+        line[len++] = w == WORDS_PER_LINE - 1 ? '.' : ' ';
+      }
+      line[len++] = '\n';
+      fwrite(line, 1, len, outfile);
+      written += len;
+      words += WORDS_PER_LINE;
+    }
+    if (fclose(outfile) != 0) {
+      perror(path);
+      return 1;
+    }
+  }
+  printf("%zu\n", words);
+  free(cdf);
+  free(path);
+  return 0;
+}
+
+static void usage(const char* prog) {
+  fprintf(stderr,
+          "usage: %s [-s megabytes] [-v vocabulary] [-z exponent] [-f files] [-r seed] prefix\n",
+          prog);
+}
+
+int main(int argc, char* argv[]) {
+  gen_opts_t opts = {.bytes = 64 << 20, .vocabulary = 100000, .exponent = 1.0, .files = 1,
+                     .seed = 162};
+  int opt;
+  while ((opt = getopt(argc, argv, "s:v:z:f:r:h")) != -1) {
+    switch (opt) {
+      case 's':
+        opts.bytes = (size_t)(atof(optarg) * (1 << 20));
+        break;
+      case 'v':
+        opts.vocabulary = strtoul(optarg, NULL, 10);
+        break;
+      case 'z':
+        opts.exponent = atof(optarg);
+        break;
+      case 'f':
+        opts.files = atoi(optarg);
+        break;
+      case 'r':
+        opts.seed = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1 || opts.vocabulary == 0 || opts.files < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+  return generate(&opts, argv[optind]);
+}
@@ -0,0 +1,122 @@
+/*
+ * Runs one word count command for bench.sh and reports what it cost:
+ *
+ *   ./wcrun [-o output] -- command [args...]
+ *
+ * The command runs with lockstat.so preloaded and its stdout sent to output
+ * (or discarded). One CSV fragment is printed:
+ *
+ *   wall_s,peak_rss_kb,lock_calls,lock_contended,lock_wait_s,status
+ *
+ * where the lock columns come from lockstat.so and status is the command's
+ * exit status. Environment variables such as PWORDS_THREADS pass through.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct lock_stats {
+  unsigned long long calls;
+  unsigned long long contended;
+  unsigned long long wait_ns;
+} lock_stats_t;
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void redirect(const char* path, int fd, int flags) {
+  int new_fd = open(path, flags, 0644);
+  if (new_fd < 0) {
+    perror(path);
+    exit(127);
+  }
+  dup2(new_fd, fd);
+  close(new_fd);
+}
+
+/* Reads what lockstat.so left behind; all zeros if the command never exited cleanly. */
+static lock_stats_t read_stats(const char* path) {
+  lock_stats_t stats = {0, 0, 0};
+  FILE* file = fopen(path, "r");
+  if (file == NULL)
+    return stats;
+  if (fscanf(file, "%llu %llu %llu", &stats.calls, &stats.contended, &stats.wait_ns) != 3)
+    stats = (lock_stats_t){0, 0, 0};
+  fclose(file);
+  return stats;
+}
+
+int main(int argc, char* argv[]) {
+  const char* output = "/dev/null";
+  int opt;
+  while ((opt = getopt(argc, argv, "+o:h")) != -1) {
+    switch (opt) {
+      case 'o':
+        output = optarg;
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-o output] -- command [args...]\n", argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc) {
+    fprintf(stderr, "usage: %s [-o output] -- command [args...]\n", argv[0]);
+    return 1;
+  }
+
+  /* Resolved to an absolute path so the command may change directory. */
+  char preload[PATH_MAX];
+  if (realpath("lockstat.so", preload) == NULL) {
+    perror("lockstat.so");
+    return 1;
+  }
+  char stats_path[] = "/tmp/lockstat.XXXXXX";
+  int stats_fd = mkstemp(stats_path);
+  if (stats_fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(stats_fd);
+
+  double start = now_s();
+  pid_t pid = fork();
+  if (pid == 0) {
+    redirect(output, STDOUT_FILENO, O_WRONLY | O_CREAT | O_TRUNC);
+    setenv("LD_PRELOAD", preload, 1);
+    setenv("LOCKSTAT_FILE", stats_path, 1);
+    execvp(argv[optind], argv + optind);
+    perror(argv[optind]);
+    exit(127);
+  } else if (pid < 0) {
+    perror("fork");
+    unlink(stats_path);
+    return 1;
+  }
+
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0) {
+    perror("wait4");
+    unlink(stats_path);
+    return 1;
+  }
+  double wall_s = now_s() - start;
+  lock_stats_t stats = read_stats(stats_path);
+  unlink(stats_path);
+
+  int exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+  printf("%.3f,%ld,%llu,%llu,%.3f,%d\n", wall_s, usage.ru_maxrss, stats.calls, stats.contended,
+         stats.wait_ns / 1e9, exit_status);
+  return exit_status != 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * Tool for binary word count snapshots, as written by hwords and pwords with
+ * --snapshot=PATH:
+ *
+ *   wcsnap dump SNAPSHOT             print every count as fprint_words() does,
+ *                                    in alphabetical order
+ *   wcsnap lookup SNAPSHOT WORD...   print the count of each word (0 if absent)
+ *   wcsnap merge OUT SNAPSHOT...     write the sum of the snapshots to OUT, in
+ *                                    one streaming pass
+ *   wcsnap verify SNAPSHOT...        check every checksum and print sizes
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "snapshot.h"
+
+static void usage(const char* prog) {
+  fprintf(stderr,
+          "usage: %s dump SNAPSHOT\n"
+          "       %s lookup SNAPSHOT WORD...\n"
+          "       %s merge OUT SNAPSHOT...\n"
+          "       %s verify SNAPSHOT...\n",
+          prog, prog, prog, prog);
+}
+
+static bool open_snapshot(snapshot_t* snapshot, const char* path) {
+  if (!snapshot_open(snapshot, path)) {
+    fprintf(stderr, "%s: not a word count snapshot\n", path);
+    return false;
+  }
+  return true;
+}
+
+static int dump(const char* path) {
+  snapshot_t snapshot;
+  snapshot_iter_t iter;
+  if (!open_snapshot(&snapshot, path))
+    return 1;
+  if (!snapshot_iter_init(&iter, &snapshot)) {
+    snapshot_close(&snapshot);
+    return 1;
+  }
+  uint64_t entries = 0;
+  while (snapshot_next(&iter)) {
+    printf("%" PRIu64 "\t%s\n", iter.count, iter.word);
+    entries++;
+  }
+  snapshot_iter_free(&iter);
+  snapshot_close(&snapshot);
+  if (entries != snapshot.n_entries) {
+    fprintf(stderr, "%s: corrupt after %" PRIu64 " entries\n", path, entries);
+    return 1;
+  }
+  return 0;
+}
+
+static int lookup(const char* path, char** words, int n_words) {
+  snapshot_t snapshot;
+  if (!open_snapshot(&snapshot, path))
+    return 1;
+  for (int i = 0; i < n_words; i++) {
+    uint64_t count = 0;
+    snapshot_find(&snapshot, words[i], strlen(words[i]), &count);
+    printf("%" PRIu64 "\t%s\n", count, words[i]);
+  }
+  snapshot_close(&snapshot);
+  return 0;
+}
+
+static int merge(const char* out_path, char** paths, int n_paths) {
+  snapshot_t* inputs = calloc(n_paths, sizeof(snapshot_t));
+  if (inputs == NULL)
+    return 1;
+  int opened = 0;
+  while (opened < n_paths && open_snapshot(&inputs[opened], paths[opened]))
+    opened++;
+  int status = opened < n_paths;
+
+  FILE* outfile = status == 0 ? fopen(out_path, "w") : NULL;
+  if (status == 0 && outfile == NULL) {
+    perror(out_path);
+    status = 1;
+  }
+  if (status == 0) {
+    snapshot_writer_t writer;
+    bool ok = snapshot_writer_init(&writer, outfile);
+    if (ok) {
+      ok = snapshot_merge(inputs, n_paths, &writer);
+      ok = snapshot_writer_finish(&writer) && ok;
+    }
+    if (fclose(outfile) != 0 || !ok) {
+      fprintf(stderr, "%s: merge failed\n", out_path);
+      remove(out_path);
+      status = 1;
+    }
+  }
+
+  for (int i = 0; i < opened; i++)
+    snapshot_close(&inputs[i]);
+  free(inputs);
+  return status;
+}
+
+static int verify(char** paths, int n_paths) {
+  int status = 0;
+  for (int i = 0; i < n_paths; i++) {
+    snapshot_t snapshot;
+    if (!open_snapshot(&snapshot, paths[i])) {
+      status = 1;
+      continue;
+    }
+    if (snapshot_verify(&snapshot)) {
+      printf("%s: ok, %" PRIu64 " words (%" PRIu64 " total) in %zu bytes, %.1f bytes/word\n",
+             paths[i], snapshot.n_entries, snapshot.total, snapshot.size,
+             snapshot.n_entries > 0 ? (double)snapshot.size / snapshot.n_entries : 0.0);
+    } else {
+      printf("%s: checksum mismatch\n", paths[i]);
+      status = 1;
+    }
+    snapshot_close(&snapshot);
+  }
+  return status;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc >= 3 && strcmp(argv[1], "dump") == 0 && argc == 3)
+    return dump(argv[2]);
+  if (argc >= 4 && strcmp(argv[1], "lookup") == 0)
+    return lookup(argv[2], argv + 3, argc - 3);
+  if (argc >= 4 && strcmp(argv[1], "merge") == 0)
+    return merge(argv[2], argv + 3, argc - 3);
+  if (argc >= 3 && strcmp(argv[1], "verify") == 0)
+    return verify(argv + 2, argc - 2);
+  usage(argv[0]);
+  return 1;
+}
@@ -0,0 +1,143 @@
+/*
+ * Implementation of the word_chunks interface on top of the hash table
+ * word_count backend.
+ *
+ * The file is mapped once and cut into n_threads ranges of about equal size.
+ * Each cut is moved forward past any letters, so no word straddles two ranges
+ * and every thread sees exactly the words a single pass would. Threads count
+ * into private tables, which are merged once they are done.
+ */
+
+#ifndef HASH_TABLE
+#error "HASH_TABLE must be #define'd when compiling word_chunks.c"
+#endif
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "word_chunks.h"
+#include "word_helpers.h"
+
+typedef struct chunk {
+  const char* start;
+  const char* end;
+  word_count_list_t counts;
+  bool threaded; /* Whether a thread was started for this chunk */
+} chunk_t;
+
+/* Same test as isalpha() in the C locale, which is what count_words() uses. */
+static bool is_letter(unsigned char c) { return (unsigned char)((c | 0x20) - 'a') < 26; }
+
+static void* count_chunk(void* arg) {
+  chunk_t* chunk = arg;
+  size_t buf_size = 64;
+  char* buf = malloc(buf_size);
+  if (buf == NULL)
+    return NULL;
+
+  const char* p = chunk->start;
+  while (p < chunk->end) {
+    while (p < chunk->end && !is_letter(*p))
+      p++;
+    const char* word = p;
+    while (p < chunk->end && is_letter(*p))
+      p++;
+    size_t len = p - word;
+    if (len < 2)
+      continue;
+
+    if (len > buf_size) {
+      while (len > buf_size)
+        buf_size *= 2;
+      char* bigger = realloc(buf, buf_size);
+      if (bigger == NULL)
+        break;
+      buf = bigger;
+    }
+    for (size_t i = 0; i < len; i++)
+      buf[i] = word[i] | 0x20; /* Lowercase; only letters get here */
+    if (add_word_span(&chunk->counts, buf, len) == NULL)
+      break;
+  }
+  free(buf);
+  return NULL;
+}
+
+/* Falls back to one sequential pass for files that cannot be mapped. */
+static int count_words_stream(word_count_list_t* wclist, const char* path) {
+  FILE* infile = fopen(path, "r");
+  if (infile == NULL)
+    return -1;
+  count_words(wclist, infile);
+  fclose(infile);
+  return 0;
+}
+
+int count_words_chunked(word_count_list_t* wclist, const char* path, int n_threads) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return count_words_stream(wclist, path);
+  }
+  size_t size = st.st_size;
+  if (size == 0) {
+    close(fd);
+    return 0;
+  }
+  const char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return count_words_stream(wclist, path);
+  madvise((void*)data, size, MADV_SEQUENTIAL);
+
+  if (n_threads < 1)
+    n_threads = 1;
+  if ((size_t)n_threads > size)
+    n_threads = size;
+  chunk_t* chunks = malloc(n_threads * sizeof(chunk_t));
+  pthread_t* threads = malloc(n_threads * sizeof(pthread_t));
+  if (chunks == NULL || threads == NULL) {
+    free(chunks);
+    free(threads);
+    munmap((void*)data, size);
+    return count_words_stream(wclist, path);
+  }
+
+  const char* end = data + size;
+  const char* start = data;
+  for (int i = 0; i < n_threads; i++) {
+    const char* cut = i == n_threads - 1 ? end : data + size / n_threads * (i + 1);
+    if (cut < start)
+      cut = start;
+    while (cut < end && cut > data && is_letter(cut[-1]) && is_letter(*cut))
+      cut++;
+    chunks[i].start = start;
+    chunks[i].end = cut;
+    init_words(&chunks[i].counts);
+    start = cut;
+  }
+
+  /* Run the first chunk on this thread rather than leaving it idle. */
+  for (int i = 1; i < n_threads; i++) {
+    chunks[i].threaded = pthread_create(&threads[i], NULL, count_chunk, &chunks[i]) == 0;
+    if (!chunks[i].threaded)
+      count_chunk(&chunks[i]);
+  }
+  count_chunk(&chunks[0]);
+  for (int i = 0; i < n_threads; i++) {
+    if (i > 0 && chunks[i].threaded)
+      pthread_join(threads[i], NULL);
+    merge_words(wclist, &chunks[i].counts);
+  }
+
+  free(chunks);
+  free(threads);
+  munmap((void*)data, size);
+  return 0;
+}
@@ -0,0 +1,20 @@
+/*
+ * The word_chunks interface counts the words of one file on several threads,
+ * by splitting the file into ranges that each thread tokenizes on its own.
+ */
+
+#ifndef WORD_CHUNKS_H
+#define WORD_CHUNKS_H
+
+#include "word_count.h"
+
+/*
+ * Adds the words in the file at path to wclist, splitting the work across
+ * n_threads threads. Words are the same as count_words() finds: runs of
+ * letters, lowercased, at least two long. Files that cannot be mapped (pipes,
+ * for instance) are read with count_words() instead. Returns 0 on success and
+ * -1 if the file cannot be opened.
+ */
+int count_words_chunked(word_count_list_t* wclist, const char* path, int n_threads);
+
+#endif /* WORD_CHUNKS_H */
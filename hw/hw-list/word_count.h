@@ -33,11 +33,91 @@
 
 /*
  * Representation of a word count object and word count list object.
- * PINTOS_LIST and/or PTHREADS are #define'd prior to #include to select the
- * representations.
+ * PINTOS_LIST or HASH_TABLE, and/or PTHREADS, are #define'd prior to #include
+ * to select the representations. STRIPED with HASH_TABLE and PTHREADS selects
+ * a table that many threads can add to at once.
  */
 
-#ifdef PINTOS_LIST
+#if defined(HASH_TABLE) && defined(STRIPED)
+#include <pthread.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+#define WORD_STRIPE_BITS 6
+#define WORD_STRIPES (1 << WORD_STRIPE_BITS)
+
+typedef struct word_count {
+  char* word;
+  int count; /* Incremented atomically */
+} word_count_t;
+
+typedef struct word_slot {
+  uint32_t hash;
+  word_count_t* wc; /* Published atomically, after hash; NULL if the slot is empty */
+} word_slot_t;
+
+/* One generation of a stripe's slots. Old generations stay readable until freed. */
+typedef struct word_slots {
+  size_t capacity; /* A power of two */
+  struct word_slots* retired;
+  word_slot_t slot[];
+} word_slots_t;
+
+/*
+ * The top bits of a word's hash pick its stripe. Each stripe is a table of
+ * its own: lookups probe it without locking, and only inserting a new word
+ * takes the stripe's lock. Stripes sit on separate cache lines.
+ */
+typedef struct word_stripe {
+  pthread_mutex_t lock;
+  word_slots_t* slots;
+  size_t used;
+  word_count_t** words; /* This stripe's entries */
+  size_t len;
+  size_t words_capacity;
+  arena_t arena;
+} __attribute__((aligned(64))) word_stripe_t;
+
+typedef struct word_count_list {
+  word_stripe_t stripes[WORD_STRIPES];
+  word_count_t** words; /* Every entry, gathered by wordcount_sort() */
+  size_t len;
+} word_count_list_t;
+
+#elif defined(HASH_TABLE)
+#include <stdint.h>
+
+#include "arena.h"
+#ifdef PTHREADS
+#include <pthread.h>
+#endif /* PTHREADS */
+
+typedef struct word_count {
+  char* word;
+  int count;
+} word_count_t;
+
+/* Open-addressing slot; the word's hash and length are cached to skip most memcmp()s. */
+typedef struct word_slot {
+  uint32_t hash;
+  size_t len;          /* strlen(wc->word) */
+  word_count_t* wc;    /* NULL if the slot is empty */
+} word_slot_t;
+
+typedef struct word_count_list {
+  word_slot_t* slots;
+  size_t capacity;      /* Number of slots, a power of two */
+  word_count_t** words; /* Every entry, in insertion order until sorted */
+  size_t len;
+  size_t words_capacity;
+  arena_t arena;        /* Holds every entry and its word */
+#ifdef PTHREADS
+  pthread_mutex_t lock;
+#endif /* PTHREADS */
+} word_count_list_t;
+
+#elif defined(PINTOS_LIST)
 #include "list.h"
 typedef struct word_count {
   char* word;
@@ -47,9 +127,12 @@ typedef struct word_count {
 
 #ifdef PTHREADS
 #include <pthread.h>
+
+#include "arena.h"
 typedef struct word_count_list {
   struct list lst;
   pthread_mutex_t lock;
+  arena_t arena; /* Holds every entry and its word */
 } word_count_list_t;
 #else  /* PTHREADS */
 typedef struct list word_count_list_t;
@@ -77,7 +160,8 @@ word_count_t* find_word(word_count_list_t* wclist, char* word);
 
 /*
  * Insert word with count=1, if not already present; increment count if
- * present. Takes ownership of word.
+ * present. Takes ownership of word if it succeeds; if it returns NULL, the
+ * caller still owns word and must free it.
  */
 word_count_t* add_word(word_count_list_t* wclist, char* word);
 
@@ -87,4 +171,45 @@ void fprint_words(word_count_list_t* wclist, FILE* outfile);
 /* Sort a word count list using the provided comparator function. */
 void wordcount_sort(word_count_list_t* wclist, bool less(const word_count_t*, const word_count_t*));
 
+#if defined(HASH_TABLE) || defined(PTHREADS)
+/*
+ * Release a word count list and every entry in it at once. The representations
+ * that allocate entries from an arena provide this.
+ */
+void free_words(word_count_list_t* wclist);
+
+/*
+ * Store in top the k entries of wclist that come last under less, in the
+ * order wordcount_sort() would leave them: the tail of the sorted list. Takes
+ * O(n log k) time and O(k) extra space, and leaves wclist as it was. Returns
+ * how many entries were stored, fewer than k if wclist is shorter.
+ */
+size_t top_words(word_count_list_t* wclist, size_t k,
+                 bool less(const word_count_t*, const word_count_t*), word_count_t** top);
+
+/*
+ * Sort wclist alphabetically and write it to outfile as a binary snapshot
+ * (see snapshot.h). Returns false if the snapshot could not be written.
+ */
+bool fsnapshot_words(word_count_list_t* wclist, FILE* outfile);
+#endif
+
+#ifdef HASH_TABLE
+/*
+ * Like add_word(), but counts the len bytes at word, which need not be
+ * NUL-terminated and stay owned by the caller. They are copied only if new.
+ */
+word_count_t* add_word_span(word_count_list_t* wclist, const char* word, size_t len);
+
+/*
+ * Add every count in other to wclist, then empty other. Entries new to wclist
+ * are moved rather than copied. Returns false if memory ran out, in which case
+ * some of other's counts were dropped.
+ */
+bool merge_words(word_count_list_t* wclist, word_count_list_t* other);
+
+/* Bytes of heap wclist holds: its slots, its entry array and its arena. */
+size_t words_bytes(word_count_list_t* wclist);
+#endif /* HASH_TABLE */
+
 #endif /* WORD_COUNT_H */
@@ -0,0 +1,267 @@
+/*
+ * Implementation of the word_count interface using an open-addressing hash
+ * table, optionally guarded by a single pthreads mutex.
+ *
+ * Lookups hash the word once and compare cached hashes and lengths before
+ * any bytes, so add_word() costs O(1) expected time rather than a walk over
+ * every word.
+ * Entries are also kept in an array, which is what gets sorted and printed.
+ * Entries and their words are allocated from an arena owned by the table.
+ */
+
+#define _GNU_SOURCE
+
+#ifndef HASH_TABLE
+#error "HASH_TABLE must be #define'd when compiling word_count_h.c"
+#endif
+
+#include "snapshot.h"
+#include "topk.h"
+#include "word_count.h"
+
+#define INITIAL_CAPACITY 1024
+
+#ifdef PTHREADS
+#define LOCK(wclist) pthread_mutex_lock(&(wclist)->lock)
+#define UNLOCK(wclist) pthread_mutex_unlock(&(wclist)->lock)
+#else
+#define LOCK(wclist)
+#define UNLOCK(wclist)
+#endif
+
+/* 32-bit FNV-1a. */
+static uint32_t hash_word(const char* word, size_t len) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (unsigned char)word[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/* Returns the slot holding the len bytes at word, or the empty slot where they belong. */
+static word_slot_t* lookup(word_count_list_t* wclist, const char* word, size_t len, uint32_t hash) {
+  size_t mask = wclist->capacity - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    word_slot_t* slot = &wclist->slots[i];
+    if (slot->wc == NULL)
+      return slot;
+    /* Equal lengths first, so memcmp() never reads past the end of a shorter word. */
+    if (slot->hash == hash && slot->len == len && memcmp(slot->wc->word, word, len) == 0)
+      return slot;
+  }
+}
+
+/* Doubles the slot array; cached hashes mean no word is rehashed. */
+static bool grow_slots(word_count_list_t* wclist) {
+  size_t capacity = wclist->capacity * 2;
+  word_slot_t* slots = calloc(capacity, sizeof(word_slot_t));
+  if (slots == NULL)
+    return false;
+  for (size_t i = 0; i < wclist->capacity; i++) {
+    word_slot_t* old = &wclist->slots[i];
+    if (old->wc == NULL)
+      continue;
+    size_t j = old->hash & (capacity - 1);
+    while (slots[j].wc != NULL)
+      j = (j + 1) & (capacity - 1);
+    slots[j] = *old;
+  }
+  free(wclist->slots);
+  wclist->slots = slots;
+  wclist->capacity = capacity;
+  return true;
+}
+
+void init_words(word_count_list_t* wclist) {
+  wclist->capacity = INITIAL_CAPACITY;
+  wclist->slots = calloc(wclist->capacity, sizeof(word_slot_t));
+  wclist->words_capacity = INITIAL_CAPACITY;
+  wclist->words = malloc(wclist->words_capacity * sizeof(word_count_t*));
+  wclist->len = 0;
+  arena_init(&wclist->arena);
+#ifdef PTHREADS
+  pthread_mutex_init(&wclist->lock, NULL);
+#endif
+}
+
+void free_words(word_count_list_t* wclist) {
+  LOCK(wclist);
+  arena_free(&wclist->arena);
+  free(wclist->slots);
+  free(wclist->words);
+  wclist->slots = NULL;
+  wclist->words = NULL;
+  wclist->capacity = wclist->len = wclist->words_capacity = 0;
+  UNLOCK(wclist);
+}
+
+size_t words_bytes(word_count_list_t* wclist) {
+  LOCK(wclist);
+  size_t bytes = wclist->capacity * sizeof(word_slot_t) +
+                 wclist->words_capacity * sizeof(word_count_t*) + wclist->arena.reserved;
+  UNLOCK(wclist);
+  return bytes;
+}
+
+size_t len_words(word_count_list_t* wclist) {
+  LOCK(wclist);
+  size_t len = wclist->len;
+  UNLOCK(wclist);
+  return len;
+}
+
+word_count_t* find_word(word_count_list_t* wclist, char* word) {
+  size_t len = strlen(word);
+  uint32_t hash = hash_word(word, len);
+  LOCK(wclist);
+  word_count_t* wc = lookup(wclist, word, len, hash)->wc;
+  UNLOCK(wclist);
+  return wc;
+}
+
+/*
+ * Makes room for one more entry and returns the empty slot for word, or NULL
+ * if memory ran out. Must be called with the lock held.
+ */
+static word_slot_t* reserve_slot(word_count_list_t* wclist, const char* word, size_t len,
+                                 uint32_t hash) {
+  /* Keep the load factor at or below 3/4 so probe sequences stay short. */
+  if ((wclist->len + 1) * 4 > wclist->capacity * 3 && !grow_slots(wclist))
+    return NULL;
+  if (wclist->len == wclist->words_capacity) {
+    word_count_t** words = realloc(wclist->words, 2 * wclist->words_capacity * sizeof(word_count_t*));
+    if (words == NULL)
+      return NULL;
+    wclist->words = words;
+    wclist->words_capacity *= 2;
+  }
+  return lookup(wclist, word, len, hash);
+}
+
+word_count_t* add_word(word_count_list_t* wclist, char* word) {
+  /*
+   * add_word() owns word once it succeeds; the table keeps its own copy of
+   * new words. On failure count_words() frees word itself.
+   */
+  word_count_t* wc = add_word_span(wclist, word, strlen(word));
+  if (wc != NULL)
+    free(word);
+  return wc;
+}
+
+word_count_t* add_word_span(word_count_list_t* wclist, const char* word, size_t len) {
+  uint32_t hash = hash_word(word, len);
+  LOCK(wclist);
+  word_slot_t* slot = lookup(wclist, word, len, hash);
+  if (slot->wc != NULL) {
+    slot->wc->count++;
+    word_count_t* existing = slot->wc;
+    UNLOCK(wclist);
+    return existing;
+  }
+
+  /* The entry and a copy of its word share one allocation. */
+  word_count_t* new_wc = NULL;
+  if ((slot = reserve_slot(wclist, word, len, hash)) != NULL)
+    new_wc = arena_alloc(&wclist->arena, sizeof(word_count_t) + len + 1, _Alignof(word_count_t));
+  if (new_wc == NULL) {
+    UNLOCK(wclist);
+    return NULL;
+  }
+  new_wc->word = (char*)(new_wc + 1);
+  memcpy(new_wc->word, word, len);
+  new_wc->word[len] = '\0';
+  new_wc->count = 1;
+
+  slot->hash = hash;
+  slot->len = len;
+  slot->wc = new_wc;
+  wclist->words[wclist->len++] = new_wc;
+  UNLOCK(wclist);
+  return new_wc;
+}
+
+bool merge_words(word_count_list_t* wclist, word_count_list_t* other) {
+  bool ok = true;
+  LOCK(wclist);
+  for (size_t i = 0; i < other->capacity; i++) {
+    word_slot_t* from = &other->slots[i];
+    if (from->wc == NULL)
+      continue;
+    size_t len = from->len;
+    word_slot_t* slot = lookup(wclist, from->wc->word, len, from->hash);
+    if (slot->wc != NULL) {
+      slot->wc->count += from->wc->count;
+    } else if ((slot = reserve_slot(wclist, from->wc->word, len, from->hash)) != NULL) {
+      /* Entries move across without copying; their arena comes along below. */
+      *slot = *from;
+      wclist->words[wclist->len++] = from->wc;
+    } else {
+      ok = false;
+    }
+  }
+  arena_absorb(&wclist->arena, &other->arena);
+  UNLOCK(wclist);
+
+  free_words(other);
+  return ok;
+}
+
+void fprint_words(word_count_list_t* wclist, FILE* outfile) {
+  for (size_t i = 0; i < wclist->len; i++)
+    fprintf(outfile, "%i\t%s\n", wclist->words[i]->count, wclist->words[i]->word);
+}
+
+static int compare_words(const void* a, const void* b, void* aux) {
+  bool (*less)(const word_count_t*, const word_count_t*) = aux;
+  const word_count_t* wc1 = *(word_count_t* const*)a;
+  const word_count_t* wc2 = *(word_count_t* const*)b;
+  if (less(wc1, wc2))
+    return -1;
+  return less(wc2, wc1) ? 1 : 0;
+}
+
+void wordcount_sort(word_count_list_t* wclist,
+                    bool less(const word_count_t*, const word_count_t*)) {
+  /* Slots point at the entries themselves, so reordering the array is safe. */
+  LOCK(wclist);
+  qsort_r(wclist->words, wclist->len, sizeof(word_count_t*), compare_words, less);
+  UNLOCK(wclist);
+}
+
+static bool less_entry(const void* a, const void* b, void* aux) {
+  bool (*less)(const word_count_t*, const word_count_t*) = aux;
+  return less(a, b);
+}
+
+size_t top_words(word_count_list_t* wclist, size_t k,
+                 bool less(const word_count_t*, const word_count_t*), word_count_t** top) {
+  topk_t topk;
+  if (!topk_init(&topk, k, less_entry, less))
+    return 0;
+  LOCK(wclist);
+  for (size_t i = 0; i < wclist->len; i++)
+    topk_offer(&topk, wclist->words[i]);
+  UNLOCK(wclist);
+  size_t n = topk_finish(&topk, (const void**)top);
+  topk_destroy(&topk);
+  return n;
+}
+
+static bool less_alpha(const word_count_t* wc1, const word_count_t* wc2) {
+  return strcmp(wc1->word, wc2->word) < 0;
+}
+
+bool fsnapshot_words(word_count_list_t* wclist, FILE* outfile) {
+  snapshot_writer_t writer;
+  if (!snapshot_writer_init(&writer, outfile))
+    return false;
+  wordcount_sort(wclist, less_alpha);
+  LOCK(wclist);
+  for (size_t i = 0; i < wclist->len; i++)
+    snapshot_write(&writer, wclist->words[i]->word, strlen(wclist->words[i]->word),
+                   wclist->words[i]->count);
+  UNLOCK(wclist);
+  return snapshot_writer_finish(&writer);
+}
@@ -28,12 +28,23 @@
  #error "PTHREADS must be #define'd when compiling word_count_lp.c"
  #endif
  
+ #include "snapshot.h"
+ #include "topk.h"
  #include "word_count.h"
  
  void init_words(word_count_list_t* wclist) { 
    /* TODO */
    list_init(&wclist->lst);
    pthread_mutex_init(&wclist->lock, NULL);
+   arena_init(&wclist->arena);
+ }
+ 
+ void free_words(word_count_list_t* wclist) {
+   // Every entry and word lives in the arena, so there is nothing to walk
+   pthread_mutex_lock(&wclist->lock);
+   arena_free(&wclist->arena);
+   list_init(&wclist->lst);
+   pthread_mutex_unlock(&wclist->lock);
  }
  
  size_t len_words(word_count_list_t* wclist) {
@@ -58,18 +69,6 @@
  word_count_t* add_word(word_count_list_t* wclist, char* word) {
    /* TODO */
  
-   // Allocate memory for the new word count object before the critical section
-   word_count_t* new_wc = (word_count_t*)malloc(sizeof(word_count_t));
-   if (new_wc == NULL) return NULL;  
- 
-   new_wc->word = (char*)malloc(strlen(word) + 1);
-   if (new_wc->word == NULL) {
-     free(new_wc);
-     return NULL;
-   }
-   strcpy(new_wc->word, word);
-   new_wc->count = 1;
-   
    // Enter the critical section
    pthread_mutex_lock(&wclist->lock);
  
@@ -85,15 +84,25 @@
      // Word exists, increment its count
      existing->count++;
      pthread_mutex_unlock(&wclist->lock);
-     // if the word exists
-     // free the memory allocated for the new word count object
-     free(new_wc->word);
-     free(new_wc);
+     // add_word() owns word, and the list does not keep it
+     free(word);
      return existing;
    }
-   // if the word does not exist, add it to the list
+   // if the word does not exist, copy it into the arena and add it to the list.
+   // Arena allocations are cheap, so they can happen inside the critical section.
+   word_count_t* new_wc = arena_alloc(&wclist->arena, sizeof(word_count_t), _Alignof(word_count_t));
+   if (new_wc != NULL) {
+     new_wc->word = arena_strndup(&wclist->arena, word, strlen(word));
+   }
+   if (new_wc == NULL || new_wc->word == NULL) {
+     // On failure the caller keeps word
+     pthread_mutex_unlock(&wclist->lock);
+     return NULL;
+   }
+   new_wc->count = 1;
    list_push_back(&wclist->lst, &new_wc->elem);
    pthread_mutex_unlock(&wclist->lock);
+   free(word);
    return new_wc;
  }
  
@@ -123,3 +132,43 @@
    pthread_mutex_unlock(&wclist->lock);
  }
  
+ 
+ static bool less_entry(const void* a, const void* b, void* aux) {
+   bool(*comp)(const word_count_t*, const word_count_t*) = aux;
+   return comp(a, b);
+ }
+ 
+ size_t top_words(word_count_list_t* wclist, size_t k,
+                  bool less(const word_count_t*, const word_count_t*), word_count_t** top) {
+   topk_t topk;
+   if (!topk_init(&topk, k, less_entry, less)) {
+     return 0;
+   }
+   pthread_mutex_lock(&wclist->lock);
+   for (struct list_elem* e = list_begin(&wclist->lst); e != list_end(&wclist->lst); e = list_next(e)) {
+     topk_offer(&topk, list_entry(e, word_count_t, elem));
+   }
+   pthread_mutex_unlock(&wclist->lock);
+   size_t n = topk_finish(&topk, (const void**)top);
+   topk_destroy(&topk);
+   return n;
+ }
+ 
+ static bool less_alpha(const word_count_t* wc1, const word_count_t* wc2) {
+   return strcmp(wc1->word, wc2->word) < 0;
+ }
+ 
+ bool fsnapshot_words(word_count_list_t* wclist, FILE* outfile) {
+   snapshot_writer_t writer;
+   if (!snapshot_writer_init(&writer, outfile)) {
+     return false;
+   }
+   wordcount_sort(wclist, less_alpha);
+   pthread_mutex_lock(&wclist->lock);
+   for (struct list_elem* e = list_begin(&wclist->lst); e != list_end(&wclist->lst); e = list_next(e)) {
+     word_count_t* wc = list_entry(e, word_count_t, elem);
+     snapshot_write(&writer, wc->word, strlen(wc->word), wc->count);
+   }
+   pthread_mutex_unlock(&wclist->lock);
+   return snapshot_writer_finish(&writer);
+ }
@@ -0,0 +1,318 @@
+/*
+ * Implementation of the word_count interface as a lock-striped concurrent
+ * hash table, for many threads adding to one table.
+ *
+ * A word's hash picks one of WORD_STRIPES stripes, each an open-addressing
+ * table with its own lock, slots, entry array and arena. Adding a word that
+ * is already present takes no lock at all: the stripe's slots are probed
+ * with acquire loads and the count is bumped with an atomic add. Only a new
+ * word takes the stripe's lock, probes again, and publishes its entry with a
+ * release store after filling it in. Growing a stripe builds a new slot
+ * array and publishes it the same way; the old one is kept on a retired list
+ * until free_words(), since a lock-free reader may still be probing it.
+ *
+ * Operations over the whole table (sorting, printing, selecting, merging)
+ * lock each stripe in turn and expect producers to have finished.
+ */
+
+#define _GNU_SOURCE
+
+#if !defined(HASH_TABLE) || !defined(PTHREADS) || !defined(STRIPED)
+#error "HASH_TABLE, PTHREADS and STRIPED must be #define'd when compiling word_count_s.c"
+#endif
+
+#include "snapshot.h"
+#include "topk.h"
+#include "word_count.h"
+
+#define INITIAL_CAPACITY 64
+
+/* 32-bit FNV-1a, as in word_count_h.c. */
+static uint32_t hash_word(const char* word, size_t len) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (unsigned char)word[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static word_stripe_t* stripe_of(word_count_list_t* wclist, uint32_t hash) {
+  return &wclist->stripes[hash >> (32 - WORD_STRIPE_BITS)];
+}
+
+static word_slots_t* new_slots(size_t capacity) {
+  word_slots_t* slots = calloc(1, sizeof(word_slots_t) + capacity * sizeof(word_slot_t));
+  if (slots != NULL)
+    slots->capacity = capacity;
+  return slots;
+}
+
+/* Finds word in slots without locking. Safe against concurrent inserts. */
+static word_count_t* probe(word_slots_t* slots, const char* word, size_t len, uint32_t hash) {
+  size_t mask = slots->capacity - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    word_count_t* wc = __atomic_load_n(&slots->slot[i].wc, __ATOMIC_ACQUIRE);
+    if (wc == NULL)
+      return NULL;
+    if (slots->slot[i].hash == hash && strncmp(wc->word, word, len) == 0 && wc->word[len] == '\0')
+      return wc;
+  }
+}
+
+/* Stores wc in the first free slot for hash. Must hold the stripe's lock. */
+static void publish(word_slots_t* slots, word_count_t* wc, uint32_t hash) {
+  size_t mask = slots->capacity - 1;
+  size_t i = hash & mask;
+  while (slots->slot[i].wc != NULL)
+    i = (i + 1) & mask;
+  slots->slot[i].hash = hash;
+  __atomic_store_n(&slots->slot[i].wc, wc, __ATOMIC_RELEASE);
+}
+
+/* Doubles the stripe's slots. Must hold the stripe's lock. */
+static bool grow_slots(word_stripe_t* stripe) {
+  word_slots_t* old = stripe->slots;
+  word_slots_t* slots = new_slots(old->capacity * 2);
+  if (slots == NULL)
+    return false;
+  for (size_t i = 0; i < old->capacity; i++) {
+    if (old->slot[i].wc != NULL)
+      publish(slots, old->slot[i].wc, old->slot[i].hash);
+  }
+  slots->retired = old;
+  __atomic_store_n(&stripe->slots, slots, __ATOMIC_RELEASE);
+  return true;
+}
+
+/*
+ * Adds count to word in stripe, inserting it if absent. The new entry is
+ * moved, if given, or else copied from the len bytes at word into the
+ * stripe's arena. Must hold the stripe's lock.
+ */
+static word_count_t* add_locked(word_stripe_t* stripe, const char* word, size_t len,
+                                uint32_t hash, int count, word_count_t* moved) {
+  word_count_t* wc = probe(stripe->slots, word, len, hash);
+  if (wc != NULL) {
+    __atomic_fetch_add(&wc->count, count, __ATOMIC_RELAXED);
+    return wc;
+  }
+
+  if ((stripe->used + 1) * 4 > stripe->slots->capacity * 3 && !grow_slots(stripe))
+    return NULL;
+  if (stripe->len == stripe->words_capacity) {
+    size_t capacity = stripe->words_capacity * 2;
+    word_count_t** words = realloc(stripe->words, capacity * sizeof(word_count_t*));
+    if (words == NULL)
+      return NULL;
+    stripe->words = words;
+    stripe->words_capacity = capacity;
+  }
+
+  wc = moved;
+  if (wc == NULL) {
+    wc = arena_alloc(&stripe->arena, sizeof(word_count_t) + len + 1, _Alignof(word_count_t));
+    if (wc == NULL)
+      return NULL;
+    wc->word = (char*)(wc + 1);
+    memcpy(wc->word, word, len);
+    wc->word[len] = '\0';
+    wc->count = count;
+  }
+  stripe->words[stripe->len++] = wc;
+  stripe->used++;
+  publish(stripe->slots, wc, hash);
+  return wc;
+}
+
+void init_words(word_count_list_t* wclist) {
+  for (int s = 0; s < WORD_STRIPES; s++) {
+    word_stripe_t* stripe = &wclist->stripes[s];
+    pthread_mutex_init(&stripe->lock, NULL);
+    stripe->slots = new_slots(INITIAL_CAPACITY);
+    stripe->used = 0;
+    stripe->words_capacity = INITIAL_CAPACITY;
+    stripe->words = malloc(stripe->words_capacity * sizeof(word_count_t*));
+    stripe->len = 0;
+    arena_init(&stripe->arena);
+  }
+  wclist->words = NULL;
+  wclist->len = 0;
+}
+
+void free_words(word_count_list_t* wclist) {
+  for (int s = 0; s < WORD_STRIPES; s++) {
+    word_stripe_t* stripe = &wclist->stripes[s];
+    pthread_mutex_lock(&stripe->lock);
+    for (word_slots_t* slots = stripe->slots; slots != NULL;) {
+      word_slots_t* retired = slots->retired;
+      free(slots);
+      slots = retired;
+    }
+    free(stripe->words);
+    arena_free(&stripe->arena);
+    stripe->slots = NULL;
+    stripe->words = NULL;
+    stripe->used = stripe->len = stripe->words_capacity = 0;
+    pthread_mutex_unlock(&stripe->lock);
+  }
+  free(wclist->words);
+  wclist->words = NULL;
+  wclist->len = 0;
+}
+
+size_t len_words(word_count_list_t* wclist) {
+  size_t len = 0;
+  for (int s = 0; s < WORD_STRIPES; s++) {
+    pthread_mutex_lock(&wclist->stripes[s].lock);
+    len += wclist->stripes[s].len;
+    pthread_mutex_unlock(&wclist->stripes[s].lock);
+  }
+  return len;
+}
+
+size_t words_bytes(word_count_list_t* wclist) {
+  size_t bytes = wclist->len * sizeof(word_count_t*);
+  for (int s = 0; s < WORD_STRIPES; s++) {
+    word_stripe_t* stripe = &wclist->stripes[s];
+    pthread_mutex_lock(&stripe->lock);
+    for (word_slots_t* slots = stripe->slots; slots != NULL; slots = slots->retired)
+      bytes += sizeof(word_slots_t) + slots->capacity * sizeof(word_slot_t);
+    bytes += stripe->words_capacity * sizeof(word_count_t*) + stripe->arena.reserved;
+    pthread_mutex_unlock(&stripe->lock);
+  }
+  return bytes;
+}
+
+word_count_t* find_word(word_count_list_t* wclist, char* word) {
+  size_t len = strlen(word);
+  uint32_t hash = hash_word(word, len);
+  word_stripe_t* stripe = stripe_of(wclist, hash);
+  return probe(__atomic_load_n(&stripe->slots, __ATOMIC_ACQUIRE), word, len, hash);
+}
+
+word_count_t* add_word_span(word_count_list_t* wclist, const char* word, size_t len) {
+  uint32_t hash = hash_word(word, len);
+  word_stripe_t* stripe = stripe_of(wclist, hash);
+
+  /* Most words are already present: count them without the lock */
+  word_count_t* wc = probe(__atomic_load_n(&stripe->slots, __ATOMIC_ACQUIRE), word, len, hash);
+  if (wc != NULL) {
+    __atomic_fetch_add(&wc->count, 1, __ATOMIC_RELAXED);
+    return wc;
+  }
+
+  pthread_mutex_lock(&stripe->lock);
+  wc = add_locked(stripe, word, len, hash, 1, NULL);
+  pthread_mutex_unlock(&stripe->lock);
+  return wc;
+}
+
+word_count_t* add_word(word_count_list_t* wclist, char* word) {
+  word_count_t* wc = add_word_span(wclist, word, strlen(word));
+  /* add_word() owns word, and the table keeps its own copy */
+  if (wc != NULL)
+    free(word);
+  return wc;
+}
+
+bool merge_words(word_count_list_t* wclist, word_count_list_t* other) {
+  bool ok = true;
+  for (int s = 0; s < WORD_STRIPES; s++) {
+    /* A word's hash puts it in the same stripe of both tables */
+    word_stripe_t* stripe = &wclist->stripes[s];
+    word_stripe_t* from = &other->stripes[s];
+    pthread_mutex_lock(&stripe->lock);
+    for (size_t i = 0; i < from->len; i++) {
+      word_count_t* wc = from->words[i];
+      size_t len = strlen(wc->word);
+      if (add_locked(stripe, wc->word, len, hash_word(wc->word, len), wc->count, wc) == NULL)
+        ok = false;
+    }
+    /* Entries that moved live in from's arena, which now belongs to stripe */
+    arena_absorb(&stripe->arena, &from->arena);
+    pthread_mutex_unlock(&stripe->lock);
+  }
+  free_words(other);
+  return ok;
+}
+
+void fprint_words(word_count_list_t* wclist, FILE* outfile) {
+  if (wclist->words != NULL) {
+    for (size_t i = 0; i < wclist->len; i++)
+      fprintf(outfile, "%i\t%s\n", wclist->words[i]->count, wclist->words[i]->word);
+    return;
+  }
+  for (int s = 0; s < WORD_STRIPES; s++) {
+    word_stripe_t* stripe = &wclist->stripes[s];
+    pthread_mutex_lock(&stripe->lock);
+    for (size_t i = 0; i < stripe->len; i++)
+      fprintf(outfile, "%i\t%s\n", stripe->words[i]->count, stripe->words[i]->word);
+    pthread_mutex_unlock(&stripe->lock);
+  }
+}
+
+static int compare_words(const void* a, const void* b, void* aux) {
+  bool (*less)(const word_count_t*, const word_count_t*) = aux;
+  const word_count_t* wc1 = *(word_count_t* const*)a;
+  const word_count_t* wc2 = *(word_count_t* const*)b;
+  if (less(wc1, wc2))
+    return -1;
+  return less(wc2, wc1) ? 1 : 0;
+}
+
+void wordcount_sort(word_count_list_t* wclist,
+                    bool less(const word_count_t*, const word_count_t*)) {
+  /* Gather every stripe's entries into one array, which is what gets printed */
+  size_t len = len_words(wclist);
+  word_count_t** words = realloc(wclist->words, (len > 0 ? len : 1) * sizeof(word_count_t*));
+  if (words == NULL)
+    return;
+  wclist->words = words;
+  wclist->len = 0;
+  for (int s = 0; s < WORD_STRIPES; s++) {
+    word_stripe_t* stripe = &wclist->stripes[s];
+    pthread_mutex_lock(&stripe->lock);
+    memcpy(words + wclist->len, stripe->words, stripe->len * sizeof(word_count_t*));
+    wclist->len += stripe->len;
+    pthread_mutex_unlock(&stripe->lock);
+  }
+  qsort_r(wclist->words, wclist->len, sizeof(word_count_t*), compare_words, less);
+}
+
+static bool less_entry(const void* a, const void* b, void* aux) {
+  bool (*less)(const word_count_t*, const word_count_t*) = aux;
+  return less(a, b);
+}
+
+size_t top_words(word_count_list_t* wclist, size_t k,
+                 bool less(const word_count_t*, const word_count_t*), word_count_t** top) {
+  topk_t topk;
+  if (!topk_init(&topk, k, less_entry, less))
+    return 0;
+  for (int s = 0; s < WORD_STRIPES; s++) {
+    word_stripe_t* stripe = &wclist->stripes[s];
+    pthread_mutex_lock(&stripe->lock);
+    for (size_t i = 0; i < stripe->len; i++)
+      topk_offer(&topk, stripe->words[i]);
+    pthread_mutex_unlock(&stripe->lock);
+  }
+  size_t n = topk_finish(&topk, (const void**)top);
+  topk_destroy(&topk);
+  return n;
+}
+
+static bool less_alpha(const word_count_t* wc1, const word_count_t* wc2) {
+  return strcmp(wc1->word, wc2->word) < 0;
+}
+
+bool fsnapshot_words(word_count_list_t* wclist, FILE* outfile) {
+  snapshot_writer_t writer;
+  if (!snapshot_writer_init(&writer, outfile))
+    return false;
+  wordcount_sort(wclist, less_alpha);
+  for (size_t i = 0; i < wclist->len; i++)
+    snapshot_write(&writer, wclist->words[i]->word, strlen(wclist->words[i]->word),
+                   wclist->words[i]->count);
+  return snapshot_writer_finish(&writer);
+}
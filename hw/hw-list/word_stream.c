@@ -0,0 +1,53 @@
+/*
+ * Implementation of the word_stream interface, reading in large blocks so a
+ * word costs a few byte tests rather than a getc() call per letter.
+ */
+
+#include <stdlib.h>
+
+#include "word_stream.h"
+
+#define BLOCK_SIZE (1 << 16)
+
+/* Same test as isalpha() in the C locale, which is what count_words() uses. */
+static bool is_letter(unsigned char c) { return (unsigned char)((c | 0x20) - 'a') < 26; }
+
+bool scan_words(FILE* infile, word_fn fn, void* aux) {
+  char block[BLOCK_SIZE];
+  size_t word_size = 64, word_len = 0;
+  char* word = malloc(word_size);
+  if (word == NULL)
+    return false;
+
+  size_t n;
+  bool ok = true;
+  while (ok && (n = fread(block, 1, sizeof(block), infile)) > 0) {
+    for (size_t i = 0; ok && i < n; i++) {
+      if (is_letter(block[i])) {
+        /* Keep a byte free for the terminator */
+        if (word_len + 1 == word_size) {
+          char* bigger = realloc(word, word_size * 2);
+          if (bigger == NULL) {
+            ok = false;
+            break;
+          }
+          word = bigger;
+          word_size *= 2;
+        }
+        word[word_len++] = block[i] | 0x20; /* Lowercase; only letters get here */
+      } else {
+        if (word_len > 1) {
+          word[word_len] = '\0';
+          ok = fn(word, word_len, aux);
+        }
+        word_len = 0;
+      }
+    }
+  }
+  if (ok && word_len > 1) {
+    word[word_len] = '\0';
+    ok = fn(word, word_len, aux);
+  }
+  free(word);
+  return ok;
+}
@@ -0,0 +1,24 @@
+/*
+ * The word_stream interface finds the words of a stream the way count_words()
+ * does (runs of letters, lowercased, at least two long) and hands each one
+ * to a callback, for consumers that do not collect them into a word count
+ * list.
+ */
+
+#ifndef WORD_STREAM_H
+#define WORD_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Called with each word: len bytes at word, followed by a NUL. The bytes are
+ * only valid during the call. Returns false to stop the scan.
+ */
+typedef bool (*word_fn)(const char* word, size_t len, void* aux);
+
+/* Pass every word of infile to fn. Returns false if fn stopped early or memory ran out. */
+bool scan_words(FILE* infile, word_fn fn, void* aux);
+
+#endif /* WORD_STREAM_H */
@@ -0,0 +1,71 @@
+#!/bin/bash
+
+# Runs the other homeworks unmodified on mm_alloc (through mm_preload.so)
+# and on glibc, and compares wall time and peak RSS.
+
+# Set color output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+NC='\033[0m' # No Color
+
+REPS=${REPS:-3}
+WORDS=../hw-intro/words
+LIST=../hw-list
+SHELL_DIR=../hw-shell
+HTTP=../hw-http-rs
+
+echo -e "${BLUE}Comparing glibc and mm_alloc (${REPS} runs each)...${NC}"
+echo "=============================================="
+
+for cmd in "$WORDS/words -f $WORDS/gutenberg/alice.txt" \
+           "$LIST/lwords $LIST/gutenberg/peter.txt" \
+           "$LIST/pwords $LIST/gutenberg/peter.txt"; do
+    read -r -a CMD <<< "$cmd"
+    if [ -x "${CMD[0]}" ]; then
+        ./mm_run -n "$REPS" -- "${CMD[@]}" || echo -e "${RED}Command failed${NC}"
+    else
+        echo -e "${YELLOW}Skipping ${CMD[0]} (not built)${NC}"
+    fi
+done
+
+if [ -x "$SHELL_DIR/shell" ]; then
+    ./mm_run -n "$REPS" -i traces/shell-session.txt -- "$SHELL_DIR/shell" || echo -e "${RED}Command failed${NC}"
+else
+    echo -e "${YELLOW}Skipping $SHELL_DIR/shell (not built)${NC}"
+fi
+
+echo "=============================================="
+
+# The HTTP server is long-running: time a burst of requests and read its peak RSS
+SERVER=$HTTP/target/release/http_server_rs
+REQUESTS=${REQUESTS:-200}
+PORT=${PORT:-8162}
+if [ -x "$SERVER" ] && command -v curl > /dev/null; then
+    echo -e "${BLUE}$SERVER: ${REQUESTS} requests${NC}"
+    for mode in glibc mm; do
+        if [ "$mode" = mm ]; then
+            LD_PRELOAD=$PWD/mm_preload.so "$SERVER" --files "$HTTP/www" --port "$PORT" > /dev/null 2>&1 &
+        else
+            "$SERVER" --files "$HTTP/www" --port "$PORT" > /dev/null 2>&1 &
+        fi
+        SERVER_PID=$!
+        sleep 1
+        START=$(date +%s%N)
+        for ((i = 0; i < REQUESTS; i++)); do
+            curl -s -o /dev/null "http://localhost:$PORT/index.html"
+        done
+        END=$(date +%s%N)
+        RSS=$(awk '/VmHWM/ {print $2}' /proc/$SERVER_PID/status)
+        kill $SERVER_PID
+        wait $SERVER_PID 2> /dev/null
+        printf "  %-6s %10.3f ms/request %7s KB\n" "$mode" \
+            "$(echo "$START $END $REQUESTS" | awk '{print ($2 - $1) / 1e6 / $3}')" "$RSS"
+    done
+else
+    echo -e "${YELLOW}Skipping HTTP server (build $HTTP with 'make build')${NC}"
+fi
+
+echo "=============================================="
+echo -e "${GREEN}Comparison completed${NC}"
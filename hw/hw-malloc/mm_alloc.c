@@ -10,80 +10,452 @@
 #include <string.h>
 #include <stdint.h>
 
+// Every block and every payload is aligned like malloc(3) promises (max_align_t)
+#define ALIGNMENT 16
+#define ALIGN_UP(n) (((n) + (ALIGNMENT - 1)) & ~(size_t)(ALIGNMENT - 1))
+
 typedef struct metadata {
     size_t size;
 	struct metadata* prev;
    	struct metadata* next;
     int free; // 1 if the block is free, 0 if the block is allocated
-}metadata;
+} __attribute__((aligned(ALIGNMENT))) metadata;
 
 static metadata* head = NULL;
 static metadata* tail = NULL;
 
-void* mm_malloc(size_t size) {
-  //TODO: Implement malloc
-  if (size == 0) return NULL;
-  // Check if the size is too large
-  if (size > SIZE_MAX - sizeof(metadata)) {
-		return NULL;
+// Counters behind mm_stats(), kept current on every state change
+static mm_stats_t stats;
+// Whether stats.largest_free may be stale; recomputed lazily by mm_stats()
+static int largest_free_stale = 0;
+
+// Operations between dumps to stderr, from MM_STATS; 0 disables, -1 is unread
+static long dump_every = -1;
+static long ops_since_dump = 0;
+
+// Size class of a payload size: class k holds sizes up to 16 << k
+static int size_class(size_t size) {
+  int k = 0;
+  while (k < MM_SIZE_CLASSES - 1 && size > ((size_t)16 << k)) {
+      k++;
+  }
+  return k;
+}
+
+// Address of the first payload at or after payload in block that is aligned to
+// alignment and leaves room for the gap before it to become a free block
+static uintptr_t aligned_payload(metadata* block, size_t alignment) {
+  uintptr_t start = (uintptr_t)block + sizeof(metadata);
+  uintptr_t payload = (start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  while (payload != start && payload - start < sizeof(metadata) + ALIGNMENT) {
+      payload += alignment;
+  }
+  return payload;
+}
+
+// Whether size bytes fit in the free block at its first usable aligned payload
+static int fits_aligned(metadata* block, size_t size, size_t alignment) {
+  return aligned_payload(block, alignment) + size <= (uintptr_t)block + sizeof(metadata) + block->size;
+}
+
+/*
+ * Free block index: which free block a request is placed in. The policy is
+ * picked at build time:
+ *   (default)      first fit, scanning every block in address order
+ *   MM_SEGREGATED  segregated fits, one LIFO list of free blocks per size class
+ *   MM_BEST_FIT    best fit, from a treap of free blocks ordered by size
+ * The lists and the treap keep their links in the payload of the free block,
+ * which always has room for two pointers.
+ */
+#if defined(MM_BEST_FIT)
+
+typedef struct tree_links {
+    metadata* left;
+    metadata* right;
+} tree_links;
+
+#define LINKS(block) ((tree_links*)((char*)(block) + sizeof(metadata)))
+
+static metadata* root = NULL;
+
+// Orders free blocks by size, breaking ties by address so every key is unique
+static int block_less(metadata* a, metadata* b) {
+  return a->size < b->size || (a->size == b->size && a < b);
+}
+
+// Treap priority of a block: a hash of its address, so it takes no space
+static uint32_t priority(metadata* block) {
+  return (uint32_t)((((uintptr_t)block >> 4) * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+// Splits tree into the blocks ordered before key and the rest
+static void tree_split(metadata* tree, metadata* key, metadata** less, metadata** rest) {
+  if (tree == NULL) {
+      *less = *rest = NULL;
+  } else if (block_less(tree, key)) {
+      *less = tree;
+      tree_split(LINKS(tree)->right, key, &LINKS(tree)->right, rest);
+  } else {
+      *rest = tree;
+      tree_split(LINKS(tree)->left, key, less, &LINKS(tree)->left);
+  }
+}
+
+// Joins two treaps where every block in less is ordered before those in rest
+static metadata* tree_merge(metadata* less, metadata* rest) {
+  if (less == NULL || rest == NULL) {
+      return less != NULL ? less : rest;
+  }
+  if (priority(less) > priority(rest)) {
+      LINKS(less)->right = tree_merge(LINKS(less)->right, rest);
+      return less;
+  }
+  LINKS(rest)->left = tree_merge(less, LINKS(rest)->left);
+  return rest;
+}
+
+static void index_insert(metadata* block) {
+  metadata** link = &root;
+  uint32_t prio = priority(block);
+  while (*link != NULL && priority(*link) >= prio) {
+      link = block_less(block, *link) ? &LINKS(*link)->left : &LINKS(*link)->right;
+  }
+  tree_split(*link, block, &LINKS(block)->left, &LINKS(block)->right);
+  *link = block;
+}
+
+static void index_remove(metadata* block) {
+  metadata** link = &root;
+  while (*link != block) {
+      link = block_less(block, *link) ? &LINKS(*link)->left : &LINKS(*link)->right;
   }
-  // If the list is empty, create a new block
-  if (head == NULL) {
-      void* new_block = sbrk(size + sizeof(metadata));
-	  if (new_block == (void*) -1) {
-          return NULL;
+  *link = tree_merge(LINKS(block)->left, LINKS(block)->right);
+}
+
+// Smallest free block of at least size bytes, lowest address first among equals
+static metadata* index_find(size_t size) {
+  metadata* best = NULL;
+  metadata* node = root;
+  while (node != NULL) {
+      if (node->size >= size) {
+          best = node;
+          node = LINKS(node)->left;
+      } else {
+          node = LINKS(node)->right;
       }
+  }
+  return best;
+}
 
-	  head = (metadata*) new_block;
-      head->size = size;
-      head->prev = NULL;
-      head->next = NULL;
-      head->free = 0;
-      tail = head;
-      return (void*)((char*)head + sizeof(metadata));
+// Smallest free block the request fits in at the given alignment. The walk is in
+// order of size from size up, and stops at the first block that fits
+static metadata* tree_find_aligned(metadata* node, size_t size, size_t alignment) {
+  if (node == NULL) {
+      return NULL;
   }
+  if (node->size < size) {
+      return tree_find_aligned(LINKS(node)->right, size, alignment);
+  }
+  metadata* found = tree_find_aligned(LINKS(node)->left, size, alignment);
+  if (found != NULL) {
+      return found;
+  }
+  if (fits_aligned(node, size, alignment)) {
+      return node;
+  }
+  return tree_find_aligned(LINKS(node)->right, size, alignment);
+}
 
-  for (metadata* curr = head; curr != NULL; curr = curr->next) {
-      // If the current block is free and the size is large enough, allocate it
-      if (curr->free && curr->size >= size + sizeof(metadata) && curr->size - size - sizeof(metadata) < sizeof(metadata)) {
-          curr->free = 0;
-		  curr->size = size;
-          return (void*)((char*)curr + sizeof(metadata));
-      } else if (curr->free && curr->size > size + sizeof(metadata) * 2) {
-          // If the current block is free and the size is too large, split the block
-          metadata* new_block = (metadata*)((char*)curr + sizeof(metadata) + size);
-          new_block->size = curr->size - size - sizeof(metadata);
-          new_block->prev = curr;
-          new_block->next = curr->next;
-          new_block->free = 1;
-          if (curr->next != NULL) {
-              curr->next->prev = new_block;
+static metadata* index_find_aligned(size_t size, size_t alignment) {
+  return tree_find_aligned(root, size, alignment);
+}
+
+#elif defined(MM_SEGREGATED)
+
+typedef struct list_links {
+    metadata* prev;
+    metadata* next;
+} list_links;
+
+#define LINKS(block) ((list_links*)((char*)(block) + sizeof(metadata)))
+
+static metadata* free_lists[MM_SIZE_CLASSES];
+
+static void index_insert(metadata* block) {
+  int k = size_class(block->size);
+  LINKS(block)->prev = NULL;
+  LINKS(block)->next = free_lists[k];
+  if (free_lists[k] != NULL) {
+      LINKS(free_lists[k])->prev = block;
+  }
+  free_lists[k] = block;
+}
+
+static void index_remove(metadata* block) {
+  metadata* prev = LINKS(block)->prev;
+  metadata* next = LINKS(block)->next;
+  if (prev != NULL) {
+      LINKS(prev)->next = next;
+  } else {
+      free_lists[size_class(block->size)] = next;
+  }
+  if (next != NULL) {
+      LINKS(next)->prev = prev;
+  }
+}
+
+// First fit within the request's own class; any block in a larger class fits
+static metadata* index_find(size_t size) {
+  for (int k = size_class(size); k < MM_SIZE_CLASSES; k++) {
+      for (metadata* curr = free_lists[k]; curr != NULL; curr = LINKS(curr)->next) {
+          if (curr->size >= size) {
+              return curr;
           }
-          curr->next = new_block;
-          curr->size = size;
-          curr->free = 0;
-          return (void*)((char*)curr + sizeof(metadata));
       }
   }
+  return NULL;
+}
 
-  // If no block is found, allocate a new block
-  void* block = sbrk(size + sizeof(metadata));
+static metadata* index_find_aligned(size_t size, size_t alignment) {
+  for (int k = size_class(size); k < MM_SIZE_CLASSES; k++) {
+      for (metadata* curr = free_lists[k]; curr != NULL; curr = LINKS(curr)->next) {
+          if (curr->size >= size && fits_aligned(curr, size, alignment)) {
+              return curr;
+          }
+      }
+  }
+  return NULL;
+}
+
+#else
+
+static void index_insert(metadata* block) { (void)block; }
+
+static void index_remove(metadata* block) { (void)block; }
+
+static metadata* index_find(size_t size) {
+  for (metadata* curr = head; curr != NULL; curr = curr->next) {
+      if (curr->free && curr->size >= size) {
+          return curr;
+      }
+  }
+  return NULL;
+}
+
+static metadata* index_find_aligned(size_t size, size_t alignment) {
+  for (metadata* curr = head; curr != NULL; curr = curr->next) {
+      if (curr->free && curr->size >= size && fits_aligned(curr, size, alignment)) {
+          return curr;
+      }
+  }
+  return NULL;
+}
+
+#endif
+
+// Indexes and accounts for a block that just became free or grew while free
+static void insert_free(metadata* block) {
+  index_insert(block);
+  stats.bytes_free += block->size;
+  stats.free_blocks++;
+  stats.free_by_class[size_class(block->size)]++;
+  if (block->size > stats.largest_free) {
+      stats.largest_free = block->size;
+  }
+}
+
+// Unindexes a free block that is about to be handed out, merged or resized
+static void remove_free(metadata* block) {
+  index_remove(block);
+  stats.bytes_free -= block->size;
+  stats.free_blocks--;
+  stats.free_by_class[size_class(block->size)]--;
+  if (block->size == stats.largest_free) {
+      largest_free_stale = 1;
+  }
+}
+
+static void maybe_dump_stats(void) {
+  if (dump_every < 0) {
+      const char* env = getenv("MM_STATS");
+      dump_every = env != NULL ? atol(env) : 0;
+  }
+  if (dump_every > 0 && ++ops_since_dump >= dump_every) {
+      ops_since_dump = 0;
+      mm_stats_dump(STDERR_FILENO);
+  }
+}
+
+// Grows the heap by bytes, first padding the break in case someone else moved it
+static void* heap_grow(size_t bytes) {
+  uintptr_t brk = (uintptr_t)sbrk(0);
+  size_t pad = ALIGN_UP(brk) - brk;
+  if (pad > 0 && sbrk(pad) == (void*) -1) {
+      return (void*) -1;
+  }
+  void* block = sbrk(bytes);
+  if (block != (void*) -1) {
+      stats.heap_size += pad + bytes;
+  }
+  return block;
+}
+
+// Hands out the free block curr for a request of size bytes, splitting off the
+// rest as a new free block when it is big enough to be worth a header
+static void* place(metadata* curr, size_t size) {
+  remove_free(curr);
+  curr->free = 0;
+  // If the block is too small to split, hand out all of it. Keeping its full
+  // size keeps it adjacent to its neighbour for later coalescing.
+  if (curr->size <= size + sizeof(metadata) * 2) {
+      stats.bytes_in_use += curr->size;
+      return (void*)((char*)curr + sizeof(metadata));
+  }
+  metadata* new_block = (metadata*)((char*)curr + sizeof(metadata) + size);
+  new_block->size = curr->size - size - sizeof(metadata);
+  new_block->prev = curr;
+  new_block->next = curr->next;
+  new_block->free = 1;
+  if (curr->next != NULL) {
+      curr->next->prev = new_block;
+  } else {
+      tail = new_block;
+  }
+  curr->next = new_block;
+  curr->size = size;
+  insert_free(new_block);
+  stats.bytes_in_use += size;
+  return (void*)((char*)curr + sizeof(metadata));
+}
+
+// Appends a new allocated block of size bytes at the end of the heap
+static metadata* extend_heap(size_t size) {
+  void* block = heap_grow(size + sizeof(metadata));
   if (block == (void*) -1) {
       return NULL;
   }
 
   metadata* new_block = (metadata*)block;
-
   new_block->size = size;
-  new_block->prev = NULL;
+  new_block->prev = tail;
   new_block->next = NULL;
   new_block->free = 0;
-  tail->next = new_block;
-  new_block->prev = tail;
+  if (tail != NULL) {
+      tail->next = new_block;
+  } else {
+      head = new_block;
+  }
   tail = new_block;
+  stats.bytes_in_use += size;
+  return new_block;
+}
+
+// Allocates size bytes, setting *fresh if the payload is untouched memory from sbrk
+static void* malloc_block(size_t size, int* fresh) {
+  *fresh = 0;
+  if (size == 0) return NULL;
+  // Check if the size is too large
+  if (size > SIZE_MAX - sizeof(metadata) - ALIGNMENT) {
+		return NULL;
+  }
+  size = ALIGN_UP(size);
+  stats.allocs_by_class[size_class(size)]++;
+  maybe_dump_stats();
+
+  metadata* curr = index_find(size);
+  if (curr != NULL) {
+      return place(curr, size);
+  }
+
+  // If no block is found, allocate a new block
+  metadata* new_block = extend_heap(size);
+  if (new_block == NULL) {
+      return NULL;
+  }
+  *fresh = 1;
   return (void*)((char*)new_block + sizeof(metadata));
 }
 
+void* mm_malloc(size_t size) {
+  int fresh;
+  return malloc_block(size, &fresh);
+}
+
+void* mm_calloc(size_t nmemb, size_t size) {
+  if (size != 0 && nmemb > SIZE_MAX / size) {
+      return NULL;
+  }
+  int fresh;
+  void* ptr = malloc_block(nmemb * size, &fresh);
+  // The break only ever grows, so memory new from sbrk is still zero-filled
+  if (ptr != NULL && !fresh) {
+      memset(ptr, 0, nmemb * size);
+  }
+  return ptr;
+}
+
+// Carves an aligned payload out of the free block curr. The bytes in front of it
+// stay behind as a smaller free block instead of being wasted.
+static void* place_aligned(metadata* curr, uintptr_t payload, size_t size) {
+  uintptr_t start = (uintptr_t)curr + sizeof(metadata);
+  if (payload == start) {
+      return place(curr, size);
+  }
+
+  remove_free(curr);
+  metadata* aligned = (metadata*)(payload - sizeof(metadata));
+  aligned->size = start + curr->size - payload;
+  aligned->prev = curr;
+  aligned->next = curr->next;
+  aligned->free = 1;
+  if (curr->next != NULL) {
+      curr->next->prev = aligned;
+  } else {
+      tail = aligned;
+  }
+  curr->next = aligned;
+  curr->size = (uintptr_t)aligned - start;
+  insert_free(curr);
+  insert_free(aligned);
+  return place(aligned, size);
+}
+
+void* mm_memalign(size_t alignment, size_t size) {
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+      return NULL;
+  }
+  if (alignment <= ALIGNMENT) {
+      return mm_malloc(size);
+  }
+  if (size == 0 || size > SIZE_MAX / 2 - alignment - sizeof(metadata) * 2) {
+      return NULL;
+  }
+  size = ALIGN_UP(size);
+
+  // A free block the request fits in once aligned, even one of exactly size bytes
+  // that already sits at the alignment
+  metadata* curr = index_find_aligned(size, alignment);
+  if (curr != NULL) {
+      stats.allocs_by_class[size_class(size)]++;
+      return place_aligned(curr, aligned_payload(curr, alignment), size);
+  }
+
+  // Otherwise grow the heap by enough to hold the request at any alignment, and
+  // carve the request out of that
+  size_t padded = size + alignment + sizeof(metadata) + ALIGNMENT;
+  metadata* block = extend_heap(padded);
+  if (block == NULL) {
+      return NULL;
+  }
+  stats.bytes_in_use -= block->size;
+  block->free = 1;
+  insert_free(block);
+  stats.allocs_by_class[size_class(size)]++;
+  return place_aligned(block, aligned_payload(block, alignment), size);
+}
+
+void* mm_aligned_alloc(size_t alignment, size_t size) { return mm_memalign(alignment, size); }
+
 // Reallocates the memory block pointed to by ptr to have new size bytes
 void* mm_realloc(void* ptr, size_t size) {
 	//TODO: Implement realloc
@@ -106,22 +478,37 @@ void* mm_realloc(void* ptr, size_t size) {
     return new_ptr;
 }
 
+size_t mm_usable_size(void* ptr) {
+	if (ptr == NULL) return 0;
+	metadata* block = (metadata*)((char*)ptr - sizeof(metadata));
+	return block->size;
+}
+
 void mm_free(void* ptr) {
 	//TODO: Implement free
 	if (ptr == NULL) return;
 	metadata* block = (metadata*)((char*)ptr - sizeof(metadata));
     block->free = 1;
+    stats.bytes_in_use -= block->size;
+    stats.frees++;
+    insert_free(block);
+    maybe_dump_stats();
 
     // If the previous block is free and the current block is free, coalesce the blocks
   	if (block->prev != NULL && block->prev->free) {
 		metadata* prev_block = block->prev;
 		if ((char*)prev_block + prev_block->size + sizeof(metadata) == (char*)block) {
+			remove_free(prev_block);
+			remove_free(block);
 			prev_block->size += block->size + sizeof(metadata);
 			prev_block->next = block->next;
 			if (block->next != NULL) {
 				block->next->prev = prev_block;
-          	}
+          	} else {
+				tail = prev_block;
+			}
 		  	block = prev_block;
+			insert_free(block);
       	}
   	}
 
@@ -129,11 +516,60 @@ void mm_free(void* ptr) {
 	if (block->next != NULL && block->next->free) {
     	metadata* next_block = block->next;
     		if ((char*)block + block->size + sizeof(metadata) == (char*)next_block) {
+        		remove_free(block);
+        		remove_free(next_block);
         		block->size += next_block->size + sizeof(metadata);
         		block->next = next_block->next;
         		if (next_block->next != NULL) {
             		next_block->next->prev = block;
+        		} else {
+            		tail = block;
         		}
+        		insert_free(block);
     		}
 	}
 }
+
+void mm_stats(mm_stats_t* out) {
+  if (largest_free_stale) {
+      stats.largest_free = 0;
+      for (metadata* curr = head; curr != NULL; curr = curr->next) {
+          if (curr->free && curr->size > stats.largest_free) {
+              stats.largest_free = curr->size;
+          }
+      }
+      largest_free_stale = 0;
+  }
+  *out = stats;
+}
+
+void mm_heap_walk(mm_walk_fn* fn, void* aux) {
+  for (metadata* curr = head; curr != NULL; curr = curr->next) {
+      fn((char*)curr + sizeof(metadata), curr->size, curr->free, aux);
+  }
+}
+
+void mm_stats_dump(int fd) {
+  mm_stats_t st;
+  mm_stats(&st);
+  // Formatted on the stack: stdio may allocate, and we may be inside malloc
+  char buf[1024];
+  int len = snprintf(buf, sizeof(buf),
+                     "mm_stats: heap %zu in_use %zu free %zu in %zu blocks, largest %zu, frees %zu\n"
+                     "mm_stats: size class  allocs  free blocks\n",
+                     st.heap_size, st.bytes_in_use, st.bytes_free, st.free_blocks,
+                     st.largest_free, st.frees);
+  for (int k = 0; k < MM_SIZE_CLASSES && len < (int)sizeof(buf); k++) {
+      if (st.allocs_by_class[k] == 0 && st.free_by_class[k] == 0) {
+          continue;
+      }
+      len += snprintf(buf + len, sizeof(buf) - len, "mm_stats: <=%-9zu %7zu %12zu\n",
+                      (size_t)16 << k, st.allocs_by_class[k], st.free_by_class[k]);
+  }
+  if (len > (int)sizeof(buf)) {
+      len = sizeof(buf);
+  }
+  if (write(fd, buf, len) < 0) {
+      return;
+  }
+}
@@ -11,8 +11,36 @@
 
 #include <stdlib.h>
 
+#include "mm_stats.h"
+
 void* mm_malloc(size_t size);
 void* mm_realloc(void* ptr, size_t size);
 void mm_free(void* ptr);
 
+/* Zero-initialized allocation (see "man 3 calloc"). */
+void* mm_calloc(size_t nmemb, size_t size);
+
+/*
+ * Allocation aligned to alignment, a power of two (see "man 3 memalign" and
+ * "man 3 aligned_alloc"). The result is an ordinary block: mm_free() and
+ * mm_realloc() accept it. mm_realloc() does not preserve the alignment.
+ */
+void* mm_memalign(size_t alignment, size_t size);
+void* mm_aligned_alloc(size_t alignment, size_t size);
+
+/* Number of usable bytes in the block at ptr (see "man 3 malloc_usable_size"). */
+size_t mm_usable_size(void* ptr);
+
+/* Fills stats with the current heap statistics. */
+void mm_stats(mm_stats_t* stats);
+
+/* Calls fn for every block, in address order. */
+void mm_heap_walk(mm_walk_fn* fn, void* aux);
+
+/*
+ * Writes the statistics to fd. Setting MM_STATS=N in the environment dumps
+ * them to stderr every N calls to mm_malloc/mm_free.
+ */
+void mm_stats_dump(int fd);
+
 #endif
@@ -0,0 +1,460 @@
+/*
+ * mm_bench.c
+ *
+ * Replays allocation traces against each placement policy of mm_alloc and
+ * against the system allocator, and reports throughput, heap utilization and
+ * a histogram of the holes left between live blocks.
+ *
+ * Trace format: one operation per line, '#' starts a comment.
+ *   a <id> <size>   allocate <size> bytes and name the block <id>
+ *   r <id> <size>   reallocate block <id> to <size> bytes
+ *   f <id>          free block <id>
+ */
+
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Number of power-of-two buckets in the hole histogram. */
+#define HOLE_BUCKETS 16
+
+typedef enum { OP_ALLOC, OP_REALLOC, OP_FREE } op_type_t;
+
+typedef struct trace_op {
+  op_type_t type;
+  int id;
+  size_t size;
+} trace_op_t;
+
+typedef struct trace {
+  const char* name;
+  trace_op_t* ops;
+  size_t capacity;
+  size_t n_ops;
+  int n_ids;
+  size_t peak_live; // Largest number of requested bytes live at once
+  size_t peak_op;   // Index of the operation that reaches peak_live
+} trace_t;
+
+/* One allocator under test, reached through dlsym like mm_test does. */
+typedef struct allocator {
+  const char* name;
+  void* (*malloc)(size_t);
+  void* (*realloc)(void*, size_t);
+  void (*free)(void*);
+  size_t (*heap_extent)(void); // Bytes of heap the allocator has claimed
+} allocator_t;
+
+/* A live block, used to measure holes in the heap at peak. */
+typedef struct block {
+  uintptr_t addr;
+  size_t size;
+} block_t;
+
+static void* try_dlsym(void* handle, const char* symbol) {
+  char* error;
+  void* function = dlsym(handle, symbol);
+  if ((error = dlerror())) {
+    fprintf(stderr, "%s\n", error);
+    exit(EXIT_FAILURE);
+  }
+  return function;
+}
+
+/* mm_alloc grows only through sbrk and never gives memory back. */
+static size_t mm_heap_extent(void) { return (uintptr_t)sbrk(0); }
+
+/*
+ * glibc grows its heap in large steps, so the break alone hides small
+ * traces. The arena minus the releasable top chunk is the part in use.
+ */
+static size_t libc_heap_extent(void) {
+  struct mallinfo2 info = mallinfo2();
+  return info.arena - info.keepcost;
+}
+
+/* Builds of mm_alloc, one per placement policy; see the Makefile. */
+static const char* mm_builds[][2] = {
+    {"mm", "hw3lib.so"},
+    {"mm-seg", "hw3lib-seg.so"},
+    {"mm-best", "hw3lib-best.so"},
+};
+
+#define N_MM_BUILDS (sizeof(mm_builds) / sizeof(mm_builds[0]))
+
+static void load_mm_allocator(allocator_t* alloc, const char* name, const char* library) {
+  void* handle = dlopen(library, RTLD_NOW);
+  if (!handle) {
+    fprintf(stderr, "%s\n", dlerror());
+    exit(EXIT_FAILURE);
+  }
+
+  alloc->name = name;
+  alloc->malloc = try_dlsym(handle, "mm_malloc");
+  alloc->realloc = try_dlsym(handle, "mm_realloc");
+  alloc->free = try_dlsym(handle, "mm_free");
+  alloc->heap_extent = mm_heap_extent;
+}
+
+static void load_libc_allocator(allocator_t* alloc) {
+  alloc->name = "libc";
+  alloc->malloc = try_dlsym(RTLD_DEFAULT, "malloc");
+  alloc->realloc = try_dlsym(RTLD_DEFAULT, "realloc");
+  alloc->free = try_dlsym(RTLD_DEFAULT, "free");
+  alloc->heap_extent = libc_heap_extent;
+}
+
+/*
+ * The harness keeps its own memory off the brk heap so that it neither
+ * shows up in, nor leaves reusable holes in, the heap being measured.
+ */
+static void* bench_alloc(size_t size) {
+  void* ptr = mmap(NULL, size ? size : 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) {
+    perror("mmap");
+    exit(EXIT_FAILURE);
+  }
+  return ptr;
+}
+
+static void bench_free(void* ptr, size_t size) { munmap(ptr, size ? size : 1); }
+
+/* Parses one trace line. Returns 1 for an operation, 0 for a blank or comment line. */
+static int parse_line(const char* line, const char* end, trace_op_t* op) {
+  while (line < end && isspace((unsigned char)*line))
+    line++;
+  if (line == end || *line == '#')
+    return 0;
+
+  char kind = *line++;
+  char* next;
+  long id = strtol(line, &next, 10);
+  if (next == line || id < 0)
+    return -1;
+  op->id = id;
+  op->size = 0;
+  if (kind == 'f') {
+    op->type = OP_FREE;
+    return 1;
+  }
+  line = next;
+  op->size = strtoul(line, &next, 10);
+  if (next == line)
+    return -1;
+  if (kind == 'a')
+    op->type = OP_ALLOC;
+  else if (kind == 'r')
+    op->type = OP_REALLOC;
+  else
+    return -1;
+  return 1;
+}
+
+/* Reads a trace file into memory and precomputes its peak live size. */
+static int load_trace(const char* path, trace_t* trace) {
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    perror(path);
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  size_t length = st.st_size;
+  const char* text = length ? mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0) : "";
+  close(fd);
+  if (text == MAP_FAILED) {
+    perror(path);
+    return -1;
+  }
+
+  size_t capacity = 1;
+  for (size_t i = 0; i < length; i++)
+    capacity += text[i] == '\n';
+
+  trace->name = path;
+  trace->capacity = capacity;
+  trace->ops = bench_alloc(capacity * sizeof(trace_op_t));
+  trace->n_ops = 0;
+  trace->n_ids = 0;
+
+  int line_num = 0;
+  int result = 0;
+  for (const char* line = text; line < text + length; line++) {
+    const char* end = memchr(line, '\n', text + length - line);
+    if (end == NULL)
+      end = text + length;
+    line_num++;
+
+    trace_op_t* op = &trace->ops[trace->n_ops];
+    int parsed = parse_line(line, end, op);
+    if (parsed < 0) {
+      fprintf(stderr, "%s:%d: malformed trace line\n", path, line_num);
+      result = -1;
+      break;
+    } else if (parsed > 0) {
+      trace->n_ops++;
+      if (op->id >= trace->n_ids)
+        trace->n_ids = op->id + 1;
+    }
+    line = end;
+  }
+  if (length)
+    munmap((void*)text, length);
+  if (result < 0) {
+    bench_free(trace->ops, capacity * sizeof(trace_op_t));
+    return -1;
+  }
+
+  /* Peak live bytes depend only on the trace, not on the allocator. */
+  size_t* sizes = bench_alloc(trace->n_ids * sizeof(size_t));
+  size_t live = 0;
+  trace->peak_live = 0;
+  trace->peak_op = 0;
+  for (size_t i = 0; i < trace->n_ops; i++) {
+    trace_op_t* op = &trace->ops[i];
+    live -= sizes[op->id];
+    sizes[op->id] = op->type == OP_FREE ? 0 : op->size;
+    live += sizes[op->id];
+    if (live > trace->peak_live) {
+      trace->peak_live = live;
+      trace->peak_op = i;
+    }
+  }
+  bench_free(sizes, trace->n_ids * sizeof(size_t));
+  return 0;
+}
+
+/* Applies one trace operation. Returns -1 if the allocator failed it. */
+static int replay_op(allocator_t* alloc, trace_op_t* op, void** ptrs, size_t* sizes) {
+  switch (op->type) {
+    case OP_ALLOC:
+      ptrs[op->id] = alloc->malloc(op->size);
+      break;
+    case OP_REALLOC:
+      ptrs[op->id] = alloc->realloc(ptrs[op->id], op->size);
+      break;
+    case OP_FREE:
+      alloc->free(ptrs[op->id]);
+      ptrs[op->id] = NULL;
+      sizes[op->id] = 0;
+      return 0;
+  }
+  if (ptrs[op->id] == NULL && op->size > 0)
+    return -1;
+  sizes[op->id] = op->size;
+  return 0;
+}
+
+/* Frees whatever the trace left allocated so the next repetition starts clean. */
+static void release_all(allocator_t* alloc, trace_t* trace, void** ptrs, size_t* sizes) {
+  for (int id = 0; id < trace->n_ids; id++) {
+    if (ptrs[id] != NULL)
+      alloc->free(ptrs[id]);
+    ptrs[id] = NULL;
+    sizes[id] = 0;
+  }
+}
+
+static int compare_blocks(const void* a, const void* b) {
+  const block_t* ba = a;
+  const block_t* bb = b;
+  return (ba->addr > bb->addr) - (ba->addr < bb->addr);
+}
+
+/*
+ * Buckets the gaps between consecutive live blocks by powers of two.
+ * Gaps include per-block headers, so every allocator reports some small
+ * holes even on a perfectly packed heap.
+ */
+static void hole_histogram(trace_t* trace, void** ptrs, size_t* sizes, block_t* blocks,
+                           size_t hist[HOLE_BUCKETS]) {
+  size_t n = 0;
+  for (int id = 0; id < trace->n_ids; id++) {
+    if (ptrs[id] != NULL) {
+      blocks[n].addr = (uintptr_t)ptrs[id];
+      blocks[n].size = sizes[id];
+      n++;
+    }
+  }
+  qsort(blocks, n, sizeof(block_t), compare_blocks);
+
+  memset(hist, 0, HOLE_BUCKETS * sizeof(size_t));
+  for (size_t i = 1; i < n; i++) {
+    uintptr_t end = blocks[i - 1].addr + blocks[i - 1].size;
+    if (blocks[i].addr < end)
+      continue;
+    size_t gap = blocks[i].addr - end;
+    int bucket = 0;
+    while (bucket < HOLE_BUCKETS - 1 && gap >= ((size_t)16 << bucket))
+      bucket++;
+    hist[bucket]++;
+  }
+}
+
+static double now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Runs one trace against one allocator. Called in a forked child so that
+ * every measurement starts from an untouched heap.
+ */
+static int bench_child(allocator_t* alloc, trace_t* trace, int reps) {
+  void** ptrs = bench_alloc(trace->n_ids * sizeof(void*));
+  size_t* sizes = bench_alloc(trace->n_ids * sizeof(size_t));
+  block_t* blocks = bench_alloc(trace->n_ids * sizeof(block_t));
+  size_t hist[HOLE_BUCKETS];
+  memset(hist, 0, sizeof(hist));
+
+  /* Keep large system allocations on the heap so they are measured too. */
+  mallopt(M_MMAP_MAX, 0);
+
+  /* Utilization pass: sample the heap extent after every operation. */
+  size_t heap_base = alloc->heap_extent();
+  size_t peak_heap = 0;
+  for (size_t i = 0; i < trace->n_ops; i++) {
+    if (replay_op(alloc, &trace->ops[i], ptrs, sizes) < 0) {
+      fprintf(stderr, "%s: %s failed op %zu\n", trace->name, alloc->name, i);
+      return 1;
+    }
+    size_t heap = alloc->heap_extent() - heap_base;
+    if (heap > peak_heap)
+      peak_heap = heap;
+    if (i == trace->peak_op)
+      hole_histogram(trace, ptrs, sizes, blocks, hist);
+  }
+  release_all(alloc, trace, ptrs, sizes);
+
+  /* Throughput passes: no instrumentation inside the loop. */
+  double start = now_seconds();
+  for (int rep = 0; rep < reps; rep++) {
+    for (size_t i = 0; i < trace->n_ops; i++)
+      replay_op(alloc, &trace->ops[i], ptrs, sizes);
+    release_all(alloc, trace, ptrs, sizes);
+  }
+  double elapsed = now_seconds() - start;
+  double ops_per_sec = elapsed > 0 ? trace->n_ops * (double)reps / elapsed : 0;
+
+  double util = peak_heap > 0 ? 100.0 * trace->peak_live / peak_heap : 0;
+  printf("%-32s %-8s %10zu %12.0f %12zu %12zu %6.1f%%\n", trace->name, alloc->name,
+         trace->n_ops, ops_per_sec, trace->peak_live, peak_heap, util);
+  printf("  holes at peak:");
+  for (int b = 0; b < HOLE_BUCKETS; b++) {
+    if (hist[b] > 0)
+      printf(" <%zu:%zu", (size_t)16 << b, hist[b]);
+  }
+  printf("\n");
+  fflush(stdout);
+  return 0;
+}
+
+static int bench_one(allocator_t* alloc, trace_t* trace, int reps) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    exit(bench_child(alloc, trace, reps));
+  } else if (pid < 0) {
+    perror("fork");
+    return -1;
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "%s: %s did not complete\n", trace->name, alloc->name);
+    return -1;
+  }
+  return 0;
+}
+
+static void usage(const char* prog) {
+  fprintf(stderr,
+          "usage: %s [-a allocator,...] [-n reps] trace...\n"
+          "  -a  allocators to benchmark: mm, mm-seg, mm-best, libc or all (default: all)\n"
+          "  -n  throughput repetitions per trace (default: 5)\n",
+          prog);
+}
+
+int main(int argc, char* argv[]) {
+  char all[] = "all";
+  char* which = all;
+  int reps = 5;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:n:h")) != -1) {
+    switch (opt) {
+      case 'a':
+        which = optarg;
+        break;
+      case 'n':
+        reps = atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc || reps <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  /* One flag per mm build, then one for libc. */
+  int wanted[N_MM_BUILDS + 1] = {0};
+  for (char* name = strtok(which, ","); name != NULL; name = strtok(NULL, ",")) {
+    int found = 0;
+    for (size_t b = 0; b <= N_MM_BUILDS; b++) {
+      const char* build = b < N_MM_BUILDS ? mm_builds[b][0] : "libc";
+      if (strcmp(name, "all") == 0 || strcmp(name, build) == 0)
+        wanted[b] = found = 1;
+    }
+    if (!found) {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  allocator_t allocators[N_MM_BUILDS + 1];
+  int n_allocators = 0;
+  for (size_t b = 0; b < N_MM_BUILDS; b++) {
+    if (wanted[b])
+      load_mm_allocator(&allocators[n_allocators++], mm_builds[b][0], mm_builds[b][1]);
+  }
+  if (wanted[N_MM_BUILDS])
+    load_libc_allocator(&allocators[n_allocators++]);
+  if (n_allocators == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  printf("%-32s %-8s %10s %12s %12s %12s %7s\n", "trace", "alloc", "ops", "ops/sec",
+         "peak_live", "peak_heap", "util");
+
+  int failed = 0;
+  for (int i = optind; i < argc; i++) {
+    trace_t trace;
+    if (load_trace(argv[i], &trace) < 0) {
+      failed = 1;
+      continue;
+    }
+    for (int a = 0; a < n_allocators; a++) {
+      if (bench_one(&allocators[a], &trace, reps) < 0)
+        failed = 1;
+    }
+    bench_free(trace.ops, trace.capacity * sizeof(trace_op_t));
+  }
+  return failed;
+}
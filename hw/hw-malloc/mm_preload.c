@@ -0,0 +1,119 @@
+/*
+ * mm_preload.c
+ *
+ * Interposes the C allocator so that unmodified programs run on mm_alloc:
+ *
+ *   LD_PRELOAD=./mm_preload.so ./program
+ *
+ * mm_alloc is linked into this library rather than looked up with dlsym,
+ * so there is no window in which malloc is called before the allocator is
+ * found, and nothing to bootstrap. mm_alloc itself is not thread-safe; one
+ * lock serializes every call and is held across fork() so the child never
+ * inherits a heap that is halfway through an update.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "mm_alloc.h"
+
+static pthread_mutex_t mm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void prepare_fork(void) { pthread_mutex_lock(&mm_lock); }
+
+static void parent_fork(void) { pthread_mutex_unlock(&mm_lock); }
+
+static void child_fork(void) { pthread_mutex_init(&mm_lock, NULL); }
+
+__attribute__((constructor)) static void preload_init(void) {
+  pthread_atfork(prepare_fork, parent_fork, child_fork);
+}
+
+void* malloc(size_t size) {
+  pthread_mutex_lock(&mm_lock);
+  /* mm_malloc(0) returns NULL, but malloc(0) must return a unique pointer. */
+  void* ptr = mm_malloc(size ? size : 1);
+  pthread_mutex_unlock(&mm_lock);
+  if (ptr == NULL)
+    errno = ENOMEM;
+  return ptr;
+}
+
+void free(void* ptr) {
+  if (ptr == NULL)
+    return;
+  pthread_mutex_lock(&mm_lock);
+  mm_free(ptr);
+  pthread_mutex_unlock(&mm_lock);
+}
+
+void* calloc(size_t nmemb, size_t size) {
+  if (nmemb == 0 || size == 0)
+    nmemb = size = 1;
+  pthread_mutex_lock(&mm_lock);
+  void* ptr = mm_calloc(nmemb, size);
+  pthread_mutex_unlock(&mm_lock);
+  if (ptr == NULL)
+    errno = ENOMEM;
+  return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+  if (ptr == NULL)
+    return malloc(size);
+  if (size == 0) {
+    free(ptr);
+    return NULL;
+  }
+
+  pthread_mutex_lock(&mm_lock);
+  void* new_ptr = mm_realloc(ptr, size);
+  pthread_mutex_unlock(&mm_lock);
+  if (new_ptr == NULL)
+    errno = ENOMEM;
+  return new_ptr;
+}
+
+int posix_memalign(void** memptr, size_t alignment, size_t size) {
+  if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+    return EINVAL;
+  pthread_mutex_lock(&mm_lock);
+  void* ptr = mm_memalign(alignment, size ? size : 1);
+  pthread_mutex_unlock(&mm_lock);
+  if (ptr == NULL)
+    return ENOMEM;
+  *memptr = ptr;
+  return 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  pthread_mutex_lock(&mm_lock);
+  void* ptr = mm_aligned_alloc(alignment, size ? size : 1);
+  pthread_mutex_unlock(&mm_lock);
+  if (ptr == NULL)
+    errno = ENOMEM;
+  return ptr;
+}
+
+void* memalign(size_t alignment, size_t size) { return aligned_alloc(alignment, size); }
+
+void* valloc(size_t size) { return aligned_alloc(sysconf(_SC_PAGESIZE), size); }
+
+void* pvalloc(size_t size) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  return aligned_alloc(page, (size + page - 1) & ~(page - 1));
+}
+
+size_t malloc_usable_size(void* ptr) {
+  if (ptr == NULL)
+    return 0;
+  pthread_mutex_lock(&mm_lock);
+  size_t size = mm_usable_size(ptr);
+  pthread_mutex_unlock(&mm_lock);
+  return size;
+}
@@ -0,0 +1,135 @@
+/*
+ * mm_run.c
+ *
+ * Runs a command on the system allocator and again with mm_preload.so
+ * interposed, and reports wall time and peak RSS for both:
+ *
+ *   ./mm_run [-n reps] [-i input] -- command [args...]
+ *
+ * The command's stdout is discarded; stdin comes from input if given.
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct run_result {
+  double wall_ms; // Mean over all repetitions
+  long max_rss_kb; // Largest peak RSS of any repetition
+  int failed;
+} run_result_t;
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* Forks and execs argv once, with preload (if any) in LD_PRELOAD. */
+static int run_once(char** argv, const char* input, const char* preload, double* wall_ms,
+                    long* rss_kb) {
+  double start = now_ms();
+  pid_t pid = fork();
+  if (pid == 0) {
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+    if (input != NULL) {
+      int in_fd = open(input, O_RDONLY);
+      if (in_fd < 0) {
+        perror(input);
+        exit(127);
+      }
+      dup2(in_fd, STDIN_FILENO);
+      close(in_fd);
+    }
+    if (preload != NULL)
+      setenv("LD_PRELOAD", preload, 1);
+    else
+      unsetenv("LD_PRELOAD");
+    execvp(argv[0], argv);
+    perror(argv[0]);
+    exit(127);
+  } else if (pid < 0) {
+    perror("fork");
+    return -1;
+  }
+
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0) {
+    perror("wait4");
+    return -1;
+  }
+  *wall_ms = now_ms() - start;
+  *rss_kb = usage.ru_maxrss;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+static run_result_t run_many(char** argv, const char* input, const char* preload, int reps) {
+  run_result_t result = {0, 0, 0};
+  for (int i = 0; i < reps; i++) {
+    double wall_ms;
+    long rss_kb;
+    if (run_once(argv, input, preload, &wall_ms, &rss_kb) < 0)
+      result.failed = 1;
+    result.wall_ms += wall_ms / reps;
+    if (rss_kb > result.max_rss_kb)
+      result.max_rss_kb = rss_kb;
+  }
+  return result;
+}
+
+static void print_result(const char* name, run_result_t* result) {
+  printf("  %-6s %10.2f ms %10ld KB%s\n", name, result->wall_ms, result->max_rss_kb,
+         result->failed ? "  (command failed)" : "");
+}
+
+int main(int argc, char* argv[]) {
+  int reps = 3;
+  const char* input = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "+n:i:h")) != -1) {
+    switch (opt) {
+      case 'n':
+        reps = atoi(optarg);
+        break;
+      case 'i':
+        input = optarg;
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-n reps] [-i input] -- command [args...]\n", argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind >= argc || reps <= 0) {
+    fprintf(stderr, "usage: %s [-n reps] [-i input] -- command [args...]\n", argv[0]);
+    return 1;
+  }
+
+  /* Resolved to an absolute path so the command may change directory. */
+  char preload[PATH_MAX];
+  if (realpath("mm_preload.so", preload) == NULL) {
+    perror("mm_preload.so");
+    return 1;
+  }
+
+  printf("%s", argv[optind]);
+  for (int i = optind + 1; i < argc; i++)
+    printf(" %s", argv[i]);
+  printf("\n");
+
+  run_result_t glibc = run_many(argv + optind, input, NULL, reps);
+  run_result_t mm = run_many(argv + optind, input, preload, reps);
+  print_result("glibc", &glibc);
+  print_result("mm", &mm);
+  return glibc.failed || mm.failed;
+}
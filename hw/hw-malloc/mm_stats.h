@@ -0,0 +1,36 @@
+/*
+ * mm_stats.h
+ *
+ * Types for the heap introspection API in mm_alloc.h.
+ */
+
+#pragma once
+
+#ifndef _mm_stats_H_
+#define _mm_stats_H_
+
+#include <stddef.h>
+
+/* Payload sizes are grouped in power-of-two classes: class k holds sizes up to 16 << k. */
+#define MM_SIZE_CLASSES 16
+
+/*
+ * Heap statistics. Sizes count payload bytes, not block headers. All counters
+ * are maintained as the heap changes, so reading them is constant time
+ * (largest_free is recomputed only after the largest free block is used).
+ */
+typedef struct mm_stats {
+  size_t heap_size;                        /* Bytes obtained with sbrk */
+  size_t bytes_in_use;                     /* Payload bytes in allocated blocks */
+  size_t bytes_free;                       /* Payload bytes in free blocks */
+  size_t free_blocks;                      /* Number of free blocks */
+  size_t largest_free;                     /* Largest free block payload */
+  size_t free_by_class[MM_SIZE_CLASSES];   /* Free blocks per size class */
+  size_t allocs_by_class[MM_SIZE_CLASSES]; /* mm_malloc calls per size class, ever */
+  size_t frees;                            /* mm_free calls, ever */
+} mm_stats_t;
+
+/* Called by mm_heap_walk() for every block. */
+typedef void mm_walk_fn(void* ptr, size_t size, int free, void* aux);
+
+#endif
@@ -7,10 +7,17 @@
 #include <unistd.h>
 #include <stdint.h>
 
+#include "mm_stats.h"
+
 /* Function pointers to hw3 functions */
 void* (*mm_malloc)(size_t);
 void* (*mm_realloc)(void*, size_t);
 void (*mm_free)(void*);
+size_t (*mm_usable_size)(void*);
+void* (*mm_calloc)(size_t, size_t);
+void* (*mm_memalign)(size_t, size_t);
+void (*mm_stats)(mm_stats_t*);
+void (*mm_heap_walk)(mm_walk_fn*, void*);
 
 static void* try_dlsym(void* handle, const char* symbol) {
   char* error;
@@ -22,8 +29,8 @@ static void* try_dlsym(void* handle, const char* symbol) {
   return function;
 }
 
-static void load_alloc_functions() {
-  void* handle = dlopen("hw3lib.so", RTLD_NOW);
+static void load_alloc_functions(const char* library) {
+  void* handle = dlopen(library, RTLD_NOW);
   if (!handle) {
     fprintf(stderr, "%s\n", dlerror());
     exit(EXIT_FAILURE);
@@ -32,6 +39,11 @@ static void load_alloc_functions() {
   mm_malloc = try_dlsym(handle, "mm_malloc");
   mm_realloc = try_dlsym(handle, "mm_realloc");
   mm_free = try_dlsym(handle, "mm_free");
+  mm_usable_size = try_dlsym(handle, "mm_usable_size");
+  mm_calloc = try_dlsym(handle, "mm_calloc");
+  mm_memalign = try_dlsym(handle, "mm_memalign");
+  mm_stats = try_dlsym(handle, "mm_stats");
+  mm_heap_walk = try_dlsym(handle, "mm_heap_walk");
 }
 
 /* Helper function to fill memory with pattern */
@@ -49,6 +61,34 @@ static int verify_pattern(void* ptr, size_t size, char pattern) {
   return 1;
 }
 
+/* Test 0: Freeing the last block keeps the heap list intact. Runs first, on an
+ * untouched heap, so the blocks it frees are really the end of the list. */
+static void test_free_tail() {
+  printf("Test 0: Free tail block... ");
+
+  void* p1 = mm_malloc(100000);
+  void* p2 = mm_malloc(100000);
+  assert(p1 != NULL && p2 != NULL);
+
+  // Free the tail after its neighbour so it coalesces backwards
+  mm_free(p1);
+  mm_free(p2);
+
+  // Reuse the coalesced block so its data covers where p2's header used to be
+  void* p3 = mm_malloc(100024);
+  assert(p3 != NULL);
+  fill_pattern(p3, 100024, 0x3);
+
+  // Growing the heap must link onto the live list, not the stale tail
+  void* p4 = mm_malloc(200000);
+  assert(p4 != NULL);
+  assert(verify_pattern(p3, 100024, 0x3));
+  mm_free(p4);
+  mm_free(p3);
+
+  printf("OK\n");
+}
+
 /* Test 1: Basic malloc and free */
 static void test_basic_malloc_free() {
   printf("Test 1: Basic malloc and free... ");
@@ -228,17 +268,252 @@ static void test_free_order() {
   printf("OK\n");
 }
 
-int main() {
-  load_alloc_functions();
+/* Test 7: Payloads are aligned like malloc(3) and report their usable size */
+static void test_alignment() {
+  printf("Test 7: Alignment and usable size... ");
+
+  void* ptrs[32];
+  for (int i = 0; i < 32; i++) {
+    ptrs[i] = mm_malloc(i * 7 + 1);
+    assert(ptrs[i] != NULL);
+    assert((uintptr_t)ptrs[i] % 16 == 0);
+    assert(mm_usable_size(ptrs[i]) >= (size_t)(i * 7 + 1));
+  }
+  for (int i = 0; i < 32; i += 2) {
+    mm_free(ptrs[i]);
+  }
+  for (int i = 0; i < 32; i += 2) {
+    ptrs[i] = mm_malloc(3);
+    assert((uintptr_t)ptrs[i] % 16 == 0);
+  }
+  for (int i = 0; i < 32; i++) {
+    mm_free(ptrs[i]);
+  }
+
+  printf("OK\n");
+}
+
+/* Totals gathered by walking the heap, to check the incremental counters */
+typedef struct walk_totals {
+  size_t in_use;
+  size_t free;
+  size_t free_blocks;
+  size_t largest_free;
+} walk_totals_t;
+
+static void sum_block(void* ptr, size_t size, int free, void* aux) {
+  walk_totals_t* totals = aux;
+  assert(ptr != NULL);
+  if (free) {
+    totals->free += size;
+    totals->free_blocks++;
+    if (size > totals->largest_free)
+      totals->largest_free = size;
+  } else {
+    totals->in_use += size;
+  }
+}
+
+static void check_stats_match_walk() {
+  mm_stats_t stats;
+  walk_totals_t totals = {0, 0, 0, 0};
+  mm_stats(&stats);
+  mm_heap_walk(sum_block, &totals);
+  assert(stats.bytes_in_use == totals.in_use);
+  assert(stats.bytes_free == totals.free);
+  assert(stats.free_blocks == totals.free_blocks);
+  assert(stats.largest_free == totals.largest_free);
+
+  size_t by_class = 0;
+  for (int k = 0; k < MM_SIZE_CLASSES; k++)
+    by_class += stats.free_by_class[k];
+  assert(by_class == stats.free_blocks);
+  assert(stats.bytes_in_use + stats.bytes_free <= stats.heap_size);
+}
+
+/* The blocks on either side of target, found by walking the heap */
+typedef struct walk_neighbours {
+  void* target;
+  int seen;
+  size_t before_size;
+  int before_free;
+  size_t after_size;
+  int after_free;
+} walk_neighbours_t;
+
+static void find_neighbours(void* ptr, size_t size, int free, void* aux) {
+  walk_neighbours_t* n = aux;
+  if (n->seen == 2)
+    return;
+  if (n->seen == 1) {
+    n->after_size = size;
+    n->after_free = free;
+    n->seen = 2;
+  } else if (ptr == n->target) {
+    n->seen = 1;
+  } else {
+    n->before_size = size;
+    n->before_free = free;
+  }
+}
+
+/* Test 8: Heap statistics agree with a walk of the heap */
+static void test_stats() {
+  printf("Test 8: Heap statistics... ");
+
+  mm_stats_t before;
+  mm_stats(&before);
+  check_stats_match_walk();
+
+  void* ptrs[64];
+  for (int i = 0; i < 64; i++) {
+    ptrs[i] = mm_malloc(i * 24 + 8);
+    assert(ptrs[i] != NULL);
+  }
+  check_stats_match_walk();
+
+  // Free every third block, then neighbours, so blocks split and coalesce
+  for (int i = 0; i < 64; i += 3) {
+    mm_free(ptrs[i]);
+  }
+  check_stats_match_walk();
+  for (int i = 1; i < 64; i += 3) {
+    mm_free(ptrs[i]);
+  }
+  check_stats_match_walk();
+  for (int i = 0; i < 64; i += 3) {
+    ptrs[i] = mm_malloc(40);
+  }
+  check_stats_match_walk();
+
+  mm_stats_t after;
+  mm_stats(&after);
+  size_t allocs = 0;
+  for (int k = 0; k < MM_SIZE_CLASSES; k++)
+    allocs += after.allocs_by_class[k] - before.allocs_by_class[k];
+  assert(allocs == 64 + 22);
+  assert(after.frees - before.frees == 22 + 21);
+
+  for (int i = 0; i < 64; i++) {
+    if (i % 3 != 1)
+      mm_free(ptrs[i]);
+  }
+  check_stats_match_walk();
+
+  printf("OK\n");
+}
+
+/* Test 9: calloc zeroes reused memory and rejects overflowing sizes */
+static void test_calloc() {
+  printf("Test 9: Calloc... ");
+
+  void* dirty = mm_malloc(512);
+  assert(dirty != NULL);
+  fill_pattern(dirty, 512, 0x5a);
+  mm_free(dirty);
+
+  // Reuses the dirty block, so it has to be cleared
+  char* p1 = mm_calloc(32, 16);
+  assert(p1 != NULL);
+  assert(verify_pattern(p1, 512, 0));
+
+  // Comes fresh from sbrk, so it is already zero
+  char* p2 = mm_calloc(1, 1 << 20);
+  assert(p2 != NULL);
+  assert(verify_pattern(p2, 1 << 20, 0));
+
+  assert(mm_calloc((size_t)-1, 16) == NULL);
+
+  mm_free(p1);
+  mm_free(p2);
+  check_stats_match_walk();
+
+  printf("OK\n");
+}
+
+/* Test 10: memalign returns aligned ordinary blocks */
+static void test_memalign() {
+  printf("Test 10: Memalign... ");
+
+  void* ptrs[24];
+  for (int i = 0; i < 24; i++) {
+    size_t alignment = (size_t)32 << (i % 8);
+    ptrs[i] = mm_memalign(alignment, 100 + i);
+    assert(ptrs[i] != NULL);
+    assert((uintptr_t)ptrs[i] % alignment == 0);
+    fill_pattern(ptrs[i], 100 + i, (char)i);
+  }
+  check_stats_match_walk();
+  for (int i = 0; i < 24; i++) {
+    assert(verify_pattern(ptrs[i], 100 + i, (char)i));
+  }
+
+  // The gap in front of an aligned block is kept as a free block, not wasted
+  mm_stats_t before, after;
+  mm_stats(&before);
+  void* page = mm_memalign(4096, 64);
+  mm_stats(&after);
+  assert(page != NULL && (uintptr_t)page % 4096 == 0);
+  assert(after.bytes_in_use - before.bytes_in_use == 64);
+
+  // Aligned blocks are ordinary blocks to free and realloc
+  ptrs[0] = mm_realloc(ptrs[0], 1000);
+  assert(ptrs[0] != NULL);
+  for (int i = 0; i < 24; i++) {
+    mm_free(ptrs[i]);
+  }
+  mm_free(page);
+  check_stats_match_walk();
+
+  // A freed aligned block of exactly the request is reused instead of growing the
+  // heap. Free blocks around it are filled so that freeing it does not coalesce
+  void* aligned = mm_memalign(256, 512);
+  assert(aligned != NULL);
+  void* fillers[64];
+  int filled = 0;
+  for (;;) {
+    walk_neighbours_t n = {aligned, 0, 0, 0, 0, 0};
+    mm_heap_walk(find_neighbours, &n);
+    if (!n.before_free && !n.after_free)
+      break;
+    assert(filled < 64);
+    fillers[filled] = mm_malloc(n.before_free ? n.before_size : n.after_size);
+    assert(fillers[filled] != NULL);
+    filled++;
+  }
+  mm_free(aligned);
+  mm_stats(&before);
+  void* again = mm_memalign(256, 512);
+  mm_stats(&after);
+  assert(again == aligned);
+  assert(after.heap_size == before.heap_size);
+  mm_free(again);
+  for (int i = 0; i < filled; i++)
+    mm_free(fillers[i]);
+  check_stats_match_walk();
+
+  assert(mm_memalign(48, 16) == NULL);
+
+  printf("OK\n");
+}
+
+/* Tests hw3lib.so, or the build of mm_alloc named on the command line. */
+int main(int argc, char* argv[]) {
+  load_alloc_functions(argc > 1 ? argv[1] : "hw3lib.so");
 
   printf("Starting memory allocator tests...\n\n");
 
+  test_free_tail();
   test_basic_malloc_free();
   test_multiple_allocations();
   test_realloc();
   test_edge_cases();
   test_coalescing();
   test_free_order();
+  test_alignment();
+  test_stats();
+  test_calloc();
+  test_memalign();
 
 
 
@@ -0,0 +1,238 @@
+/*
+ * mm_trace.c
+ *
+ * Preloadable recorder that writes every malloc/calloc/realloc/free made by
+ * a program in the trace format mm_bench replays:
+ *
+ *   MM_TRACE_FILE=traces/foo.trace LD_PRELOAD=./mm_trace.so ./foo
+ *
+ * Blocks are renamed to small integer ids as they are allocated. Only the
+ * process that was started is traced: MM_TRACE_FILE is removed from the
+ * environment at startup, and children created by fork() stop recording.
+ */
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Live blocks tracked at once; must be a power of two. */
+#define TABLE_SIZE (1 << 20)
+
+/* dlsym() may allocate before the real allocator is known. */
+#define BOOTSTRAP_SIZE 4096
+
+typedef struct slot {
+  void* ptr;
+  int id;
+} slot_t;
+
+static void* (*real_malloc)(size_t);
+static void* (*real_calloc)(size_t, size_t);
+static void* (*real_realloc)(void*, size_t);
+static void (*real_free)(void*);
+
+static char bootstrap[BOOTSTRAP_SIZE];
+static size_t bootstrap_used;
+static int resolving;
+
+static slot_t table[TABLE_SIZE];
+static int next_id;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int trace_fd = -1;
+static char out_buf[1 << 16];
+static size_t out_len;
+
+static void resolve(void) {
+  resolving = 1;
+  real_malloc = dlsym(RTLD_NEXT, "malloc");
+  real_calloc = dlsym(RTLD_NEXT, "calloc");
+  real_realloc = dlsym(RTLD_NEXT, "realloc");
+  real_free = dlsym(RTLD_NEXT, "free");
+  resolving = 0;
+}
+
+static void* bootstrap_alloc(size_t size) {
+  size = (size + 15) & ~(size_t)15;
+  if (bootstrap_used + size > BOOTSTRAP_SIZE)
+    return NULL;
+  void* ptr = bootstrap + bootstrap_used;
+  bootstrap_used += size;
+  return ptr;
+}
+
+static int is_bootstrap(void* ptr) {
+  return (char*)ptr >= bootstrap && (char*)ptr < bootstrap + BOOTSTRAP_SIZE;
+}
+
+static void flush_trace(void) {
+  if (trace_fd >= 0 && out_len > 0 && write(trace_fd, out_buf, out_len) < 0)
+    trace_fd = -1;
+  out_len = 0;
+}
+
+/* Appends one trace line. Must be called with trace_lock held. */
+static void emit(char kind, int id, size_t size) {
+  if (trace_fd < 0)
+    return;
+  if (out_len + 64 > sizeof(out_buf))
+    flush_trace();
+  if (kind == 'f')
+    out_len += snprintf(out_buf + out_len, 64, "f %d\n", id);
+  else
+    out_len += snprintf(out_buf + out_len, 64, "%c %d %zu\n", kind, id, size);
+}
+
+static size_t hash_ptr(void* ptr) { return ((uintptr_t)ptr >> 4) * 2654435761u & (TABLE_SIZE - 1); }
+
+static int table_insert(void* ptr) {
+  size_t i = hash_ptr(ptr);
+  while (table[i].ptr != NULL)
+    i = (i + 1) & (TABLE_SIZE - 1);
+  table[i].ptr = ptr;
+  table[i].id = next_id++;
+  return table[i].id;
+}
+
+/* Removes ptr from the table and returns its id, or -1 if it is unknown. */
+static int table_remove(void* ptr) {
+  size_t i = hash_ptr(ptr);
+  while (table[i].ptr != ptr) {
+    if (table[i].ptr == NULL)
+      return -1;
+    i = (i + 1) & (TABLE_SIZE - 1);
+  }
+  int id = table[i].id;
+  table[i].ptr = NULL;
+
+  /* Backward-shift deletion keeps linear probing free of tombstones. */
+  size_t hole = i;
+  for (size_t j = (i + 1) & (TABLE_SIZE - 1); table[j].ptr != NULL; j = (j + 1) & (TABLE_SIZE - 1)) {
+    size_t home = hash_ptr(table[j].ptr);
+    if (((j - home) & (TABLE_SIZE - 1)) >= ((j - hole) & (TABLE_SIZE - 1))) {
+      table[hole] = table[j];
+      table[j].ptr = NULL;
+      hole = j;
+    }
+  }
+  return id;
+}
+
+static void record_alloc(void* ptr, size_t size) {
+  if (ptr == NULL)
+    return;
+  pthread_mutex_lock(&trace_lock);
+  emit('a', table_insert(ptr), size);
+  pthread_mutex_unlock(&trace_lock);
+}
+
+static void prepare_fork(void) {
+  pthread_mutex_lock(&trace_lock);
+  flush_trace();
+}
+
+static void parent_fork(void) { pthread_mutex_unlock(&trace_lock); }
+
+static void child_fork(void) {
+  trace_fd = -1;
+  out_len = 0;
+  pthread_mutex_unlock(&trace_lock);
+}
+
+__attribute__((constructor)) static void trace_init(void) {
+  if (real_malloc == NULL)
+    resolve();
+  const char* path = getenv("MM_TRACE_FILE");
+  if (path == NULL)
+    return;
+  trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  unsetenv("MM_TRACE_FILE");
+  pthread_atfork(prepare_fork, parent_fork, child_fork);
+}
+
+__attribute__((destructor)) static void trace_fini(void) {
+  pthread_mutex_lock(&trace_lock);
+  flush_trace();
+  if (trace_fd >= 0)
+    close(trace_fd);
+  trace_fd = -1;
+  pthread_mutex_unlock(&trace_lock);
+}
+
+void* malloc(size_t size) {
+  if (real_malloc == NULL) {
+    if (resolving)
+      return bootstrap_alloc(size);
+    resolve();
+  }
+  void* ptr = real_malloc(size);
+  record_alloc(ptr, size);
+  return ptr;
+}
+
+void* calloc(size_t nmemb, size_t size) {
+  if (real_calloc == NULL) {
+    if (resolving)
+      return bootstrap_alloc(nmemb * size); // Static storage is already zeroed
+    resolve();
+  }
+  void* ptr = real_calloc(nmemb, size);
+  record_alloc(ptr, nmemb * size);
+  return ptr;
+}
+
+void* realloc(void* ptr, size_t size) {
+  if (real_realloc == NULL)
+    resolve();
+  if (ptr == NULL)
+    return malloc(size);
+  if (is_bootstrap(ptr)) {
+    void* new_ptr = malloc(size);
+    size_t avail = bootstrap + BOOTSTRAP_SIZE - (char*)ptr;
+    if (new_ptr != NULL)
+      memcpy(new_ptr, ptr, size < avail ? size : avail);
+    return new_ptr;
+  }
+
+  void* new_ptr = real_realloc(ptr, size);
+  if (new_ptr == NULL && size > 0)
+    return NULL;
+  pthread_mutex_lock(&trace_lock);
+  int id = table_remove(ptr);
+  if (new_ptr == NULL) {
+    if (id >= 0)
+      emit('f', id, 0);
+  } else if (id >= 0) {
+    /* Keep the block's id across a move so the trace stays a realloc. */
+    size_t i = hash_ptr(new_ptr);
+    while (table[i].ptr != NULL)
+      i = (i + 1) & (TABLE_SIZE - 1);
+    table[i].ptr = new_ptr;
+    table[i].id = id;
+    emit('r', id, size);
+  } else {
+    emit('a', table_insert(new_ptr), size);
+  }
+  pthread_mutex_unlock(&trace_lock);
+  return new_ptr;
+}
+
+void free(void* ptr) {
+  if (ptr == NULL || is_bootstrap(ptr))
+    return;
+  if (real_free == NULL)
+    resolve();
+  pthread_mutex_lock(&trace_lock);
+  int id = table_remove(ptr);
+  if (id >= 0)
+    emit('f', id, 0);
+  pthread_mutex_unlock(&trace_lock);
+  real_free(ptr);
+}
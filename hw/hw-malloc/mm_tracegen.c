@@ -0,0 +1,181 @@
+/*
+ * mm_tracegen.c
+ *
+ * Writes synthetic allocation traces for mm_bench to stdout. Each pattern
+ * stresses a different part of an allocator's placement policy.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct gen_opts {
+  int n;           // Approximate number of operations to emit
+  size_t max_size; // Largest request size
+  unsigned seed;
+} gen_opts_t;
+
+static size_t rand_size(size_t lo, size_t hi) { return lo + (size_t)rand() % (hi - lo + 1); }
+
+/* Random mix of allocations and frees with uniformly distributed sizes. */
+static void gen_random(gen_opts_t* opts) {
+  int live_cap = opts->n / 4 + 1;
+  int* live = malloc(live_cap * sizeof(int));
+  int n_live = 0, next_id = 0;
+  for (int i = 0; i < opts->n; i++) {
+    if (n_live > 0 && (n_live == live_cap || rand() % 100 < 45)) {
+      int victim = rand() % n_live;
+      printf("f %d\n", live[victim]);
+      live[victim] = live[--n_live];
+    } else {
+      printf("a %d %zu\n", next_id, rand_size(1, opts->max_size));
+      live[n_live++] = next_id++;
+    }
+  }
+  while (n_live > 0)
+    printf("f %d\n", live[--n_live]);
+  free(live);
+}
+
+/*
+ * Interleaves small and large blocks, frees every small one, then asks for
+ * blocks slightly larger than a small hole. First fit cannot reuse any of
+ * the holes, so utilization collapses.
+ */
+static void gen_binary(gen_opts_t* opts) {
+  int pairs = opts->n / 5;
+  size_t small = 16, large = opts->max_size > 64 ? opts->max_size : 64;
+  for (int i = 0; i < pairs; i++) {
+    printf("a %d %zu\n", 2 * i, small);
+    printf("a %d %zu\n", 2 * i + 1, large);
+  }
+  for (int i = 0; i < pairs; i++)
+    printf("f %d\n", 2 * i);
+  for (int i = 0; i < pairs; i++)
+    printf("a %d %zu\n", 2 * pairs + i, small * 2);
+  for (int i = 0; i < 3 * pairs; i++) {
+    if (i < 2 * pairs && i % 2 == 0)
+      continue;
+    printf("f %d\n", i);
+  }
+}
+
+/* Grows a handful of buffers by small increments, like a vector push loop. */
+static void gen_realloc(gen_opts_t* opts) {
+  int buffers = 8;
+  size_t* sizes = calloc(buffers, sizeof(size_t));
+  for (int b = 0; b < buffers; b++) {
+    sizes[b] = 16;
+    printf("a %d %zu\n", b, sizes[b]);
+  }
+  for (int i = 0; i < opts->n - 2 * buffers; i++) {
+    int b = rand() % buffers;
+    sizes[b] += rand_size(1, 64);
+    if (sizes[b] > opts->max_size * 64)
+      sizes[b] = 16;
+    printf("r %d %zu\n", b, sizes[b]);
+  }
+  for (int b = 0; b < buffers; b++)
+    printf("f %d\n", b);
+  free(sizes);
+}
+
+/* Allocates a batch and frees it in reverse order, repeatedly. */
+static void gen_stack(gen_opts_t* opts) {
+  int batch = 64, next_id = 0;
+  for (int done = 0; done < opts->n; done += 2 * batch) {
+    int first = next_id;
+    for (int i = 0; i < batch; i++)
+      printf("a %d %zu\n", next_id++, rand_size(1, opts->max_size));
+    for (int i = next_id - 1; i >= first; i--)
+      printf("f %d\n", i);
+  }
+}
+
+/*
+ * Long-lived objects of many different sizes with short-lived churn between
+ * them. Placement policy decides whether the churn fills the holes the
+ * long-lived objects leave behind.
+ */
+static void gen_longlived(gen_opts_t* opts) {
+  int n_long = opts->n / 8 + 1;
+  int next_id = 0;
+  int* long_ids = malloc(n_long * sizeof(int));
+  for (int i = 0; i < n_long; i++) {
+    long_ids[i] = next_id;
+    printf("a %d %zu\n", next_id++, rand_size(1, opts->max_size * 4));
+    int temp = next_id++;
+    printf("a %d %zu\n", temp, rand_size(1, opts->max_size));
+    if (rand() % 2) {
+      printf("f %d\n", temp);
+    } else {
+      printf("f %d\n", long_ids[i]);
+      long_ids[i] = temp;
+    }
+  }
+  for (int done = 3 * n_long; done < opts->n; done += 2) {
+    int temp = next_id++;
+    printf("a %d %zu\n", temp, rand_size(1, opts->max_size * 2));
+    printf("f %d\n", temp);
+  }
+  for (int i = 0; i < n_long; i++)
+    printf("f %d\n", long_ids[i]);
+  free(long_ids);
+}
+
+typedef struct pattern {
+  const char* name;
+  void (*gen)(gen_opts_t* opts);
+  const char* doc;
+} pattern_t;
+
+static pattern_t patterns[] = {
+    {"random", gen_random, "uniform random malloc/free mix"},
+    {"binary", gen_binary, "small/large interleave that defeats first fit"},
+    {"realloc", gen_realloc, "buffers grown by repeated realloc"},
+    {"stack", gen_stack, "batches freed in LIFO order"},
+    {"longlived", gen_longlived, "long-lived objects of mixed size with churn"},
+};
+
+static void usage(const char* prog) {
+  fprintf(stderr, "usage: %s [-n ops] [-m max_size] [-s seed] pattern\n", prog);
+  for (unsigned int i = 0; i < sizeof(patterns) / sizeof(pattern_t); i++)
+    fprintf(stderr, "  %-10s %s\n", patterns[i].name, patterns[i].doc);
+}
+
+int main(int argc, char* argv[]) {
+  gen_opts_t opts = {.n = 10000, .max_size = 256, .seed = 162};
+  int opt;
+  while ((opt = getopt(argc, argv, "n:m:s:h")) != -1) {
+    switch (opt) {
+      case 'n':
+        opts.n = atoi(optarg);
+        break;
+      case 'm':
+        opts.max_size = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        opts.seed = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1 || opts.n <= 0 || opts.max_size == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  for (unsigned int i = 0; i < sizeof(patterns) / sizeof(pattern_t); i++) {
+    if (strcmp(patterns[i].name, argv[optind]) == 0) {
+      srand(opts.seed);
+      printf("# %s -n %d -m %zu -s %u\n", patterns[i].name, opts.n, opts.max_size, opts.seed);
+      patterns[i].gen(&opts);
+      return 0;
+    }
+  }
+  usage(argv[0]);
+  return 1;
+}
@@ -0,0 +1,24 @@
+/*
+ * Preloadable heap ballast for bench.sh: gives the shell a large, fully
+ * touched heap, as a long interactive session would have, so the cost of
+ * copying its page tables on fork() shows up.
+ *
+ *   BALLAST_MB=512 LD_PRELOAD=./ballast.so ./shell
+ *
+ * LD_PRELOAD is removed again at startup so the commands the shell runs
+ * do not carry the ballast themselves.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+__attribute__((constructor)) static void ballast_init(void) {
+  const char* mb = getenv("BALLAST_MB");
+  unsetenv("LD_PRELOAD");
+  if (mb == NULL)
+    return;
+  size_t size = strtoul(mb, NULL, 10) << 20;
+  char* ballast = malloc(size);
+  if (ballast != NULL)
+    memset(ballast, 1, size);
+}
@@ -0,0 +1,72 @@
+#!/bin/bash
+
+# Launch benchmark: commands per second in non-interactive mode
+# Feeds the shell a script of short commands, starting them with fork (-f),
+# with posix_spawn (the default) and through the launch helper (-z), while
+# ballast.so gives the shell heaps of growing size. fork() copies the shell's
+# page tables for every command, so its rate falls as the heap grows;
+# posix_spawn borrows the shell's memory until exec, and the helper forks
+# from its own small image, so both should stay flat.
+#
+# Usage: ./bench.sh [commands] ["heap sizes in MB"]
+
+COMMANDS=${1:-2000}
+HEAPS=${2:-"0 64 512 1024"}
+
+SCRIPT=$(mktemp)
+
+# Cleanup function
+cleanup() {
+    rm -f "$SCRIPT"
+}
+
+# Register cleanup function
+trap cleanup EXIT
+
+for file in shell ballast.so; do
+    if [ ! -f "./$file" ]; then
+        echo "Error: ./$file does not exist, run make first"
+        exit 1
+    fi
+done
+
+# Alternate a PATH lookup, a full path and a two-stage pipeline
+for ((i = 0; i < COMMANDS / 4; i++)); do
+    echo "true"
+    echo "/bin/true"
+    echo "true | true"
+done > "$SCRIPT"
+
+# Prints the nanoseconds one run of the shell takes on input $1 with a heap of $2 MB
+run_ns() {
+    local input=$1
+    local heap=$2
+    shift 2
+    local start end
+    start=$(date +%s%N)
+    BALLAST_MB=$heap LD_PRELOAD=./ballast.so ./shell "$@" < "$input" > /dev/null
+    end=$(date +%s%N)
+    echo $((end - start))
+}
+
+# Prints commands per second with a heap of $1 MB and shell options $2...
+# The time to start the shell and fill its heap is measured on empty input and subtracted.
+rate() {
+    local heap=$1
+    shift
+    local empty full
+    empty=$(run_ns /dev/null "$heap" "$@")
+    full=$(run_ns "$SCRIPT" "$heap" "$@")
+    awk -v n="$COMMANDS" -v ns="$((full - empty))" 'BEGIN { printf "%.0f", (ns > 0 ? n / (ns / 1e9) : 0) }'
+}
+
+echo "Launch benchmark: $COMMANDS commands per run ($(nproc) cores)"
+echo "=============================================================="
+printf "%-10s %14s %14s %14s\n" "heap (MB)" "fork (cmd/s)" "spawn (cmd/s)" "helper (cmd/s)"
+for heap in $HEAPS; do
+    fork_rate=$(rate "$heap" -f)
+    spawn_rate=$(rate "$heap")
+    zygote_rate=$(rate "$heap" -z)
+    printf "%-10s %14s %14s %14s\n" "$heap" "$fork_rate" "$spawn_rate" "$zygote_rate"
+done
+echo "=============================================================="
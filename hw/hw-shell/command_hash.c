@@ -0,0 +1,225 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "command_hash.h"
+
+#define INITIAL_CAPACITY 64
+
+typedef struct entry {
+  char* name; // NULL if the slot is empty
+  char* path;
+  unsigned int hits;
+} entry_t;
+
+/* Open addressing with linear probing; capacity is a power of two. */
+static entry_t* table;
+static size_t capacity;
+static size_t count;
+
+/* $PATH as it was when the table was filled; any change empties the table. */
+static char* saved_path;
+
+/* Pipe that children report missing commands through, or -1 outside a launch. */
+static int report_fds[2] = {-1, -1};
+
+/* 32-bit FNV-1a. */
+static uint32_t hash_name(const char* name) {
+  uint32_t hash = 2166136261u;
+  for (; *name; name++)
+    hash = (hash ^ (unsigned char)*name) * 16777619u;
+  return hash;
+}
+
+static entry_t* find_slot(entry_t* slots, size_t size, const char* name) {
+  size_t i = hash_name(name) & (size - 1);
+  while (slots[i].name != NULL && strcmp(slots[i].name, name) != 0)
+    i = (i + 1) & (size - 1);
+  return &slots[i];
+}
+
+static void grow(void) {
+  size_t new_capacity = capacity ? capacity * 2 : INITIAL_CAPACITY;
+  entry_t* slots = calloc(new_capacity, sizeof(entry_t));
+  if (slots == NULL)
+    return;
+  for (size_t i = 0; i < capacity; i++)
+    if (table[i].name != NULL)
+      *find_slot(slots, new_capacity, table[i].name) = table[i];
+  free(table);
+  table = slots;
+  capacity = new_capacity;
+}
+
+/* Empties the table if $PATH is not what it was when the table was filled. */
+static void check_path(void) {
+  const char* path = getenv("PATH");
+  if (path == NULL)
+    path = "";
+  if (saved_path != NULL && strcmp(saved_path, path) == 0)
+    return;
+  hash_clear();
+  free(saved_path);
+  saved_path = strdup(path);
+}
+
+int path_search(const char* name, char* path, size_t size) {
+  const char* dirs = getenv("PATH");
+  if (dirs == NULL)
+    return -1;
+  while (*dirs) {
+    size_t len = strcspn(dirs, ":");
+    /* An empty entry means the current directory. */
+    if (len == 0)
+      snprintf(path, size, "./%s", name);
+    else
+      snprintf(path, size, "%.*s/%s", (int)len, dirs, name);
+    if (access(path, X_OK) == 0)
+      return 0;
+    dirs += len;
+    if (*dirs == ':')
+      dirs++;
+  }
+  return -1;
+}
+
+const char* hash_lookup(const char* name) {
+  check_path();
+  if (capacity > 0) {
+    entry_t* entry = find_slot(table, capacity, name);
+    if (entry->name != NULL) {
+      entry->hits++;
+      return entry->path;
+    }
+  }
+
+  static char found[4096];
+  if (path_search(name, found, sizeof(found)) < 0)
+    return NULL;
+  /* A path through a relative $PATH entry depends on the working directory. */
+  if (found[0] != '/')
+    return found;
+  if ((count + 1) * 4 > capacity * 3)
+    grow();
+  if ((count + 1) * 4 > capacity * 3)
+    return found;
+  entry_t* entry = find_slot(table, capacity, name);
+  entry->name = strdup(name);
+  entry->path = strdup(found);
+  entry->hits = 1;
+  count++;
+  return entry->path;
+}
+
+const char* hash_find(const char* name) {
+  if (capacity == 0)
+    return NULL;
+  entry_t* entry = find_slot(table, capacity, name);
+  return entry->name != NULL ? entry->path : NULL;
+}
+
+void hash_forget(const char* name) {
+  if (capacity == 0)
+    return;
+  entry_t* entry = find_slot(table, capacity, name);
+  if (entry->name == NULL)
+    return;
+  free(entry->name);
+  free(entry->path);
+  entry->name = NULL;
+  count--;
+
+  /* Backward-shift deletion keeps linear probing free of tombstones. */
+  size_t hole = entry - table;
+  for (size_t j = (hole + 1) & (capacity - 1); table[j].name != NULL; j = (j + 1) & (capacity - 1)) {
+    size_t home = hash_name(table[j].name) & (capacity - 1);
+    if (((j - home) & (capacity - 1)) >= ((j - hole) & (capacity - 1))) {
+      table[hole] = table[j];
+      table[j].name = NULL;
+      hole = j;
+    }
+  }
+}
+
+void hash_clear(void) {
+  for (size_t i = 0; i < capacity; i++) {
+    if (table[i].name != NULL) {
+      free(table[i].name);
+      free(table[i].path);
+      table[i].name = NULL;
+    }
+  }
+  count = 0;
+}
+
+void hash_print(FILE* out) {
+  if (count == 0) {
+    fprintf(out, "hash: hash table empty\n");
+    return;
+  }
+  fprintf(out, "hits\tcommand\n");
+  for (size_t i = 0; i < capacity; i++)
+    if (table[i].name != NULL)
+      fprintf(out, "%4u\t%s\n", table[i].hits, table[i].path);
+}
+
+void hash_begin_launch(void) {
+  if (pipe2(report_fds, O_CLOEXEC) < 0)
+    report_fds[0] = report_fds[1] = -1;
+}
+
+void hash_report_missing(const char* name) {
+  if (report_fds[1] < 0)
+    return;
+  /* Names shorter than PIPE_BUF arrive whole even when several children report at once. */
+  char line[256];
+  int len = snprintf(line, sizeof(line), "%s\n", name);
+  if (len >= (int)sizeof(line) || write(report_fds[1], line, len) < 0)
+    return;
+}
+
+void hash_end_launch(void) {
+  if (report_fds[0] < 0)
+    return;
+  close(report_fds[1]);
+
+  /* Every child holds the write end until it execs or exits. */
+  char buf[4096];
+  size_t len = 0;
+  ssize_t n;
+  while ((n = read(report_fds[0], buf + len, sizeof(buf) - 1 - len)) != 0) {
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    len += n;
+    buf[len] = '\0';
+    char* line = buf;
+    char* newline;
+    while ((newline = strchr(line, '\n')) != NULL) {
+      *newline = '\0';
+      hash_forget(line);
+      line = newline + 1;
+    }
+    len = buf + len - line;
+    memmove(buf, line, len);
+    if (len == sizeof(buf) - 1)
+      len = 0;
+  }
+  close(report_fds[0]);
+  report_fds[0] = report_fds[1] = -1;
+}
+
+void hash_close_report(void) {
+  if (report_fds[0] >= 0)
+    close(report_fds[0]);
+  if (report_fds[1] >= 0)
+    close(report_fds[1]);
+  report_fds[0] = report_fds[1] = -1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * A table of the commands the shell has looked up in $PATH, like bash's
+ * `hash`. The parent resolves a name once and every later child execs the
+ * remembered path directly instead of probing each directory in $PATH.
+ */
+
+/* Returns the full path of a command name, searching $PATH on a miss and remembering the
+ * result. Counts a hit. Returns NULL if the name is not found. */
+const char* hash_lookup(const char* name);
+
+/* Returns the remembered path of name without searching, or NULL. For children after fork. */
+const char* hash_find(const char* name);
+
+/* Searches $PATH for name without touching the table. Returns 0 and writes the full path to
+ * path on success, -1 if no directory holds an executable of that name. */
+int path_search(const char* name, char* path, size_t size);
+
+/* Forgets one name, or every name. */
+void hash_forget(const char* name);
+void hash_clear(void);
+
+/* Prints the table as `hash` does: hits and path for each remembered command. */
+void hash_print(FILE* out);
+
+/* Children that find a remembered path has gone report its name through a close-on-exec
+ * pipe, so the parent can forget it. Call hash_begin_launch() before forking a job's
+ * processes and hash_end_launch() once they are all forked; it returns when each of them
+ * has exec'd or exited. */
+void hash_begin_launch(void);
+void hash_report_missing(const char* name);
+void hash_end_launch(void);
+
+/* Closes a forked child's copy of the report pipe. A child that runs a built-in instead of
+ * exec'ing must call it, or hash_end_launch() waits until the built-in has finished. */
+void hash_close_report(void);
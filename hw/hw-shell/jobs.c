@@ -0,0 +1,419 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "jobs.h"
+
+#define INITIAL_CAPACITY 64
+
+typedef enum proc_state { PROC_RUNNING, PROC_STOPPED, PROC_DONE } proc_state_t;
+
+/* A process the shell started: which job it belongs to and what it was last seen doing. */
+typedef struct proc_slot {
+  pid_t pid; // 0 if the slot is empty
+  int job_id;
+  int index; // in the job's procs
+  proc_state_t state;
+} proc_slot_t;
+
+/* Jobs by number: jobs[id] for 1 <= id <= max_id; unused numbers are NULL. */
+static job_t** jobs;
+static int jobs_capacity;
+static int max_id;
+static int current_id;
+
+/* Processes by pid: open addressing with linear probing; capacity is a power of two. */
+static proc_slot_t* procs;
+static size_t procs_capacity;
+static size_t n_procs;
+
+static int signal_fds[2] = {-1, -1};
+
+static void sigchld_handler(int sig) {
+  int saved_errno = errno;
+  if (write(signal_fds[1], "", 1) < 0) {
+    // the pipe is full, so a wakeup is already pending
+  }
+  errno = saved_errno;
+}
+
+void jobs_init(void) {
+  if (pipe2(signal_fds, O_CLOEXEC | O_NONBLOCK) < 0) {
+    perror("pipe");
+    exit(1);
+  }
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = sigchld_handler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGCHLD, &action, NULL);
+}
+
+int jobs_signal_fd(void) { return signal_fds[0]; }
+
+static size_t hash_pid(pid_t pid, size_t capacity) {
+  return ((uint32_t)pid * 2654435761u) & (capacity - 1);
+}
+
+static proc_slot_t* find_slot(proc_slot_t* slots, size_t capacity, pid_t pid) {
+  size_t i = hash_pid(pid, capacity);
+  while (slots[i].pid != 0 && slots[i].pid != pid)
+    i = (i + 1) & (capacity - 1);
+  return &slots[i];
+}
+
+static proc_slot_t* lookup_proc(pid_t pid) {
+  if (procs_capacity == 0)
+    return NULL;
+  proc_slot_t* slot = find_slot(procs, procs_capacity, pid);
+  return slot->pid != 0 ? slot : NULL;
+}
+
+static void insert_proc(pid_t pid, int job_id, int index) {
+  if ((n_procs + 1) * 4 > procs_capacity * 3) {
+    size_t capacity = procs_capacity ? procs_capacity * 2 : INITIAL_CAPACITY;
+    proc_slot_t* slots = calloc(capacity, sizeof(proc_slot_t));
+    if (slots == NULL)
+      abort();
+    for (size_t i = 0; i < procs_capacity; i++)
+      if (procs[i].pid != 0)
+        *find_slot(slots, capacity, procs[i].pid) = procs[i];
+    free(procs);
+    procs = slots;
+    procs_capacity = capacity;
+  }
+  proc_slot_t* slot = find_slot(procs, procs_capacity, pid);
+  slot->pid = pid;
+  slot->job_id = job_id;
+  slot->index = index;
+  slot->state = PROC_RUNNING;
+  n_procs++;
+}
+
+static void remove_proc(pid_t pid) {
+  proc_slot_t* slot = lookup_proc(pid);
+  if (slot == NULL)
+    return;
+  slot->pid = 0;
+  n_procs--;
+
+  /* Backward-shift deletion keeps linear probing free of tombstones. */
+  size_t hole = slot - procs;
+  for (size_t j = (hole + 1) & (procs_capacity - 1); procs[j].pid != 0;
+       j = (j + 1) & (procs_capacity - 1)) {
+    size_t home = hash_pid(procs[j].pid, procs_capacity);
+    if (((j - home) & (procs_capacity - 1)) >= ((j - hole) & (procs_capacity - 1))) {
+      procs[hole] = procs[j];
+      procs[j].pid = 0;
+      hole = j;
+    }
+  }
+}
+
+job_t* job_create(const char* command, bool background, bool grouped) {
+  int id = max_id + 1;
+  if (id >= jobs_capacity) {
+    int capacity = jobs_capacity ? jobs_capacity * 2 : 16;
+    job_t** grown = realloc(jobs, capacity * sizeof(job_t*));
+    if (grown == NULL)
+      abort();
+    memset(grown + jobs_capacity, 0, (capacity - jobs_capacity) * sizeof(job_t*));
+    jobs = grown;
+    jobs_capacity = capacity;
+  }
+
+  job_t* job = calloc(1, sizeof(job_t));
+  if (job == NULL)
+    abort();
+  job->id = id;
+  job->background = background;
+  job->grouped = grouped;
+  job->command = strdup(command);
+  tcgetattr(STDIN_FILENO, &job->tmodes);
+  jobs[id] = job;
+  max_id = id;
+  current_id = id;
+  return job;
+}
+
+void job_add_process(job_t* job, pid_t pid, const char* command) {
+  if (job->n_procs == job->procs_capacity) {
+    job->procs_capacity = job->procs_capacity ? job->procs_capacity * 2 : 4;
+    job->procs = realloc(job->procs, job->procs_capacity * sizeof(job_proc_t));
+    if (job->procs == NULL)
+      abort();
+  }
+  if (job->n_procs == 0)
+    job->pgid = pid;
+  job_proc_t* proc = &job->procs[job->n_procs];
+  memset(proc, 0, sizeof(job_proc_t));
+  proc->pid = pid;
+  proc->command = strdup(command);
+  clock_gettime(CLOCK_MONOTONIC, &proc->started);
+  insert_proc(pid, job->id, job->n_procs);
+  job->n_procs++;
+  job->n_live++;
+}
+
+void job_remove(job_t* job) {
+  for (int i = 0; i < job->n_procs; i++) {
+    remove_proc(job->procs[i].pid);
+    free(job->procs[i].command);
+  }
+  jobs[job->id] = NULL;
+  while (max_id > 0 && jobs[max_id] == NULL)
+    max_id--;
+  if (current_id == job->id)
+    current_id = max_id;
+  free(job->procs);
+  free(job->command);
+  free(job->time_file);
+  free(job);
+}
+
+job_t* job_find(int id) { return id >= 1 && id <= max_id ? jobs[id] : NULL; }
+
+job_t* job_find_pid(pid_t pid) {
+  proc_slot_t* slot = lookup_proc(pid);
+  return slot != NULL ? jobs[slot->job_id] : NULL;
+}
+
+job_t* job_parse_spec(const char* spec) {
+  if (spec == NULL || strcmp(spec, "%") == 0 || strcmp(spec, "%%") == 0 ||
+      strcmp(spec, "%+") == 0)
+    return job_find(current_id);
+  char* end;
+  if (spec[0] == '%') {
+    long id = strtol(spec + 1, &end, 10);
+    return end != spec + 1 && *end == '\0' ? job_find(id) : NULL;
+  }
+  long pid = strtol(spec, &end, 10);
+  return end != spec && *end == '\0' ? job_find_pid(pid) : NULL;
+}
+
+bool job_is_done(job_t* job) { return job->n_live == 0; }
+
+bool job_is_stopped(job_t* job) { return job->n_live > 0 && job->n_stopped == job->n_live; }
+
+void job_set_current(job_t* job) { current_id = job->id; }
+
+void job_continue(job_t* job) {
+  // marked running now, so a wait that follows does not mistake the job for still stopped
+  for (int i = 0; i < job->n_procs; i++) {
+    proc_slot_t* slot = lookup_proc(job->procs[i].pid);
+    if (slot != NULL && slot->state == PROC_STOPPED)
+      slot->state = PROC_RUNNING;
+  }
+  job->n_stopped = 0;
+
+  if (job->grouped) {
+    kill(-job->pgid, SIGCONT);
+    return;
+  }
+  // the processes share the shell's process group, so each one is signalled by pid
+  for (int i = 0; i < job->n_procs; i++) {
+    proc_slot_t* slot = lookup_proc(job->procs[i].pid);
+    if (slot != NULL && slot->state != PROC_DONE)
+      kill(job->procs[i].pid, SIGCONT);
+  }
+}
+
+/* Applies one wait status, and the usage wait4() gave with it, to the process it belongs to
+ * and to its job. */
+static void update_proc(pid_t pid, int status, struct rusage* usage) {
+  proc_slot_t* slot = lookup_proc(pid);
+  if (slot == NULL)
+    return;
+  job_t* job = jobs[slot->job_id];
+  proc_state_t state = PROC_DONE;
+  if (WIFSTOPPED(status))
+    state = PROC_STOPPED;
+  else if (WIFCONTINUED(status))
+    state = PROC_RUNNING;
+
+  if (slot->state == PROC_STOPPED)
+    job->n_stopped--;
+  if (state == PROC_STOPPED)
+    job->n_stopped++;
+  if (state == PROC_DONE && slot->state != PROC_DONE) {
+    job_proc_t* proc = &job->procs[slot->index];
+    clock_gettime(CLOCK_MONOTONIC, &proc->ended);
+    proc->status = status;
+    proc->usage = *usage;
+    job->n_live--;
+    if (slot->index == job->n_procs - 1)
+      job->status = status;
+  }
+  slot->state = state;
+}
+
+bool jobs_take_signal(void) {
+  char buf[64];
+  bool signalled = false;
+  while (read(signal_fds[0], buf, sizeof(buf)) > 0)
+    signalled = true;
+  return signalled;
+}
+
+void jobs_reap(void) {
+  jobs_take_signal();
+  int status;
+  struct rusage usage;
+  pid_t pid;
+  while ((pid = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &usage)) > 0)
+    update_proc(pid, status, &usage);
+}
+
+void job_wait(job_t* job) {
+  while (!job_is_done(job) && !job_is_stopped(job)) {
+    int status;
+    struct rusage usage;
+    // other jobs' children may turn up first; their state is recorded all the same
+    pid_t pid = wait4(-1, &status, WUNTRACED, &usage);
+    if (pid < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    update_proc(pid, status, &usage);
+  }
+}
+
+/* Whether any job has a process that is still running. */
+static bool any_running(void) {
+  for (int id = 1; id <= max_id; id++)
+    if (jobs[id] != NULL && jobs[id]->n_live > jobs[id]->n_stopped)
+      return true;
+  return false;
+}
+
+void jobs_wait_all(void) {
+  // not until no child is left, as the launch helper is a child that does not exit
+  while (any_running()) {
+    int status;
+    struct rusage usage;
+    pid_t pid = wait4(-1, &status, 0, &usage);
+    if (pid < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    update_proc(pid, status, &usage);
+  }
+}
+
+void jobs_notify(FILE* out) {
+  for (int id = 1; id <= max_id; id++) {
+    job_t* job = jobs[id];
+    if (job == NULL || !job->background || !job_is_done(job))
+      continue;
+    if (out != NULL)
+      fprintf(out, "[%d]%c Done\t%s\n", job->id, job->id == current_id ? '+' : ' ',
+              job->command);
+    if (job->timed)
+      job_report_usage(job);
+    job_remove(job);
+  }
+}
+
+void jobs_print(FILE* out) {
+  for (int id = 1; id <= max_id; id++) {
+    job_t* job = jobs[id];
+    if (job == NULL)
+      continue;
+    const char* state = job_is_done(job) ? "Done" : job_is_stopped(job) ? "Stopped" : "Running";
+    fprintf(out, "[%d]%c %-8s %s\n", job->id, id == current_id ? '+' : ' ', state, job->command);
+  }
+}
+
+static double elapsed(struct timespec start, struct timespec end) {
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static double seconds(struct timeval time) { return time.tv_sec + time.tv_usec / 1e6; }
+
+int exit_code(int status) {
+  return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+}
+
+static void print_usage_row(FILE* out, const char* stage, const char* pid, double wall,
+                            struct rusage* usage, int status, const char* command) {
+  fprintf(out, "%-6s %-8s %9.3f %9.3f %9.3f %9ld %7ld %7ld %8ld %7ld %4d  %s\n", stage, pid,
+          wall, seconds(usage->ru_utime), seconds(usage->ru_stime), usage->ru_maxrss,
+          usage->ru_nvcsw, usage->ru_nivcsw, usage->ru_minflt, usage->ru_majflt, status, command);
+}
+
+void usage_report(const char* command, job_proc_t* procs, int n_procs, const char* time_file) {
+  if (n_procs == 0)
+    return;
+
+  if (time_file != NULL) {
+    FILE* out = fopen(time_file, "a");
+    if (out == NULL) {
+      perror(time_file);
+      return;
+    }
+    if (ftell(out) == 0)
+      fprintf(out, "command\tstage\tpid\tstage_command\tstatus\twall_s\tuser_s\tsys_s\t"
+                   "max_rss_kb\tvoluntary_cs\tinvoluntary_cs\tminor_faults\tmajor_faults\n");
+    for (int i = 0; i < n_procs; i++) {
+      job_proc_t* proc = &procs[i];
+      fprintf(out, "%s\t%d\t%d\t%s\t%d\t%.6f\t%.6f\t%.6f\t%ld\t%ld\t%ld\t%ld\t%ld\n", command,
+              i + 1, proc->pid, proc->command, exit_code(proc->status),
+              elapsed(proc->started, proc->ended), seconds(proc->usage.ru_utime),
+              seconds(proc->usage.ru_stime), proc->usage.ru_maxrss, proc->usage.ru_nvcsw,
+              proc->usage.ru_nivcsw, proc->usage.ru_minflt, proc->usage.ru_majflt);
+    }
+    fclose(out);
+    return;
+  }
+
+  // anything the shell has buffered came first
+  fflush(stdout);
+
+  // the total's wall time runs from the first start to the last reap; CPU and counts add up
+  struct rusage total;
+  memset(&total, 0, sizeof(total));
+  struct timespec first = procs[0].started, last = procs[0].ended;
+  fprintf(stderr, "%-6s %-8s %9s %9s %9s %9s %7s %7s %8s %7s %4s  %s\n", "stage", "pid",
+          "wall_s", "user_s", "sys_s", "rss_kb", "vcsw", "ivcsw", "minflt", "majflt", "exit",
+          "command");
+  for (int i = 0; i < n_procs; i++) {
+    job_proc_t* proc = &procs[i];
+    char stage[16], pid[16];
+    snprintf(stage, sizeof(stage), "%d", i + 1);
+    snprintf(pid, sizeof(pid), "%d", proc->pid);
+    print_usage_row(stderr, stage, pid, elapsed(proc->started, proc->ended), &proc->usage,
+                    exit_code(proc->status), proc->command);
+
+    timeradd(&total.ru_utime, &proc->usage.ru_utime, &total.ru_utime);
+    timeradd(&total.ru_stime, &proc->usage.ru_stime, &total.ru_stime);
+    if (proc->usage.ru_maxrss > total.ru_maxrss)
+      total.ru_maxrss = proc->usage.ru_maxrss;
+    total.ru_nvcsw += proc->usage.ru_nvcsw;
+    total.ru_nivcsw += proc->usage.ru_nivcsw;
+    total.ru_minflt += proc->usage.ru_minflt;
+    total.ru_majflt += proc->usage.ru_majflt;
+    if (elapsed(proc->started, first) > 0)
+      first = proc->started;
+    if (elapsed(last, proc->ended) > 0)
+      last = proc->ended;
+  }
+  if (n_procs > 1)
+    print_usage_row(stderr, "total", "", elapsed(first, last), &total,
+                    exit_code(procs[n_procs - 1].status), command);
+}
+
+void job_report_usage(job_t* job) {
+  usage_report(job->command, job->procs, job->n_procs, job->time_file);
+}
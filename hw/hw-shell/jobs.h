@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <termios.h>
+#include <time.h>
+
+/*
+ * The shell's jobs: one per command line started, with every process it
+ * forked. Jobs are numbered from 1 as in %1, %2, ..., and are found by
+ * number or by the pid of any of their processes (the pgid is the pid of
+ * the first one) in constant time.
+ *
+ * Children are only ever reaped by this module. A SIGCHLD handler writes to
+ * a self-pipe; the shell polls jobs_signal_fd() alongside its input and
+ * calls jobs_reap(), so finished background jobs are collected while the
+ * prompt waits rather than left as zombies. They are reaped with wait4(), so
+ * each process's resource usage is kept for `time`.
+ */
+
+/* One process of a job. */
+typedef struct job_proc {
+  pid_t pid;
+  char* command;            // its segment of the command line
+  struct timespec started;  // CLOCK_MONOTONIC, when it was started
+  struct timespec ended;    // and when it was reaped
+  int status;               // wait status, once it has exited
+  struct rusage usage;      // from wait4(), once it has exited
+} job_proc_t;
+
+typedef struct job {
+  int id;            // job number, as in %N
+  pid_t pgid;        // process group: the pid of the first process
+  bool grouped;      // whether the processes were put in their own process group
+  bool background;
+  job_proc_t* procs; // every process started, in pipeline order
+  int n_procs;
+  int procs_capacity;
+  int n_live;        // processes that have neither exited nor been killed
+  int n_stopped;     // live processes that are stopped
+  int status;        // wait status of the last process in the pipeline
+  struct termios tmodes; // terminal modes to restore when the job is foregrounded
+  char* command;
+  bool timed;        // started by `time`: report each process's usage when the job finishes
+  char* time_file;   // where `time -o` appends its summary; NULL for a report on stderr
+} job_t;
+
+/* Installs the SIGCHLD handler and creates the self-pipe. */
+void jobs_init(void);
+
+/* The read end of the self-pipe: readable once a child has changed state. */
+int jobs_signal_fd(void);
+
+/* Creates a job for command, before any of its processes are started. */
+job_t* job_create(const char* command, bool background, bool grouped);
+
+/* Records a process of job, running command; the first one's pid becomes the pgid. */
+void job_add_process(job_t* job, pid_t pid, const char* command);
+
+/* Forgets a job. Its processes should all have been reaped. */
+void job_remove(job_t* job);
+
+/* Looks a job up by number, by the pid of any of its processes, or by a job spec: %N, %%,
+ * %+ or a pid, where a missing spec means the current job. NULL if there is no such job. */
+job_t* job_find(int id);
+job_t* job_find_pid(pid_t pid);
+job_t* job_parse_spec(const char* spec);
+
+bool job_is_done(job_t* job);
+bool job_is_stopped(job_t* job);
+
+/* Makes job the current job (%%), the default for fg and bg. */
+void job_set_current(job_t* job);
+
+/* Resumes every stopped process of the job with SIGCONT. */
+void job_continue(job_t* job);
+
+/* Empties the self-pipe. Returns whether SIGCHLD arrived since the last call; for code that
+ * waits for children of its own rather than calling jobs_reap(). */
+bool jobs_take_signal(void);
+
+/* Reaps every child that has changed state, without blocking. */
+void jobs_reap(void);
+
+/* Blocks until every process of job has exited or stopped. */
+void job_wait(job_t* job);
+
+/* Blocks until no job has a running process. */
+void jobs_wait_all(void);
+
+/* Reports background jobs that have finished since the last call ([N] Done ...) and forgets
+ * them. Nothing is printed if out is NULL. */
+void jobs_notify(FILE* out);
+
+/* Prints every job, as `jobs` does. */
+void jobs_print(FILE* out);
+
+/* A wait status as $? would show it: the exit code, or 128 plus the signal that killed it. */
+int exit_code(int status);
+
+/* Reports the wall time and resource usage of each process of a finished job: a table on
+ * stderr, or with time_file, one tab-separated line per process appended to that file. */
+void job_report_usage(job_t* job);
+
+/* Reports on procs[0..n_procs) of a command line as job_report_usage() does, for commands
+ * that ran as built-ins and were never a job. */
+void usage_report(const char* command, job_proc_t* procs, int n_procs, const char* time_file);
@@ -0,0 +1,274 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jobs.h"
+#include "parallel.h"
+
+/* A growable byte buffer for one captured stream. */
+typedef struct buffer {
+  char* data;
+  size_t length;
+  size_t capacity;
+} buffer_t;
+
+typedef enum job_state { JOB_WAITING, JOB_RUNNING, JOB_REAPED, JOB_FAILED_START } job_state_t;
+
+typedef struct parallel_job {
+  job_state_t state;
+  pid_t pid;
+  int fds[2];        // read ends of the stdout and stderr pipes, -1 once at end of file
+  buffer_t output[2];
+  int status;
+  double start;
+  double seconds;
+  char* command;     // for the report
+} parallel_job_t;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void buffer_reserve(buffer_t* buffer, size_t extra) {
+  if (buffer->length + extra <= buffer->capacity)
+    return;
+  size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+  while (capacity < buffer->length + extra)
+    capacity *= 2;
+  buffer->data = realloc(buffer->data, capacity);
+  if (buffer->data == NULL)
+    abort();
+  buffer->capacity = capacity;
+}
+
+/* Returns word with every {} replaced by arg, in a new string. */
+static char* substitute(const char* word, const char* arg) {
+  buffer_t result = {NULL, 0, 0};
+  size_t arg_length = strlen(arg);
+  for (const char* p = word;;) {
+    const char* brace = strstr(p, "{}");
+    size_t n = brace ? (size_t)(brace - p) : strlen(p);
+    buffer_reserve(&result, n + arg_length + 1);
+    memcpy(result.data + result.length, p, n);
+    result.length += n;
+    if (brace == NULL)
+      break;
+    memcpy(result.data + result.length, arg, arg_length);
+    result.length += arg_length;
+    p = brace + 2;
+  }
+  result.data[result.length] = '\0';
+  return result.data;
+}
+
+/* Builds the command for one argument and starts it with its output going into two pipes. */
+static void start_job(parallel_job_t* job, char** template, size_t n_template, const char* arg,
+                      bool has_braces, parallel_launch_fn* launch) {
+  size_t n_words = n_template + (has_braces ? 0 : 1);
+  char** words = malloc(n_words * sizeof(char*));
+  for (size_t i = 0; i < n_template; i++)
+    words[i] = substitute(template[i], arg);
+  if (!has_braces)
+    words[n_template] = strdup(arg);
+  struct tokens* command = tokens_create(words, n_words);
+
+  buffer_t text = {NULL, 0, 0};
+  for (size_t i = 0; i < n_words; i++) {
+    size_t n = strlen(words[i]);
+    buffer_reserve(&text, n + 2);
+    if (i > 0)
+      text.data[text.length++] = ' ';
+    memcpy(text.data + text.length, words[i], n + 1);
+    text.length += n;
+    free(words[i]);
+  }
+  free(words);
+  job->command = text.data;
+
+  // close-on-exec, so no other job inherits these ends; dup2() clears the flag in the child
+  int out_pipe[2], err_pipe[2];
+  if (pipe2(out_pipe, O_CLOEXEC) < 0) {
+    perror("pipe");
+    job->state = JOB_FAILED_START;
+    tokens_destroy(command);
+    return;
+  }
+  if (pipe2(err_pipe, O_CLOEXEC) < 0) {
+    perror("pipe");
+    close(out_pipe[0]);
+    close(out_pipe[1]);
+    job->state = JOB_FAILED_START;
+    tokens_destroy(command);
+    return;
+  }
+
+  job->start = now();
+  job->pid = launch(command, out_pipe[1], err_pipe[1]);
+  close(out_pipe[1]);
+  close(err_pipe[1]);
+  tokens_destroy(command);
+  if (job->pid < 0) {
+    close(out_pipe[0]);
+    close(err_pipe[0]);
+    job->state = JOB_FAILED_START;
+    return;
+  }
+  job->fds[0] = out_pipe[0];
+  job->fds[1] = err_pipe[0];
+  job->state = JOB_RUNNING;
+}
+
+static bool job_complete(parallel_job_t* job) {
+  return job->state == JOB_FAILED_START ||
+         (job->state == JOB_REAPED && job->fds[0] < 0 && job->fds[1] < 0);
+}
+
+static bool job_failed(parallel_job_t* job) {
+  return job->state == JOB_FAILED_START || !WIFEXITED(job->status) ||
+         WEXITSTATUS(job->status) != 0;
+}
+
+/* Prints a finished job's output and its report, then frees what it held. */
+static void print_job(parallel_job_t* job, size_t index) {
+  fwrite(job->output[0].data, 1, job->output[0].length, stdout);
+  fflush(stdout);
+  fwrite(job->output[1].data, 1, job->output[1].length, stderr);
+  if (job->state == JOB_FAILED_START)
+    fprintf(stderr, "[%zu] %s: not started\n", index + 1, job->command);
+  else if (WIFSIGNALED(job->status))
+    fprintf(stderr, "[%zu] %s: killed by signal %d, %.3fs\n", index + 1, job->command,
+            WTERMSIG(job->status), job->seconds);
+  else
+    fprintf(stderr, "[%zu] %s: exit %d, %.3fs\n", index + 1, job->command,
+            WEXITSTATUS(job->status), job->seconds);
+  free(job->output[0].data);
+  free(job->output[1].data);
+  free(job->command);
+}
+
+/* Appends whatever the pipe holds to the job's buffer, closing it at end of file. */
+static void drain(parallel_job_t* job, int stream) {
+  buffer_reserve(&job->output[stream], 4096);
+  buffer_t* buffer = &job->output[stream];
+  ssize_t n = read(job->fds[stream], buffer->data + buffer->length, buffer->capacity - buffer->length);
+  if (n > 0) {
+    buffer->length += n;
+  } else if (n == 0 || errno != EINTR) {
+    close(job->fds[stream]);
+    job->fds[stream] = -1;
+  }
+}
+
+int parallel_run(char** template, size_t n_template, char** args, size_t n_args, int max_jobs,
+                 parallel_launch_fn* launch) {
+  bool has_braces = false;
+  for (size_t i = 0; i < n_template; i++)
+    if (strstr(template[i], "{}") != NULL)
+      has_braces = true;
+
+  parallel_job_t* jobs = calloc(n_args, sizeof(parallel_job_t));
+  // jobs that finished out of order still hold their pipes until everything before them is printed
+  struct pollfd* fds = malloc((2 * n_args + 1) * sizeof(struct pollfd));
+  parallel_job_t** polled = malloc((2 * n_args + 1) * sizeof(parallel_job_t*));
+  size_t next_start = 0, next_print = 0;
+  int running = 0, failed = 0;
+
+  // SIGCHLD that arrived before now is for the shell's own jobs, which it reaps later anyway
+  jobs_take_signal();
+
+  while (next_print < n_args) {
+    while (running < max_jobs && next_start < n_args) {
+      start_job(&jobs[next_start], template, n_template, args[next_start], has_braces, launch);
+      if (jobs[next_start].state == JOB_RUNNING)
+        running++;
+      next_start++;
+    }
+
+    // output goes out strictly in argument order, as soon as each job is complete
+    while (next_print < n_args && job_complete(&jobs[next_print])) {
+      if (job_failed(&jobs[next_print]))
+        failed++;
+      print_job(&jobs[next_print], next_print);
+      next_print++;
+    }
+    if (next_print == n_args)
+      break;
+
+    // wait for output from any running job, or for SIGCHLD
+    int n_fds = 0;
+    for (size_t i = next_print; i < next_start; i++) {
+      for (int stream = 0; stream < 2; stream++) {
+        if (jobs[i].state != JOB_FAILED_START && jobs[i].fds[stream] >= 0) {
+          fds[n_fds] = (struct pollfd){jobs[i].fds[stream], POLLIN, 0};
+          polled[n_fds++] = &jobs[i];
+        }
+      }
+    }
+    fds[n_fds] = (struct pollfd){jobs_signal_fd(), POLLIN, 0};
+    if (poll(fds, n_fds + 1, -1) < 0 && errno != EINTR) {
+      perror("poll");
+      break;
+    }
+    for (int k = 0; k < n_fds; k++)
+      if (fds[k].revents)
+        drain(polled[k], fds[k].fd == polled[k]->fds[0] ? 0 : 1);
+
+    if (jobs_take_signal() || fds[n_fds].revents) {
+      for (size_t i = next_print; i < next_start; i++) {
+        if (jobs[i].state != JOB_RUNNING)
+          continue;
+        if (waitpid(jobs[i].pid, &jobs[i].status, WNOHANG) == jobs[i].pid) {
+          jobs[i].seconds = now() - jobs[i].start;
+          jobs[i].state = JOB_REAPED;
+          running--;
+        }
+      }
+    }
+  }
+
+  free(polled);
+  free(fds);
+  free(jobs);
+  return failed;
+}
+
+char** parallel_read_args(int fd, size_t* n_args) {
+  buffer_t input = {NULL, 0, 0};
+  for (;;) {
+    buffer_reserve(&input, 4096);
+    ssize_t n = read(fd, input.data + input.length, input.capacity - input.length - 1);
+    if (n > 0)
+      input.length += n;
+    else if (n == 0 || errno != EINTR)
+      break;
+  }
+
+  size_t n = 0, capacity = 16;
+  char** args = malloc(capacity * sizeof(char*));
+  for (size_t start = 0; start < input.length;) {
+    char* newline = memchr(input.data + start, '\n', input.length - start);
+    size_t end = newline ? (size_t)(newline - input.data) : input.length;
+    if (n + 1 == capacity) {
+      capacity *= 2;
+      args = realloc(args, capacity * sizeof(char*));
+    }
+    if (end > start)
+      args[n++] = strndup(input.data + start, end - start);
+    start = end + 1;
+  }
+  args[n] = NULL;
+  free(input.data);
+  *n_args = n;
+  return args;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "tokenizer.h"
+
+/*
+ * The `parallel` built-in: one command per argument with at most N of them
+ * running at a time.
+ */
+
+/* Starts one job of a parallel run with its stdout and stderr on out_fd and err_fd. Returns
+ * the child's pid, or -1 if it could not be started. */
+typedef pid_t parallel_launch_fn(struct tokens* command, int out_fd, int err_fd);
+
+/* Runs template once per argument, with every {} replaced by the argument (or the argument
+ * appended, if no word holds {}), keeping max_jobs children running until all are done.
+ * Each job's stdout and stderr are captured and printed whole, in argument order, followed
+ * by its exit status and wall time on stderr. Returns the number of jobs that failed. */
+int parallel_run(char** template, size_t n_template, char** args, size_t n_args, int max_jobs,
+                 parallel_launch_fn* launch);
+
+/* Reads one argument per line from fd until end of file. Returns a NULL-terminated array of
+ * malloc'd lines and stores their number in n_args. */
+char** parallel_read_args(int fd, size_t* n_args);
@@ -0,0 +1,232 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "script.h"
+#include "tokenizer.h"
+
+/* Scripts read from files. A shell sources a handful at most, so a list is searched. */
+static script_t** cache;
+static size_t n_cached;
+static size_t cache_capacity;
+
+static void script_destroy(script_t* script) {
+  for (size_t i = 0; i < script->n_pipelines; i++) {
+    tokens_destroy(script->pipelines[i].tokens);
+    free(script->pipelines[i].time_file);
+  }
+  free(script->pipelines);
+  free(script);
+}
+
+static void syntax_error(const char* name, int line, const char* near) {
+  if (name != NULL)
+    fprintf(stderr, "%s: line %d: ", name, line);
+  fprintf(stderr, "syntax error near `%s'\n", near);
+}
+
+/* Appends words first..first + n - 1 of line as a pipeline, taking a leading time [-o file]
+ * off. If the words are all of the line, the pipeline takes it over rather than copying them,
+ * and *line is set to NULL. Returns the word a syntax error is near, or NULL. */
+static const char* add_pipeline(script_t* script, struct tokens** line, size_t first, size_t n,
+                                script_connector_t connector, bool background) {
+  // only | is left inside a pipeline, every other operator having ended one
+  for (size_t i = first; i < first + n; i++)
+    if (tokens_is_operator(*line, i) &&
+        (i == first || i == first + n - 1 || tokens_is_operator(*line, i + 1)))
+      return "|";
+
+  script_pipeline_t pipeline = {NULL, connector, background, false, NULL};
+  size_t start = first;
+  if (strcmp(tokens_get_token(*line, start), "time") == 0) {
+    pipeline.timed = true;
+    start++;
+    if (start + 1 < first + n && strcmp(tokens_get_token(*line, start), "-o") == 0) {
+      pipeline.time_file = strdup(tokens_get_token(*line, start + 1));
+      start += 2;
+    }
+  }
+  if (start == 0 && n == tokens_get_length(*line)) {
+    pipeline.tokens = *line;
+    *line = NULL;
+  } else {
+    pipeline.tokens = tokens_slice(*line, start, first + n - start);
+  }
+
+  if (script->n_pipelines == script->capacity) {
+    script->capacity = script->capacity ? script->capacity * 2 : 4;
+    script->pipelines = realloc(script->pipelines, script->capacity * sizeof(script_pipeline_t));
+    if (script->pipelines == NULL)
+      abort();
+  }
+  script->pipelines[script->n_pipelines++] = pipeline;
+  return NULL;
+}
+
+script_t* script_parse(const char* text, const char* name) {
+  script_t* script = calloc(1, sizeof(script_t));
+  if (script == NULL)
+    abort();
+  script->users = 1;
+
+  script_connector_t connector = SCRIPT_ALWAYS;
+  const char* error = NULL;
+  char* error_word = NULL;
+  int line_num = 0;
+
+  for (const char* line = text; *line != '\0' && error == NULL;) {
+    const char* newline = strchr(line, '\n');
+    size_t length = newline ? (size_t)(newline - line) : strlen(line);
+    struct tokens* tokens;
+    if (newline != NULL) {
+      char* copy = strndup(line, length);
+      tokens = tokenize(copy);
+      free(copy);
+    } else {
+      tokens = tokenize(line);
+    }
+    line = newline ? newline + 1 : line + length;
+    line_num++;
+
+    size_t n_tokens = tokens_get_length(tokens);
+    if (n_tokens == 0 || tokens_get_token(tokens, 0)[0] == '#') {
+      tokens_destroy(tokens);
+      continue;
+    }
+
+    // the pipeline being read is the n_words words before word
+    size_t n_words = 0;
+    for (size_t i = 0; i <= n_tokens && error == NULL; i++) {
+      char* word = i < n_tokens ? tokens_get_token(tokens, i) : NULL;
+      bool operator = tokens_is_operator(tokens, i);
+      bool and_or = operator && (strcmp(word, "&&") == 0 || strcmp(word, "||") == 0);
+      bool separator = operator && (strcmp(word, ";") == 0 || strcmp(word, "&") == 0);
+      if (word != NULL && !and_or && !separator) {
+        n_words++;
+        continue;
+      }
+
+      // the end of the line finishes a pipeline, unless an && or || before it carries on
+      if (n_words == 0) {
+        if (word != NULL)
+          error = word;
+        continue;
+      }
+      // most lines are a single pipeline, which keeps the line's own tokens
+      error = add_pipeline(script, &tokens, i - n_words, n_words, connector,
+                           separator && strcmp(word, "&") == 0);
+      n_words = 0;
+      connector = !and_or ? SCRIPT_ALWAYS
+                  : strcmp(word, "&&") == 0 ? SCRIPT_IF_SUCCESS : SCRIPT_IF_FAILURE;
+    }
+    if (error != NULL)
+      error_word = strdup(error);
+    if (tokens != NULL)
+      tokens_destroy(tokens);
+  }
+  if (error_word == NULL && connector != SCRIPT_ALWAYS) {
+    line_num++;
+    error_word = strdup("end of file");
+  }
+  if (error_word != NULL) {
+    syntax_error(name, line_num, error_word);
+    free(error_word);
+    script_destroy(script);
+    return NULL;
+  }
+  return script;
+}
+
+/* Forgets a cached script; it is freed once nothing is running it. */
+static void uncache(size_t i) {
+  script_t* script = cache[i];
+  cache[i] = cache[--n_cached];
+  script->cached = false;
+  if (script->users == 0)
+    script_destroy(script);
+}
+
+script_t* script_load(const char* path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    perror(path);
+    if (fd >= 0)
+      close(fd);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < n_cached; i++) {
+    script_t* script = cache[i];
+    if (script->dev != st.st_dev || script->ino != st.st_ino)
+      continue;
+    if (script->size == st.st_size && script->mtime.tv_sec == st.st_mtim.tv_sec &&
+        script->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+      close(fd);
+      script->users++;
+      return script;
+    }
+    uncache(i);
+    break;
+  }
+
+  size_t length = 0, capacity = st.st_size + 1;
+  char* text = malloc(capacity);
+  for (;;) {
+    if (length + 1 == capacity) {
+      capacity *= 2;
+      text = realloc(text, capacity);
+    }
+    ssize_t n = read(fd, text + length, capacity - length - 1);
+    if (n < 0) {
+      perror(path);
+      free(text);
+      close(fd);
+      return NULL;
+    }
+    if (n == 0)
+      break;
+    length += n;
+  }
+  text[length] = '\0';
+  close(fd);
+
+  script_t* script = script_parse(text, path);
+  free(text);
+  if (script == NULL)
+    return NULL;
+  script->dev = st.st_dev;
+  script->ino = st.st_ino;
+  script->size = st.st_size;
+  script->mtime = st.st_mtim;
+  script->cached = true;
+
+  if (n_cached == cache_capacity) {
+    cache_capacity = cache_capacity ? cache_capacity * 2 : 4;
+    cache = realloc(cache, cache_capacity * sizeof(script_t*));
+    if (cache == NULL)
+      abort();
+  }
+  cache[n_cached++] = script;
+  return script;
+}
+
+void script_release(script_t* script) {
+  if (--script->users == 0 && !script->cached)
+    script_destroy(script);
+}
+
+int script_run(script_t* script, script_run_fn* run) {
+  int status = 0;
+  for (size_t i = 0; i < script->n_pipelines; i++) {
+    script_pipeline_t* pipeline = &script->pipelines[i];
+    if ((pipeline->connector == SCRIPT_IF_SUCCESS && status != 0) ||
+        (pipeline->connector == SCRIPT_IF_FAILURE && status == 0))
+      continue;
+    status = run(pipeline);
+  }
+  return status;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <time.h>
+
+/*
+ * Command lists and scripts, parsed once into a flat list of pipelines.
+ *
+ * A line holds pipelines separated by `;`, `&`, `&&` or `||` (which the
+ * tokenizer splits into words of their own, like `|`), and a line that ends
+ * in `&&` or `||` continues on the next. A line whose first word starts with
+ * `#` is a comment. A leading `time [-o file]` is taken off each pipeline
+ * here, so running it needs no further parsing.
+ *
+ * Scripts loaded from a file are cached by device and inode and reused while
+ * the file's size and modification time are unchanged, so a script that is
+ * sourced again and again is only read and tokenized once.
+ */
+
+typedef enum script_connector {
+  SCRIPT_ALWAYS,     // after `;`, `&` or a newline
+  SCRIPT_IF_SUCCESS, // after `&&`: only if the last pipeline that ran succeeded
+  SCRIPT_IF_FAILURE, // after `||`: only if it failed
+} script_connector_t;
+
+typedef struct script_pipeline {
+  struct tokens* tokens; // its words, one or more commands joined by |
+  script_connector_t connector;
+  bool background;       // ended by &
+  bool timed;            // started with time
+  char* time_file;       // time -o file, or NULL
+} script_pipeline_t;
+
+typedef struct script {
+  script_pipeline_t* pipelines;
+  size_t n_pipelines;
+  size_t capacity;
+  // the file it was read from, to tell whether the cached copy is still current
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  struct timespec mtime;
+  int users;   // script_load/script_parse calls not yet released
+  bool cached;
+} script_t;
+
+/* Runs one pipeline and returns its status: 0 for success. */
+typedef int script_run_fn(script_pipeline_t* pipeline);
+
+/* Parses text, which may hold many lines. Syntax errors are reported on stderr, prefixed with
+ * name and the line number if name is not NULL, and give NULL. */
+script_t* script_parse(const char* text, const char* name);
+
+/* Returns the parsed script in the file at path, from the cache if the file has not changed
+ * since it was last parsed. NULL if it cannot be read or parsed. */
+script_t* script_load(const char* path);
+
+/* Gives back a script from script_parse or script_load. */
+void script_release(script_t* script);
+
+/* Runs the pipelines in order, skipping those whose && or || condition does not hold, and
+ * returns the status of the last one that ran. */
+int script_run(script_t* script, script_run_fn* run);
@@ -1,17 +1,29 @@
+#define _GNU_SOURCE
+
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <signal.h>
+#include <spawn.h>
 #include <sys/wait.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "command_hash.h"
+#include "jobs.h"
+#include "parallel.h"
+#include "script.h"
 #include "tokenizer.h"
+#include "zygote.h"
 
 /* Convenience macro to silence compiler warnings about unused function parameters. */
 #define unused __attribute__((unused))
@@ -28,52 +40,11 @@ struct termios shell_tmodes;
 /* Process group id for the shell */
 pid_t shell_pgid;
 
-/* Linked list of processes */
-typedef struct process {
-  pid_t pid;
-  struct termios tmodes; // terminal modes for the process
-  bool running; // true = running, false = suspended
-  struct process *next;
-} process_t;
-
-process_t *process_list = NULL;
-
-void add_process(pid_t pid) {
-  process_t *new_proc = malloc(sizeof(process_t));
-  new_proc->pid = pid;
-  new_proc->running = true;
-  new_proc->next = process_list;
-  process_list = new_proc;
-  // save the terminal modes for the process
-  tcgetattr(shell_terminal, &new_proc->tmodes);
-}
-
-void remove_process(pid_t pid) {
-  process_t **curr = &process_list;
-  while (*curr) {
-    if ((*curr)->pid == pid) {
-      process_t *temp = *curr;
-      *curr = (*curr)->next;
-      free(temp);
-      return;
-    }
-    curr = &(*curr)->next;
-  }
-}
-
-process_t* find_process(pid_t pid) {
-  process_t *curr = process_list;
-  while (curr) {
-    if (curr->pid == pid) return curr;
-    curr = curr->next;
-  }
-  return NULL;
-}
+/* Whether external commands are started with posix_spawn rather than fork (-f) */
+bool spawn_launch = true;
 
-/* Find the most recently added process */
-process_t* get_recent_process() {
-    return process_list;
-}
+/* Whether the commands posix_spawn would start go through the launch helper instead (-z) */
+bool zygote_launch = false;
 
 int cmd_exit(struct tokens* tokens);
 int cmd_help(struct tokens* tokens);
@@ -82,6 +53,11 @@ int cmd_cd(struct tokens* tokens);
 int cmd_wait(struct tokens* tokens);
 int cmd_fg(struct tokens* tokens);
 int cmd_bg(struct tokens* tokens);
+int cmd_jobs(struct tokens* tokens);
+int cmd_parallel(struct tokens* tokens);
+int cmd_hash(struct tokens* tokens);
+int cmd_time(struct tokens* tokens);
+int cmd_source(struct tokens* tokens);
 
 /* Built-in command functions take token array (see parse.h) and return int */
 typedef int cmd_fun_t(struct tokens* tokens);
@@ -99,19 +75,28 @@ fun_desc_t cmd_table[] = {
     {cmd_pwd, "pwd", "print current working directory"},
     {cmd_cd, "cd", "change current working directory"},
     {cmd_wait, "wait", "wait for all background jobs to finish"},
-    {cmd_fg, "fg", "move process to foreground"},
-    {cmd_bg, "bg", "resume process in background"},
+    {cmd_fg, "fg", "move job to foreground (%N, or a pid; the current job by default)"},
+    {cmd_bg, "bg", "resume job in background (%N, or a pid; the current job by default)"},
+    {cmd_jobs, "jobs", "list jobs"},
+    {cmd_parallel, "parallel", "run a command per argument, N at a time: parallel -j N cmd {} ::: args"},
+    {cmd_hash, "hash", "remember or list command locations, -r forgets them all"},
+    {cmd_source, "source", "run the commands in a file"},
+    {cmd_source, ".", "run the commands in a file"},
+    {cmd_time, "time", "report each stage's time and resource usage: time [-o file] cmd | cmd..."},
 };
 
 /* Prints a helpful description for the given command */
 int cmd_help(unused struct tokens* tokens) {
   for (unsigned int i = 0; i < sizeof(cmd_table) / sizeof(fun_desc_t); i++)
     printf("%s - %s\n", cmd_table[i].cmd, cmd_table[i].doc);
-  return 1;
+  return 0;
 }
 
-/* Exits this shell */
-int cmd_exit(unused struct tokens* tokens) { exit(0); }
+/* Exits this shell, with the given status or 0 */
+int cmd_exit(struct tokens* tokens) {
+  char* status = tokens_get_token(tokens, 1);
+  exit(status != NULL ? atoi(status) : 0);
+}
 
 /* Prints current working directory */
 int cmd_pwd(unused struct tokens* tokens) {
@@ -137,106 +122,103 @@ int cmd_cd(struct tokens* tokens) {
 
 /* Waits for all background jobs to finish */
 int cmd_wait(unused struct tokens* tokens) {
-  while (waitpid(-1, NULL, 0) > 0);
+  jobs_wait_all();
   return 0;
 }
 
-/* Move process to foreground */
-int cmd_fg(struct tokens* tokens) {
-  pid_t pid = -1;
-  if (tokens_get_length(tokens) > 1) {
-    pid = atoi(tokens_get_token(tokens, 1));
-  } else {
-    process_t *proc = get_recent_process();
-    if (proc) pid = proc->pid;
+/* Waits for a foreground job to finish or stop, then takes the terminal back. Returns the
+ * job's status as an exit code */
+int wait_foreground(job_t* job) {
+  job_wait(job);
+
+  if (shell_is_interactive) {
+    // Save terminal modes(If the job is paused, the subsequent switch needs to reuse them)
+    tcgetattr(shell_terminal, &job->tmodes);
+    // Restore the shell's terminal control and terminal modes
+    tcsetpgrp(shell_terminal, shell_pgid);
+    tcsetattr(shell_terminal, TCSADRAIN, &shell_tmodes);
   }
 
-  if (pid == -1) {
-    fprintf(stderr, "fg: no current job\n");
-    return -1;
+  // a stopped job stays in the table until it is resumed and finishes; a finished one is forgotten
+  if (job_is_stopped(job)) {
+    job->background = true;
+    job_set_current(job);
+    printf("[%d]+ Stopped\t%s\n", job->id, job->command);
+    return 128 + SIGTSTP;
   }
+  int status = exit_code(job->status);
+  if (job->timed)
+    job_report_usage(job);
+  job_remove(job);
+  return status;
+}
 
-  process_t *proc = find_process(pid);
-  if (!proc) {
-      fprintf(stderr, "fg: job not found: %d\n", pid);
-      return -1;
+/* Move job to foreground */
+int cmd_fg(struct tokens* tokens) {
+  char* spec = tokens_get_token(tokens, 1);
+  job_t* job = job_parse_spec(spec);
+  if (job == NULL) {
+    fprintf(stderr, "fg: %s: no such job\n", spec ? spec : "current");
+    return -1;
   }
 
+  job->background = false;
+  job_set_current(job);
   if (shell_is_interactive) {
-      // Restore process terminal modes
-      tcsetattr(shell_terminal, TCSADRAIN, &proc->tmodes);
-      
-      // Send SIGCONT if stopped
-      if (!proc->running) {
-          kill(-pid, SIGCONT);
-          proc->running = true;
-      }
-
-      // Put the process in the foreground process group (transfer terminal control)
-      tcsetpgrp(shell_terminal, pid);
-
-      // Wait for the process to finish/pause (WUNTRACED captures paused state)
-      int status;
-      waitpid(pid, &status, WUNTRACED);
-
-      // Save terminal modes(If the process is paused again, the subsequent switch needs to reuse it)
-      tcgetattr(shell_terminal, &proc->tmodes);
-      
-      // Restore the shell's terminal control and terminal modes
-      // tcsetpgrp: set the process group id for the shell
-      // tcsetattr: set the terminal attributes for the shell
-      tcsetpgrp(shell_terminal, shell_pgid);
-      tcsetattr(shell_terminal, TCSADRAIN, &shell_tmodes);
-
-      // Handle process status: update status if paused, remove tracking if exited/signaled
-      // WIFSTOPPED: check if the process is stopped
-      if (WIFSTOPPED(status)) {
-          proc->running = false;
-          printf("[%d] Stopped\n", pid);
-      } else if (WIFEXITED(status) || WIFSIGNALED(status)) {
-          // WIFEXITED: check if the process exited
-          // WIFSIGNALED: check if the process was signaled
-          remove_process(pid);
-      }
-  } else {
-      int status;
-      waitpid(pid, &status, 0);
-      remove_process(pid);
+    // Restore the job's terminal modes and give it the terminal
+    tcsetattr(shell_terminal, TCSADRAIN, &job->tmodes);
+    tcsetpgrp(shell_terminal, job->pgid);
   }
+  // Send SIGCONT if stopped
+  if (job_is_stopped(job))
+    job_continue(job);
+  wait_foreground(job);
   return 0;
 }
 
-/* Resume process in background */
+/* Resume job in background */
 int cmd_bg(struct tokens* tokens) {
-  pid_t pid = -1;
-  if (tokens_get_length(tokens) > 1) {
-    pid = atoi(tokens_get_token(tokens, 1));
-  } else {
-    process_t *proc = get_recent_process();
-    // Try to find a stopped process preferably
-    if (proc && proc->running) {
-        // Just pick the first one
-    }
-    if (proc) pid = proc->pid;
+  char* spec = tokens_get_token(tokens, 1);
+  job_t* job = job_parse_spec(spec);
+  if (job == NULL) {
+    fprintf(stderr, "bg: %s: no such job\n", spec ? spec : "current");
+    return -1;
   }
 
-  if (pid == -1) {
-    fprintf(stderr, "bg: no current job\n");
-    return -1;
+  if (job_is_stopped(job)) {
+    job_continue(job);
+    printf("[%d]+ %s &\n", job->id, job->command);
   }
+  job->background = true;
+  return 0;
+}
 
-  process_t *proc = find_process(pid);
-  if (!proc) {
-      fprintf(stderr, "bg: job not found: %d\n", pid);
-      return -1;
+/* Lists jobs with their state */
+int cmd_jobs(unused struct tokens* tokens) {
+  jobs_reap();
+  jobs_print(stdout);
+  return 0;
+}
+
+/* Remembers the given commands' locations, lists the remembered ones, or forgets them (-r) */
+int cmd_hash(struct tokens* tokens) {
+  size_t n_tokens = tokens_get_length(tokens);
+  if (n_tokens == 1) {
+    hash_print(stdout);
+    return 0;
   }
 
-  if (!proc->running) {
-      kill(-pid, SIGCONT);
-      proc->running = true;
-      printf("[%d] Running\n", pid);
+  int result = 0;
+  for (size_t i = 1; i < n_tokens; i++) {
+    char* name = tokens_get_token(tokens, i);
+    if (strcmp(name, "-r") == 0) {
+      hash_clear();
+    } else if (strchr(name, '/') == NULL && hash_lookup(name) == NULL) {
+      fprintf(stderr, "hash: %s: not found\n", name);
+      result = 1;
+    }
   }
-  return 0;
+  return result;
 }
 
 /* Looks up the built-in command, if it exists. */
@@ -248,12 +230,12 @@ int lookup(char cmd[]) {
 }
 
 /* Intialization procedures for this shell */
-void init_shell() {
+void init_shell(bool running_script) {
   /* Our shell is connected to standard input. */
   shell_terminal = STDIN_FILENO;
 
   /* Check if we are running interactively */
-  shell_is_interactive = isatty(shell_terminal);
+  shell_is_interactive = !running_script && isatty(shell_terminal);
 
   if (shell_is_interactive) {
     /* If the shell is not currently in the foreground, we must pause the shell until it becomes a
@@ -281,37 +263,88 @@ void init_shell() {
   signal(SIGTTOU, SIG_IGN);
 }
 
-/* Executes a program segment with redirections and path resolution */
-void exec_process(struct tokens* tokens, int start, int end) {
-  size_t n_tokens = end - start;
-  char** args = malloc((n_tokens + 1) * sizeof(char*));
+/* Restores the default handlers of the signals the shell ignores, in a child */
+void default_signals(void) {
+  signal(SIGINT, SIG_DFL);
+  signal(SIGQUIT, SIG_DFL);
+  signal(SIGTSTP, SIG_DFL);
+  signal(SIGTTIN, SIG_DFL);
+  signal(SIGTTOU, SIG_DFL);
+}
+
+/* Returns the program a command segment runs: its first word that is not a redirection */
+char* segment_program(struct tokens* tokens, int start, int end) {
+  for (int i = start; i < end; i++) {
+    char* token = tokens_get_token(tokens, i);
+    if (strcmp(token, "<") == 0 || strcmp(token, ">") == 0)
+      i++;
+    else
+      return token;
+  }
+  return NULL;
+}
+
+/* Resolves a command segment's program in the parent, so every child forked from now on
+ * finds it in its copy of the command hash table */
+void resolve_segment(struct tokens* tokens, int start, int end) {
+  char* prog = segment_program(tokens, start, end);
+  if (prog && lookup(prog) < 0 && strchr(prog, '/') == NULL)
+    hash_lookup(prog);
+}
+
+/* Splits a program segment into its arguments (args needs end - start + 1 slots) and its
+ * input and output files. Returns -1 if a redirection has no file name */
+int parse_segment(struct tokens* tokens, int start, int end, char** args, char** input_file,
+                  char** output_file) {
   int arg_idx = 0;
-  char* input_file = NULL;
-  char* output_file = NULL;
+  *input_file = NULL;
+  *output_file = NULL;
 
   // analyze the tokens and set the input and output files
   for (int i = start; i < end; i++) {
     char* token = tokens_get_token(tokens, i);
     if (strcmp(token, "<") == 0) {
       if (i + 1 < end) {
-        input_file = tokens_get_token(tokens, ++i);
+        *input_file = tokens_get_token(tokens, ++i);
       } else {
         fprintf(stderr, "Missing input file after <\n");
-        exit(1);
+        return -1;
       }
     } else if (strcmp(token, ">") == 0) {
       if (i + 1 < end) {
-        output_file = tokens_get_token(tokens, ++i);
+        *output_file = tokens_get_token(tokens, ++i);
       } else {
         fprintf(stderr, "Missing output file after >\n");
-        exit(1);
+        return -1;
       }
     } else {
       args[arg_idx++] = token;
     }
   }
   args[arg_idx] = NULL;
- 
+  return 0;
+}
+
+/* Counts the words of a NULL-terminated argument array */
+size_t arg_count(char** args) {
+  size_t n = 0;
+  while (args[n] != NULL)
+    n++;
+  return n;
+}
+
+/* Executes a program segment with redirections and path resolution */
+void exec_process(struct tokens* tokens, int start, int end) {
+  // the shell's SIGCHLD handler would write to its self-pipe
+  signal(SIGCHLD, SIG_DFL);
+
+  size_t n_tokens = end - start;
+  char** args = malloc((n_tokens + 1) * sizeof(char*));
+  char* input_file;
+  char* output_file;
+  if (parse_segment(tokens, start, end, args, &input_file, &output_file) < 0)
+    exit(1);
+
   // handle input redirection
   if (input_file) {
     // open the input file
@@ -352,249 +385,628 @@ void exec_process(struct tokens* tokens, int start, int end) {
     exit(0);
   }
 
-  /* Check for built-in commands if running in pipe */
+  /* Check for built-in commands if running in pipe; they see only their own segment */
   int fundex = lookup(prog);
   if (fundex >= 0) {
-      cmd_table[fundex].fun(tokens);
+      // the parent waits for the report pipe to close, which a builtin never execs to do
+      hash_close_report();
+      // a builtin that starts children of its own (parallel) needs its own self-pipe
+      jobs_init();
+      struct tokens* segment = tokens_create(args, arg_count(args));
+      cmd_table[fundex].fun(segment);
+      tokens_destroy(segment);
       exit(0);
   }
 
-  // if the program is a full path, execute it directly
-  if (strchr(prog, '/') != NULL) {
-    if (execv(prog, args) == -1) {
-      fprintf(stderr, "%s: %s\n", prog, strerror(errno));
+  // a full path is executed directly; other names were resolved by the parent before fork,
+  // but those found through a relative $PATH entry are not remembered and are searched again
+  char found[4096];
+  const char* path = prog;
+  if (strchr(prog, '/') == NULL) {
+    path = hash_find(prog);
+    if (path == NULL && path_search(prog, found, sizeof(found)) == 0)
+      path = found;
+    if (path == NULL) {
+      fprintf(stderr, "%s: command not found\n", prog);
       exit(1);
     }
-  } else {
-    // if the program is not a full path, search the PATH environment variable
-    // get the PATH environment variable
-    char* path_env = getenv("PATH");
-    // copy the PATH environment variable to a new string to avoid modifying the original string
-    char* path_copy = strdup(path_env);
-    // strtok is a function that splits a string into tokens
-    // it returns a pointer to the next token
-    char* dir = strtok(path_copy, ":");
-    char full_path[4096];
-    int executed = 0;
-
-    while (dir != NULL) {
-      // format the full path
-      // e.g. dir = /bin, prog = ls, full_path = /bin/ls
-      snprintf(full_path, sizeof(full_path), "%s/%s", dir, prog);
-      // check if the file is executable
-      // X_OK is a constant for checking if the file is executable
-      if (access(full_path, X_OK) == 0) {
-        if (execv(full_path, args) == -1) {
-          fprintf(stderr, "%s: %s\n", full_path, strerror(errno));
-          exit(1);
-        }
-      }
-      // pass NULL to strtok to get the next token
-      dir = strtok(NULL, ":");
+  }
+  execv(path, args);
+
+  // the remembered location has gone: tell the parent to forget it and search $PATH again
+  if (errno == ENOENT && path != prog) {
+    hash_report_missing(prog);
+    if (path_search(prog, found, sizeof(found)) == 0) {
+      path = found;
+      execv(path, args);
     }
+  }
+  fprintf(stderr, "%s: %s\n", path, strerror(errno));
+  exit(1);
+}
 
-    if (!executed) {
-      fprintf(stderr, "%s: command not found\n", prog);
-      free(path_copy);
-      exit(1);
-    }
-    free(path_copy);
+/* Starts path through the launch helper if there is one and it takes the request, or with
+ * posix_spawn. Returns 0 or an errno value, as posix_spawn does */
+int launch_path(pid_t* pid, const char* path, char** args, posix_spawn_file_actions_t* actions,
+                posix_spawnattr_t* attr, int fds[3], pid_t pgid, bool take_terminal) {
+  if (zygote_launch) {
+    int err = zygote_spawn(pid, path, args, fds, pgid, shell_is_interactive, take_terminal,
+                           shell_is_interactive);
+    if (err >= 0)
+      return err;
   }
+  return posix_spawn(pid, path, actions, attr, args, environ);
 }
 
-int main(unused int argc, unused char* argv[]) {
-  init_shell();
+/* Starts a program segment with posix_spawn, the fast path for external commands. glibc
+ * runs the child on the parent's memory (CLONE_VM | CLONE_VFORK) until it execs, so nothing
+ * is copied however large the shell's heap is. Whatever the fork path does in the child is
+ * expressed as spawn attributes and file actions instead: pipe ends and redirections become
+ * dup2 actions, the process group and default signal dispositions become attributes, and
+ * the first process of a foreground job takes the terminal with a tcsetpgrp action.
+ * Redirected files are opened by the parent so their errors can be told apart from exec's.
+ *
+ * in_fd and out_fd are the segment's pipe ends, or -1; close_fds are every pipe fd, to be
+ * closed in the child; pgid is the job's process group, or 0 for a new one. Returns the
+ * child's pid, or -1 after printing why it could not be started. */
+pid_t spawn_segment(struct tokens* tokens, int start, int end, int in_fd, int out_fd, pid_t pgid,
+                    bool foreground, int* close_fds, int n_close) {
+  size_t n_tokens = end - start;
+  char** args = malloc((n_tokens + 1) * sizeof(char*));
+  char* input_file;
+  char* output_file;
+  int input_fd = -1, output_fd = -1;
+  pid_t pid = -1;
+  if (parse_segment(tokens, start, end, args, &input_file, &output_file) < 0 || args[0] == NULL) {
+    free(args);
+    return -1;
+  }
 
-  static char line[4096];
-  int line_num = 0;
+  // names were resolved into the command hash table by resolve_segment() before this call,
+  // except those found through a relative $PATH entry, which are searched again
+  char* prog = args[0];
+  char found[4096];
+  const char* path = strchr(prog, '/') != NULL ? prog : hash_find(prog);
+  if (path == NULL && path_search(prog, found, sizeof(found)) == 0)
+    path = found;
+  if (path == NULL) {
+    fprintf(stderr, "%s: command not found\n", prog);
+    free(args);
+    return -1;
+  }
+  if (input_file && (input_fd = open(input_file, O_RDONLY | O_CLOEXEC)) == -1) {
+    perror("open input file failed");
+    free(args);
+    return -1;
+  }
+  if (output_file &&
+      (output_fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) == -1) {
+    perror("open output file failed");
+    if (input_fd >= 0)
+      close(input_fd);
+    free(args);
+    return -1;
+  }
 
-  /* Please only print shell prompts when standard input is not a tty */
-  if (shell_is_interactive)
-    fprintf(stdout, "%d: ", line_num);
+  // the same order as the fork path: pipe ends first, then redirections override them
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (in_fd >= 0)
+    posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+  if (out_fd >= 0)
+    posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+  for (int k = 0; k < n_close; k++)
+    posix_spawn_file_actions_addclose(&actions, close_fds[k]);
+  if (input_fd >= 0)
+    posix_spawn_file_actions_adddup2(&actions, input_fd, STDIN_FILENO);
+  if (output_fd >= 0)
+    posix_spawn_file_actions_adddup2(&actions, output_fd, STDOUT_FILENO);
+
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  if (shell_is_interactive) {
+    // a new process group for the job, and the signals the shell ignores back to default
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGQUIT);
+    sigaddset(&defaults, SIGTSTP);
+    sigaddset(&defaults, SIGTTIN);
+    sigaddset(&defaults, SIGTTOU);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setpgroup(&attr, pgid);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF);
+#if __GLIBC_PREREQ(2, 35)
+    // older glibc has no such action; the parent's tcsetpgrp() after spawning then suffices
+    if (pgid == 0 && foreground)
+      posix_spawn_file_actions_addtcsetpgrp_np(&actions, shell_terminal);
+#endif
+  }
+
+  // what the file actions leave on 0, 1 and 2, for the launch helper
+  int fds[3] = {input_fd >= 0 ? input_fd : in_fd >= 0 ? in_fd : STDIN_FILENO,
+                output_fd >= 0 ? output_fd : out_fd >= 0 ? out_fd : STDOUT_FILENO, STDERR_FILENO};
+  bool take_terminal = pgid == 0 && foreground;
+
+  int err = launch_path(&pid, path, args, &actions, &attr, fds, pgid, take_terminal);
+  // the remembered location has gone: forget it and search $PATH again
+  if (err == ENOENT && path != prog) {
+    hash_forget(prog);
+    path = hash_lookup(prog);
+    if (path != NULL)
+      err = launch_path(&pid, path, args, &actions, &attr, fds, pgid, take_terminal);
+  }
+  if (path == NULL) {
+    fprintf(stderr, "%s: command not found\n", prog);
+    pid = -1;
+  } else if (err != 0) {
+    fprintf(stderr, "%s: %s\n", path, strerror(err));
+    pid = -1;
+  }
+
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+  if (input_fd >= 0)
+    close(input_fd);
+  if (output_fd >= 0)
+    close(output_fd);
+  free(args);
+  return pid;
+}
+
+/* Starts one job of `parallel` with fork and exec_process, like a segment of a command line,
+ * but with its stdout and stderr on the given pipes */
+pid_t launch_parallel_job(struct tokens* command, int out_fd, int err_fd) {
+  size_t n_tokens = tokens_get_length(command);
+  fflush(stdout);
+  hash_begin_launch();
+  resolve_segment(command, 0, n_tokens);
+  pid_t pid = fork();
+  if (pid == 0) {
+    // the jobs stay in the shell's process group, so Ctrl-C reaches all of them
+    if (shell_is_interactive)
+      default_signals();
+    dup2(out_fd, STDOUT_FILENO);
+    dup2(err_fd, STDERR_FILENO);
+    exec_process(command, 0, n_tokens);
+  } else if (pid < 0) {
+    perror("fork failed");
+  }
+  hash_end_launch();
+  return pid;
+}
+
+/* Runs a command once per argument with at most N running at a time; the arguments follow
+ * ::: or are read from stdin, one per line */
+int cmd_parallel(struct tokens* tokens) {
+  size_t n_tokens = tokens_get_length(tokens);
+  long max_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t i = 1;
+  char* option = tokens_get_token(tokens, i);
+  if (option != NULL && strncmp(option, "-j", 2) == 0) {
+    char* value = option[2] != '\0' ? option + 2 : tokens_get_token(tokens, ++i);
+    max_jobs = value != NULL ? atol(value) : 0;
+    i++;
+  }
+
+  size_t template_start = i;
+  while (i < n_tokens && strcmp(tokens_get_token(tokens, i), ":::") != 0)
+    i++;
+  size_t n_template = i - template_start;
+  if (max_jobs < 1 || n_template == 0) {
+    fprintf(stderr, "usage: parallel [-j N] command [args with {}]... [::: args...]\n");
+    return -1;
+  }
+
+  char** template = malloc(n_template * sizeof(char*));
+  for (size_t k = 0; k < n_template; k++)
+    template[k] = tokens_get_token(tokens, template_start + k);
+  char** args;
+  size_t n_args;
+  bool from_stdin = i == n_tokens;
+  if (from_stdin) {
+    args = parallel_read_args(STDIN_FILENO, &n_args);
+  } else {
+    n_args = n_tokens - i - 1;
+    args = malloc((n_args + 1) * sizeof(char*));
+    for (size_t k = 0; k < n_args; k++)
+      args[k] = tokens_get_token(tokens, i + 1 + k);
+  }
+
+  int failed = parallel_run(template, n_template, args, n_args, max_jobs, launch_parallel_job);
+
+  if (from_stdin)
+    for (size_t k = 0; k < n_args; k++)
+      free(args[k]);
+  free(args);
+  free(template);
+  return failed;
+}
+
+/* Joins words start to end - 1 of a command line, for job listings */
+char* command_text(struct tokens* tokens, size_t start, size_t end) {
+  size_t length = 1;
+  for (size_t i = start; i < end; i++)
+    length += strlen(tokens_get_token(tokens, i)) + 1;
+  char* text = malloc(length);
+  text[0] = '\0';
+  char* tail = text;
+  for (size_t i = start; i < end; i++)
+    tail += sprintf(tail, i == start ? "%s" : " %s", tokens_get_token(tokens, i));
+  return text;
+}
+
+/* `time` is a prefix taken off when a command line is parsed, so only a pipeline segment gets here */
+int cmd_time(unused struct tokens* tokens) {
+  fprintf(stderr, "time: only the start of a command line can be timed\n");
+  return 1;
+}
 
-  while (fgets(line, 4096, stdin)) {
-    /* Split our line into words. */
-    struct tokens* tokens = tokenize(line);
-    size_t n_tokens = tokens_get_length(tokens);
+/* Runs a built-in in the shell itself, reporting the shell's own usage while it ran if timed.
+ * Returns what the built-in returned */
+int run_builtin(int fundex, struct tokens* tokens, char* command, bool timed,
+                 const char* time_file) {
+  if (!timed)
+    return cmd_table[fundex].fun(tokens);
+
+  job_proc_t proc;
+  memset(&proc, 0, sizeof(proc));
+  proc.pid = getpid();
+  proc.command = command;
+  struct rusage before;
+  getrusage(RUSAGE_SELF, &before);
+  clock_gettime(CLOCK_MONOTONIC, &proc.started);
+  int result = cmd_table[fundex].fun(tokens);
+  clock_gettime(CLOCK_MONOTONIC, &proc.ended);
+  getrusage(RUSAGE_SELF, &proc.usage);
+  proc.status = W_EXITCODE(result & 0xff, 0);
+
+  // everything but the peak, which is the shell's own, counts only what the built-in did
+  timersub(&proc.usage.ru_utime, &before.ru_utime, &proc.usage.ru_utime);
+  timersub(&proc.usage.ru_stime, &before.ru_stime, &proc.usage.ru_stime);
+  proc.usage.ru_nvcsw -= before.ru_nvcsw;
+  proc.usage.ru_nivcsw -= before.ru_nivcsw;
+  proc.usage.ru_minflt -= before.ru_minflt;
+  proc.usage.ru_majflt -= before.ru_majflt;
+  usage_report(command, &proc, 1, time_file);
+  return result;
+}
 
-    /* Check for pipes */
-    int n_pipes = 0;
-    for (size_t i = 0; i < n_tokens; i++) {
-      if (strcmp(tokens_get_token(tokens, i), "|") == 0) n_pipes++;
+/* Returns the next line of input, without its newline, or NULL at end of input. The line
+ * stays valid until the next call. While no complete line has arrived, children that change
+ * state are reaped as soon as SIGCHLD says so, not only after the next command. */
+char* read_line(void) {
+  static char* buffer;
+  static size_t capacity, start, end;
+  static bool at_eof;
+
+  for (;;) {
+    char* newline = memchr(buffer + start, '\n', end - start);
+    if (newline != NULL || (at_eof && start < end)) {
+      char* line = buffer + start;
+      if (newline == NULL)
+        newline = buffer + end;
+      *newline = '\0';
+      start = newline - buffer + 1;
+      if (start > end)
+        start = end;
+      return line;
     }
-    
-    /* Check for background execution */
-    bool background = false;
-    if (n_tokens > 0 && strcmp(tokens_get_token(tokens, n_tokens - 1), "&") == 0) {
-        background = true;
-        n_tokens--; // remove the & token from processing
+    if (at_eof)
+      return NULL;
+
+    // keep the partial line at the front and leave room to read more (and for a terminator)
+    memmove(buffer, buffer + start, end - start);
+    end -= start;
+    start = 0;
+    if (end + 1 >= capacity) {
+      capacity = capacity ? capacity * 2 : 4096;
+      buffer = realloc(buffer, capacity);
+      if (buffer == NULL) {
+        perror("realloc");
+        exit(1);
+      }
     }
 
-    // if there are no pipes, execute the command directly
-    if (n_pipes == 0) {
-        /* Find which built-in function to run. */
-        int fundex = lookup(tokens_get_token(tokens, 0));
-        if (fundex >= 0) {
-          cmd_table[fundex].fun(tokens);
-        } else {
-          pid_t pid = fork();
-          if (pid == 0) {
-            if (shell_is_interactive) {
-              // create a new process group, and the child process becomes the group leader
-              setpgid(pid, pid);
-              // give control to the child process only if foreground
-              if (!background) {
-                  tcsetpgrp(shell_terminal, getpid());
-              }
-              // restore the default signal handlers
-              signal(SIGINT, SIG_DFL);
-              signal(SIGQUIT, SIG_DFL);
-              signal(SIGTSTP, SIG_DFL);
-              signal(SIGTTIN, SIG_DFL);
-              signal(SIGTTOU, SIG_DFL);
-            }
-            exec_process(tokens, 0, n_tokens);
-          } else if (pid > 0) {
-            add_process(pid); // Track process
-            if (shell_is_interactive) {
-              // ensure the child process is in the same process group as the shell process
-              setpgid(pid, pid);
-              // give control to the child process only if foreground
-              if (!background) {
-                  tcsetpgrp(shell_terminal, pid);
-              }
+    // stdio flushed the prompt before reading stdin; read() does not
+    fflush(stdout);
+    struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {jobs_signal_fd(), POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("poll");
+      exit(1);
+    }
+    if (fds[1].revents & POLLIN)
+      jobs_reap();
+    if (fds[0].revents) {
+      ssize_t n = read(STDIN_FILENO, buffer + end, capacity - end - 1);
+      if (n > 0)
+        end += n;
+      else if (n == 0 || errno != EINTR)
+        at_eof = true;
+    }
+  }
+}
+
+/* Runs one pipeline of a command list and returns its status: a built-in's, the last
+ * process's exit code for a foreground job, 127 if nothing could be started, 0 otherwise */
+int run_pipeline(script_pipeline_t* pipeline) {
+  struct tokens* tokens = pipeline->tokens;
+  size_t n_tokens = tokens_get_length(tokens);
+  bool background = pipeline->background;
+  bool timed = pipeline->timed;
+  const char* time_file = pipeline->time_file;
+  if (n_tokens == 0) {
+    // a bare `time`
+    fprintf(stderr, "usage: time [-o file] command [| command]...\n");
+    return 2;
+  }
+
+  /* Check for pipes: the only operator left in a pipeline, and not a quoted "|" */
+  int n_pipes = 0;
+  for (size_t i = 0; i < n_tokens; i++) {
+    if (tokens_is_operator(tokens, i)) n_pipes++;
+  }
+  int status = 0;
+  char* command = command_text(tokens, 0, n_tokens);
+
+  // if there are no pipes, execute the command directly
+  if (n_pipes == 0) {
+      /* Find which built-in function to run. */
+      int fundex = lookup(tokens_get_token(tokens, 0));
+      if (fundex >= 0) {
+        status = run_builtin(fundex, tokens, command, timed, time_file) == 0 ? 0 : 1;
+      } else {
+        // a child that exits without exec'ing would flush a second copy of buffered output
+        fflush(stdout);
+        hash_begin_launch();
+        resolve_segment(tokens, 0, n_tokens);
+        job_t* job = job_create(command, background, shell_is_interactive);
+        job->timed = timed;
+        job->time_file = time_file ? strdup(time_file) : NULL;
+        pid_t pid = spawn_launch ? spawn_segment(tokens, 0, n_tokens, -1, -1, 0, !background, NULL, 0)
+                                 : fork();
+        if (pid == 0) {
+          if (shell_is_interactive) {
+            // create a new process group, and the child process becomes the group leader
+            setpgid(pid, pid);
+            // give control to the child process only if foreground
+            if (!background) {
+                tcsetpgrp(shell_terminal, getpid());
             }
-            
+            // restore the default signal handlers
+            default_signals();
+          }
+          exec_process(tokens, 0, n_tokens);
+        } else if (pid > 0) {
+          job_add_process(job, pid, command); // Track process
+          if (shell_is_interactive) {
+            // ensure the child process is in the same process group as the shell process
+            setpgid(pid, pid);
+            // give control to the child process only if foreground
             if (!background) {
-                int status;
-                waitpid(pid, &status, WUNTRACED); // Wait and check if stopped
-                
-                // give control back to the shell process group
-                if (shell_is_interactive) {
-                  tcsetpgrp(shell_terminal, shell_pgid);
-                  tcsetattr(shell_terminal, TCSADRAIN, &shell_tmodes);
-                }
-
-                if (WIFSTOPPED(status)) {
-                     process_t *proc = find_process(pid);
-                     if (proc) proc->running = false;
-                     printf("[%d] Stopped\n", pid);
-                } else if (WIFEXITED(status) || WIFSIGNALED(status)) {
-                     remove_process(pid);
-                }
-            } else {
-                // Background process: print info
-                printf("[%d] Background\n", pid);
+                tcsetpgrp(shell_terminal, pid);
             }
+          }
+          hash_end_launch();
+
+          if (!background) {
+              // Wait and check if stopped, then give control back to the shell
+              status = wait_foreground(job);
           } else {
-            perror("fork failed");
+              // Background job: print its number and process group
+              printf("[%d] %d\n", job->id, job->pgid);
           }
+        } else {
+          if (!spawn_launch)
+            perror("fork failed");
+          hash_end_launch();
+          job_remove(job);
+          status = 127;
         }
-    } else {
-        /* Pipeline execution */
-        int n_cmds = n_pipes + 1;
-        int pipefds[2 * n_pipes];
-        for (int i = 0; i < n_pipes; i++) {
-           // create a pipe for each command
-           // pipefds + i * 2 is the file descriptor for the input of the pipe
-           // pipefds[i * 2 + 1] is the file descriptor for the output of the pipe
-           if (pipe(pipefds + i * 2) < 0) {
-               perror("pipe");
-               exit(1);
-           }
-        }
-
-        int start = 0;
-        int cmd_idx = 0;
-        pid_t first_pid = 0;
+      }
+  } else {
+      /* Pipeline execution */
+      int n_cmds = n_pipes + 1;
+      int pipefds[2 * n_pipes];
+      for (int i = 0; i < n_pipes; i++) {
+         // create a pipe for each command
+         // pipefds + i * 2 is the file descriptor for the input of the pipe
+         // pipefds[i * 2 + 1] is the file descriptor for the output of the pipe
+         if (pipe(pipefds + i * 2) < 0) {
+             perror("pipe");
+             exit(1);
+         }
+      }
 
-        for (size_t i = 0; i <= n_tokens; i++) {
-           // if the current token is a pipe or the end of the tokens
-           if (i == n_tokens || strcmp(tokens_get_token(tokens, i), "|") == 0) {
-               pid_t pid = fork();
-               if (pid == 0) {
-                   if (shell_is_interactive) {
-                     // set the process group id to the first command's process group id
-                     pid_t pid_to_set = (first_pid == 0) ? getpid() : first_pid;
-                     setpgid(getpid(), pid_to_set);
-                     // if the command is the first command and not background, 
-                     // give control to the child process
-                     if (first_pid == 0 && !background) {
-                       tcsetpgrp(shell_terminal, pid_to_set);
-                     }
-                     // restore the default signal handlers
-                     signal(SIGINT, SIG_DFL);
-                     signal(SIGQUIT, SIG_DFL);
-                     signal(SIGTSTP, SIG_DFL);
-                     signal(SIGTTIN, SIG_DFL);
-                     signal(SIGTTOU, SIG_DFL);
+      int start = 0;
+      int cmd_idx = 0;
+      int n_launched = 0;
+      pid_t first_pid = 0;
+      fflush(stdout);
+      hash_begin_launch();
+      job_t* job = job_create(command, background, shell_is_interactive);
+      job->timed = timed;
+      job->time_file = time_file ? strdup(time_file) : NULL;
+
+      for (size_t i = 0; i <= n_tokens; i++) {
+         // if the current token is a pipe or the end of the tokens
+         if (i == n_tokens || tokens_is_operator(tokens, i)) {
+             resolve_segment(tokens, start, i);
+             // built-ins in a pipeline still need a forked copy of the shell to run in
+             bool spawn = spawn_launch && lookup(segment_program(tokens, start, i)) < 0;
+             pid_t pid;
+             if (spawn) {
+                 int in_fd = cmd_idx > 0 ? pipefds[(cmd_idx - 1) * 2] : -1;
+                 int out_fd = cmd_idx < n_cmds - 1 ? pipefds[cmd_idx * 2 + 1] : -1;
+                 pid = spawn_segment(tokens, start, i, in_fd, out_fd, first_pid, !background,
+                                     pipefds, 2 * n_pipes);
+             } else {
+                 pid = fork();
+             }
+             if (pid < 0) {
+                 if (!spawn)
+                     perror("fork failed");
+                 start = i + 1;
+                 cmd_idx++;
+                 continue;
+             }
+             n_launched++;
+             if (pid > 0) {
+                 char* stage = command_text(tokens, start, i);
+                 job_add_process(job, pid, stage);
+                 free(stage);
+             }
+             if (pid == 0) {
+                 if (shell_is_interactive) {
+                   // set the process group id to the first command's process group id
+                   pid_t pid_to_set = (first_pid == 0) ? getpid() : first_pid;
+                   setpgid(getpid(), pid_to_set);
+                   // if the command is the first command and not background, 
+                   // give control to the child process
+                   if (first_pid == 0 && !background) {
+                     tcsetpgrp(shell_terminal, pid_to_set);
                    }
+                   // restore the default signal handlers
+                   default_signals();
+                 }
+
+                 // if the current command is not the first command, redirect the input from the previous command
+                 if (cmd_idx > 0) {
+                     dup2(pipefds[(cmd_idx - 1) * 2], STDIN_FILENO);
+                 }
+                 // if the current command is not the last command, redirect the output to the next command
+                 if (cmd_idx < n_cmds - 1) {
+                     dup2(pipefds[cmd_idx * 2 + 1], STDOUT_FILENO);
+                 }
+                 // close all the file descriptors for the pipes
+                 // avoid file descriptor leak
+                 for (int k = 0; k < 2 * n_pipes; k++) {
+                     close(pipefds[k]);
+                 }
+                 exec_process(tokens, start, i);
+             }
+             
+             if (shell_is_interactive) {
+                 // if the first command, set the process group id to the child process
+                 // and give control to the child process if not background
+                 if (first_pid == 0) {
+                     first_pid = pid;
+                     setpgid(pid, pid);
+                     if (!background) {
+                         tcsetpgrp(shell_terminal, pid);
+                     }
+                 } else { 
+                     // if the command is not the first command, 
+                     // set the process group id to the first command's process group id
+                     setpgid(pid, first_pid);
+                 }
+             }
 
-                   // if the current command is not the first command, redirect the input from the previous command
-                   if (cmd_idx > 0) {
-                       dup2(pipefds[(cmd_idx - 1) * 2], STDIN_FILENO);
-                   }
-                   // if the current command is not the last command, redirect the output to the next command
-                   if (cmd_idx < n_cmds - 1) {
-                       dup2(pipefds[cmd_idx * 2 + 1], STDOUT_FILENO);
-                   }
-                   // close all the file descriptors for the pipes
-                   // avoid file descriptor leak
-                   for (int k = 0; k < 2 * n_pipes; k++) {
-                       close(pipefds[k]);
-                   }
-                   exec_process(tokens, start, i);
-               }
-               
-               if (shell_is_interactive) {
-                   // if the first command, set the process group id to the child process
-                   // and give control to the child process if not background
-                   if (first_pid == 0) {
-                       first_pid = pid;
-                       setpgid(pid, pid);
-                       if (!background) {
-                           tcsetpgrp(shell_terminal, pid);
-                       }
-                   } else { 
-                       // if the command is not the first command, 
-                       // set the process group id to the first command's process group id
-                       setpgid(pid, first_pid);
-                   }
-               }
+             start = i + 1;
+             cmd_idx++;
+         }
+      }
 
-               start = i + 1;
-               cmd_idx++;
-           }
-        }
+       // in the parent process
+       // close all the file descriptors for the pipes
+      for (int k = 0; k < 2 * n_pipes; k++) {
+          close(pipefds[k]);
+      }
+      hash_end_launch();
+
+      if (n_launched == 0) {
+          job_remove(job);
+          status = 127;
+      } else if (!background) {
+          // wait for all the commands to finish or stop
+          status = wait_foreground(job);
+      } else {
+          printf("[%d] %d\n", job->id, job->pgid);
+      }
+  }
+  free(command);
 
-         // in the parent process
-         // close all the file descriptors for the pipes
-        for (int k = 0; k < 2 * n_pipes; k++) {
-            close(pipefds[k]);
-        }
-        
-        if (!background) {
-             // wait for all the commands to finish
-            for (int k = 0; k < n_cmds; k++) {
-                waitpid(-1, NULL, 0);
-            }
-            
-            if (shell_is_interactive) {
-                tcsetpgrp(shell_terminal, shell_pgid);
-            }
-        } else {
-            // For pipeline, technically should track the PGID (first_pid)
-             printf("[%d] Background Pipeline\n", first_pid);
-             add_process(first_pid); // Simply tracking leader for now
-        }
+  // report background jobs that finished while this command ran
+  jobs_reap();
+  jobs_notify(shell_is_interactive ? stdout : NULL);
+  return status;
+}
+
+/* Runs the commands in a file, parsed once and reused while the file is unchanged */
+int cmd_source(struct tokens* tokens) {
+  char* path = tokens_get_token(tokens, 1);
+  if (path == NULL) {
+    fprintf(stderr, "usage: source file\n");
+    return 2;
+  }
+  script_t* script = script_load(path);
+  if (script == NULL)
+    return 1;
+  int status = script_run(script, run_pipeline);
+  script_release(script);
+  return status;
+}
+
+int main(int argc, char* argv[]) {
+  if (zygote_requested(argc, argv))
+    return zygote_main(argc, argv);
+
+  int opt;
+  while ((opt = getopt(argc, argv, "+fz")) != -1) {
+    switch (opt) {
+      case 'f':
+        spawn_launch = false;
+        break;
+      case 'z':
+        zygote_launch = true;
+        break;
+      default:
+        fprintf(stderr, "usage: %s [-f | -z] [script]\n", argv[0]);
+        return 1;
     }
+  }
+
+  // a script runs without job control or prompts even from a terminal
+  bool running_script = optind < argc;
+  init_shell(running_script);
+  jobs_init();
+  // a fresh image of this program, so the helper stays small whatever the shell's heap holds
+  if (zygote_launch && spawn_launch && zygote_start("/proc/self/exe") < 0)
+    zygote_launch = false;
+
+  if (running_script) {
+    script_t* script = script_load(argv[optind]);
+    if (script == NULL)
+      return 2;
+    int status = script_run(script, run_pipeline);
+    script_release(script);
+    return status;
+  }
+
+  char* line;
+  int line_num = 0;
+
+  /* Please only print shell prompts when standard input is not a tty */
+  if (shell_is_interactive)
+    fprintf(stdout, "%d: ", line_num);
+
+  while ((line = read_line()) != NULL) {
+    /* Split our line into pipelines and run them */
+    script_t* list = script_parse(line, NULL);
+    if (list != NULL) {
+      script_run(list, run_pipeline);
+      script_release(list);
+    }
+
+    // an empty line still reports background jobs that have finished
+    jobs_reap();
+    jobs_notify(shell_is_interactive ? stdout : NULL);
 
     if (shell_is_interactive)
       /* Please only print shell prompts when standard input is not a tty */
       fprintf(stdout, "%d: ", ++line_num);
-
-    /* Clean up memory */
-    tokens_destroy(tokens);
   }
 
   return 0;
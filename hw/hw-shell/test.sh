@@ -120,3 +120,256 @@ else
     echo "Foreground/Background Switching test failed"
     exit 1
 fi
+
+echo "Testing Command Hash"
+# The second ls is served from the table; hash -r empties it
+SHELL_HASH=`printf "ls > /dev/null\nls > /dev/null\nhash\nhash -r\nhash\n" | ./shell`
+if ! printf "%s\n" "$SHELL_HASH" | grep -q "^   2	/.*/ls$" ||
+    ! printf "%s\n" "$SHELL_HASH" | grep -q "hash table empty"; then
+    echo "Command Hash failed"
+    printf "%s\n" "Received: ${SHELL_HASH}"
+    exit 1
+fi
+# A remembered command that disappears is forgotten and found again in $PATH
+HASH_DIR=`mktemp -d`
+mkdir "$HASH_DIR/first" "$HASH_DIR/second"
+printf '#!/bin/sh\necho first\n' > "$HASH_DIR/first/hashcmd"
+printf '#!/bin/sh\necho second\n' > "$HASH_DIR/second/hashcmd"
+chmod +x "$HASH_DIR"/*/hashcmd
+SHELL_MOVED=`printf "hashcmd\nrm $HASH_DIR/first/hashcmd\nhashcmd\nhashcmd\nhash\n" | PATH="$HASH_DIR/first:$HASH_DIR/second:$PATH" ./shell`
+rm -r "$HASH_DIR"
+if ! printf "%s\n" "$SHELL_MOVED" | grep -q "^second$" ||
+    ! printf "%s\n" "$SHELL_MOVED" | grep -q "second/hashcmd$"; then
+    echo "Command Hash failed"
+    printf "%s\n" "Received: ${SHELL_MOVED}"
+    exit 1
+fi
+# A command found through a relative $PATH entry is not remembered, but still runs
+HASH_DIR=`mktemp -d`
+printf '#!/bin/sh\necho relative\n' > "$HASH_DIR/relcmd"
+chmod +x "$HASH_DIR/relcmd"
+SHELL_RELATIVE=`cd "$HASH_DIR" && printf "relcmd\nrelcmd | cat\n" | PATH=".:$PATH" "$OLDPWD/shell"`
+rm -r "$HASH_DIR"
+if [ "$SHELL_RELATIVE" != "relative
+relative" ]; then
+    echo "Command Hash failed"
+    printf "%s\n" "Expected: relative (twice)" "Received: ${SHELL_RELATIVE}"
+    exit 1
+fi
+# A built-in in a background pipeline does not hold up the next command
+START=`date +%s%N`
+printf "parallel -j 1 sleep {} ::: 2 | cat &\n" | ./shell > /dev/null 2>&1
+ELAPSED=$(( (`date +%s%N` - START) / 1000000 ))
+if [ "$ELAPSED" -ge 1500 ]; then
+    echo "Command Hash failed"
+    printf "%s\n" "Expected: the shell to finish at once" "Received: ${ELAPSED} ms"
+    exit 1
+fi
+echo "Command Hash passed"
+
+echo "Testing Fork Launch"
+# The tests above start commands with posix_spawn; -f must behave the same
+SHELL_FORK=`printf "ls | wc -l\necho hello > test_fork.txt\ncat < test_fork.txt\n" | ./shell -f`
+rm -f test_fork.txt
+SHELL_SPAWN=`printf "ls | wc -l\necho hello > test_fork.txt\ncat < test_fork.txt\n" | ./shell`
+rm -f test_fork.txt
+if [ "$SHELL_FORK" != "$SHELL_SPAWN" ]; then
+    echo "Fork Launch failed"
+    printf "%s\n" \
+    "Expected: ${SHELL_SPAWN}" \
+    "Received: ${SHELL_FORK}"
+    exit 1
+fi
+echo "Fork Launch passed"
+
+echo "Testing Long Lines"
+# A multi-megabyte line of three million words, then a 100000-character argument
+LONG_INPUT=`mktemp`
+{
+    printf "cd / "
+    head -c 6000000 /dev/zero | tr '\0' 'x' | sed 's/xx/x /g'
+    printf "\npwd\n"
+    printf "echo %s 'a  b' c\\\\ d\n" "$(head -c 100000 /dev/zero | tr '\0' 'y')"
+} > "$LONG_INPUT"
+SHELL_LONG=`timeout 10 ./shell < "$LONG_INPUT" | awk '{ print length($0) }' | tr '\n' ' '`
+rm "$LONG_INPUT"
+if [ "$SHELL_LONG" != "1 100009 " ]; then
+    echo "Long Lines failed"
+    printf "%s\n" \
+    "Expected: 1 100010 " \
+    "Received: ${SHELL_LONG}"
+    exit 1
+fi
+echo "Long Lines passed"
+
+echo "Testing Job Table"
+# Background jobs that finish while the shell waits for input are reaped at once
+{
+    for i in 1 2 3 4 5; do
+        echo "sleep 0.1 &"
+    done
+    sleep 1
+    echo "exit"
+} | ./shell > /dev/null &
+JOBS_SHELL=$!
+sleep 0.7
+ZOMBIES=`ps --ppid $JOBS_SHELL -o stat= | grep -c Z`
+wait $JOBS_SHELL
+if [ "$ZOMBIES" != "0" ]; then
+    echo "Job Table failed"
+    printf "%s\n" \
+    "Expected: no zombies" \
+    "Received: ${ZOMBIES} zombies"
+    exit 1
+fi
+# %N picks a job by number; fg waits for it and forgets it
+SHELL_JOBS=`printf "sleep 0.2 &\nsleep 0.5 &\nfg %%1\njobs\n" | ./shell | sed 's/^\[\([0-9]\)\] [0-9]*$/[\1] pid/'`
+EXPECTED_JOBS=`printf "[1] pid\n[2] pid\n[2]+ Running  sleep 0.5"`
+if [ "$SHELL_JOBS" != "$EXPECTED_JOBS" ]; then
+    echo "Job Table failed"
+    printf "%s\n" \
+    "Expected: ${EXPECTED_JOBS}" \
+    "Received: ${SHELL_JOBS}"
+    exit 1
+fi
+echo "Job Table passed"
+
+echo "Testing Parallel"
+# Output comes back in argument order even when later jobs finish first
+SHELL_PARALLEL=`echo 'parallel -j 3 sh -c "sleep 0.{}; echo {}" ::: 3 1 2' | ./shell 2> /dev/null | tr '\n' ' '`
+if [ "$SHELL_PARALLEL" != "3 1 2 " ]; then
+    echo "Parallel failed"
+    printf "%s\n" \
+    "Expected: 3 1 2 " \
+    "Received: ${SHELL_PARALLEL}"
+    exit 1
+fi
+# Four half-second jobs with -j 4 run together; each gets a status report
+START=`date +%s%N`
+SHELL_PARALLEL=`echo 'parallel -j 4 sleep ::: 0.5 0.5 0.5 0.5' | ./shell 2>&1 | grep -c ': exit 0, 0.5'`
+ELAPSED=$(( (`date +%s%N` - START) / 1000000 ))
+if [ "$SHELL_PARALLEL" != "4" ] || [ "$ELAPSED" -ge 1500 ]; then
+    echo "Parallel failed"
+    printf "%s\n" \
+    "Expected: 4 reports in under 1500 ms" \
+    "Received: ${SHELL_PARALLEL} reports in ${ELAPSED} ms"
+    exit 1
+fi
+# Arguments can come from standard input, one per line
+PARALLEL_ARGS=`mktemp`
+printf "a\nb\n" > "$PARALLEL_ARGS"
+SHELL_PARALLEL=`echo "cat $PARALLEL_ARGS | parallel -j 2 echo got" | ./shell 2> /dev/null | tr '\n' ' '`
+rm "$PARALLEL_ARGS"
+if [ "$SHELL_PARALLEL" != "got a got b " ]; then
+    echo "Parallel failed"
+    printf "%s\n" \
+    "Expected: got a got b " \
+    "Received: ${SHELL_PARALLEL}"
+    exit 1
+fi
+echo "Parallel passed"
+
+echo "Testing Time"
+# One report row per pipeline stage plus a total, after the pipeline's own output
+SHELL_TIME=`echo "time echo hi | cat | wc -c" | ./shell 2>&1 | awk '{ print $1 }' | tr '\n' ' '`
+if [ "$SHELL_TIME" != "3 stage 1 2 3 total " ]; then
+    echo "Time failed"
+    printf "%s\n" \
+    "Expected: 3 stage 1 2 3 total " \
+    "Received: ${SHELL_TIME}"
+    exit 1
+fi
+# -o appends one tab-separated line per stage, under a header, with exit status and wall time
+TIME_FILE=`mktemp`
+rm "$TIME_FILE"
+printf "time -o $TIME_FILE sleep 0.2\ntime -o $TIME_FILE sh -c \"exit 3\" | cat\n" | ./shell > /dev/null 2>&1
+SHELL_TIME=`awk -F '\t' 'NR > 1 { printf "%s:%s:%d ", $4, $5, $6 * 10 }' "$TIME_FILE"`
+TIME_FIELDS=`head -1 "$TIME_FILE" | awk -F '\t' '{ print NF }'`
+rm -f "$TIME_FILE"
+if [ "$SHELL_TIME" != "sleep 0.2:0:2 sh -c exit 3:3:0 cat:0:0 " ] || [ "$TIME_FIELDS" != "13" ]; then
+    echo "Time failed"
+    printf "%s\n" \
+    "Expected: sleep 0.2:0:2 sh -c exit 3:3:0 cat:0:0  (13 fields)" \
+    "Received: ${SHELL_TIME} (${TIME_FIELDS} fields)"
+    exit 1
+fi
+echo "Time passed"
+
+echo "Testing Script Mode"
+# A script file runs ; && || lists, lines continued after && or ||, and comments
+SCRIPT=`mktemp`
+SOURCED=`mktemp`
+cat > "$SCRIPT" <<SCRIPT_END
+#!./shell
+# a comment
+echo one ; echo two
+false && echo never
+false || echo fallback
+true && echo yes || echo no
+false && echo skipped ||
+    echo continued
+source $SOURCED
+source $SOURCED
+sh -c "echo echo changed > $SOURCED"
+. $SOURCED
+exit 3
+echo not reached
+SCRIPT_END
+echo "echo sourced" > "$SOURCED"
+SHELL_SCRIPT=`./shell "$SCRIPT" | tr '\n' ' '`
+SHELL_SCRIPT="${SHELL_SCRIPT}status `./shell "$SCRIPT" > /dev/null; echo $?`"
+EXPECTED_SCRIPT="one two fallback yes continued sourced sourced changed status 3"
+# Nothing in a script with a syntax error runs
+printf "echo ran\necho a ; ; echo b\n" > "$SCRIPT"
+SCRIPT_ERROR=`./shell "$SCRIPT" 2>&1; echo "status $?"`
+rm "$SCRIPT" "$SOURCED"
+if [ "$SHELL_SCRIPT" != "$EXPECTED_SCRIPT" ]; then
+    echo "Script Mode failed"
+    printf "%s\n" \
+    "Expected: ${EXPECTED_SCRIPT}" \
+    "Received: ${SHELL_SCRIPT}"
+    exit 1
+fi
+EXPECTED_ERROR="${SCRIPT}: line 2: syntax error near \`;'
+status 2"
+if [ "$SCRIPT_ERROR" != "$EXPECTED_ERROR" ]; then
+    echo "Script Mode failed"
+    printf "%s\n" \
+    "Expected: ${EXPECTED_ERROR}" \
+    "Received: ${SCRIPT_ERROR}"
+    exit 1
+fi
+# Lists also work on standard input, one line at a time
+SHELL_LIST=`printf "false || echo a && echo b ; echo c\n" | ./shell | tr '\n' ' '`
+if [ "$SHELL_LIST" != "a b c " ]; then
+    echo "Script Mode failed"
+    printf "%s\n" \
+    "Expected: a b c " \
+    "Received: ${SHELL_LIST}"
+    exit 1
+fi
+# Operators need no spaces around them; quoted, they are ordinary characters
+SHELL_TIGHT=`printf "echo a;echo b\ntrue&&echo c\nfalse||echo d\necho e;\necho f|cat\necho 'g;h'\necho \";\"\necho '|'\necho i \\\\; j\necho k \"&&\" l\n" | ./shell 2>&1 | tr '\n' ' '`
+if [ "$SHELL_TIGHT" != "a b c d e f g;h ; | i ; j k && l " ]; then
+    echo "Script Mode failed"
+    printf "%s\n" \
+    "Expected: a b c d e f g;h ; | i ; j k && l " \
+    "Received: ${SHELL_TIGHT}"
+    exit 1
+fi
+echo "Script Mode passed"
+
+echo "Testing Launch Helper"
+# With -z commands come from the helper, yet are the shell's own children, in the shell's directory
+ZYGOTE_OUT=`mktemp`
+SHELL_ZYGOTE=`printf "sh -c 'ps -o comm= --ppid \\$PPID'\ncd /tmp\n/bin/pwd\necho hi | tr a-z A-Z > $ZYGOTE_OUT\ncat < $ZYGOTE_OUT\nnosuchcommand\n" | ./shell -z 2>&1 | sort | tr '\n' ' '`
+rm "$ZYGOTE_OUT"
+EXPECTED_ZYGOTE="/tmp HI nosuchcommand: command not found sh shell-zygote "
+if [ "$SHELL_ZYGOTE" != "$EXPECTED_ZYGOTE" ]; then
+    echo "Launch Helper failed"
+    printf "%s\n" \
+    "Expected: ${EXPECTED_ZYGOTE}" \
+    "Received: ${SHELL_ZYGOTE}"
+    exit 1
+fi
+echo "Launch Helper passed"
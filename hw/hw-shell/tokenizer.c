@@ -3,25 +3,40 @@
 #include <string.h>
 #include "tokenizer.h"
 
+/*
+ * All words of a line live in one arena allocated up front. Unquoting only
+ * removes characters, and each character of the line adds at most itself and
+ * one terminator, when it is an operator split from the words around it, so
+ * the words never need more than 2 * strlen(line) + 1 bytes. The array of
+ * word pointers doubles as it fills, so tokenizing is linear in the length of
+ * the line, however long it is.
+ *
+ * The operators `;`, `&`, `&&`, `|` and `||` are words of their own whether
+ * or not whitespace surrounds them, as in any shell; quoted or escaped, they
+ * are ordinary characters of a word. Since `";"` unquotes to the same word as
+ * an operator, each word is flagged with whether it is one.
+ */
 struct tokens {
   size_t tokens_length;
+  size_t tokens_capacity;
   char** tokens;
-  size_t buffers_length;
-  char** buffers;
+  bool* operators;
+  char* arena;
 };
 
-static void* vector_push(char*** pointer, size_t* size, void* elem) {
-  *pointer = (char**)realloc(*pointer, sizeof(char*) * (*size + 1));
-  (*pointer)[*size] = elem;
-  *size += 1;
-  return elem;
-}
-
-static void* copy_word(char* source, size_t n) {
-  source[n] = '\0';
-  char* word = (char*)malloc(n + 1);
-  strncpy(word, source, n + 1);
-  return word;
+static void push_token(struct tokens* tokens, char* word, bool operator) {
+  if (tokens->tokens_length == tokens->tokens_capacity) {
+    size_t capacity = tokens->tokens_capacity ? tokens->tokens_capacity * 2 : 16;
+    char** grown = (char**)realloc(tokens->tokens, capacity * sizeof(char*));
+    bool* grown_operators = (bool*)realloc(tokens->operators, capacity * sizeof(bool));
+    if (grown == NULL || grown_operators == NULL)
+      abort();
+    tokens->tokens = grown;
+    tokens->operators = grown_operators;
+    tokens->tokens_capacity = capacity;
+  }
+  tokens->operators[tokens->tokens_length] = operator;
+  tokens->tokens[tokens->tokens_length++] = word;
 }
 
 struct tokens* tokenize(const char* line) {
@@ -29,73 +44,101 @@ struct tokens* tokenize(const char* line) {
     return NULL;
   }
 
-  static char token[4096];
-  size_t n = 0, n_max = 4096;
-  struct tokens* tokens;
   size_t line_length = strlen(line);
-
-  tokens = (struct tokens*)malloc(sizeof(struct tokens));
+  struct tokens* tokens = (struct tokens*)malloc(sizeof(struct tokens));
+  char* arena = (char*)malloc(2 * line_length + 1);
+  if (tokens == NULL || arena == NULL)
+    abort();
   tokens->tokens_length = 0;
+  tokens->tokens_capacity = 0;
   tokens->tokens = NULL;
-  tokens->buffers_length = 0;
-  tokens->buffers = NULL;
+  tokens->operators = NULL;
+  tokens->arena = arena;
+
+  /* The word being built starts at word and ends at end. */
+  char* word = arena;
+  char* end = arena;
 
   const int MODE_NORMAL = 0, MODE_SQUOTE = 1, MODE_DQUOTE = 2;
   int mode = MODE_NORMAL;
 
-  for (unsigned int i = 0; i < line_length; i++) {
+  for (size_t i = 0; i < line_length; i++) {
     char c = line[i];
-    if (mode == MODE_NORMAL) {
+    if (c == '\\') {
+      if (i + 1 < line_length) {
+        *end++ = line[++i];
+      }
+    } else if (mode == MODE_NORMAL) {
       if (c == '\'') {
         mode = MODE_SQUOTE;
       } else if (c == '"') {
         mode = MODE_DQUOTE;
-      } else if (c == '\\') {
-        if (i + 1 < line_length) {
-          token[n++] = line[++i];
+      } else if (isspace((unsigned char)c)) {
+        if (end > word) {
+          *end++ = '\0';
+          push_token(tokens, word, false);
+          word = end;
         }
-      } else if (isspace(c)) {
-        if (n > 0) {
-          void* word = copy_word(token, n);
-          vector_push(&tokens->tokens, &tokens->tokens_length, word);
-          n = 0;
-        }
-      } else {
-        token[n++] = c;
-      }
-    } else if (mode == MODE_SQUOTE) {
-      if (c == '\'') {
-        mode = MODE_NORMAL;
-      } else if (c == '\\') {
-        if (i + 1 < line_length) {
-          token[n++] = line[++i];
-        }
-      } else {
-        token[n++] = c;
-      }
-    } else if (mode == MODE_DQUOTE) {
-      if (c == '"') {
-        mode = MODE_NORMAL;
-      } else if (c == '\\') {
-        if (i + 1 < line_length) {
-          token[n++] = line[++i];
+      } else if (c == ';' || c == '&' || c == '|') {
+        if (end > word) {
+          *end++ = '\0';
+          push_token(tokens, word, false);
+          word = end;
         }
+        *end++ = c;
+        if (c != ';' && i + 1 < line_length && line[i + 1] == c)
+          *end++ = line[++i];
+        *end++ = '\0';
+        push_token(tokens, word, true);
+        word = end;
       } else {
-        token[n++] = c;
+        *end++ = c;
       }
+    } else if ((mode == MODE_SQUOTE && c == '\'') || (mode == MODE_DQUOTE && c == '"')) {
+      mode = MODE_NORMAL;
+    } else {
+      *end++ = c;
     }
-    if (n + 1 >= n_max)
-      abort();
   }
 
-  if (n > 0) {
-    void* word = copy_word(token, n);
-    vector_push(&tokens->tokens, &tokens->tokens_length, word);
-    n = 0;
+  if (end > word) {
+    *end = '\0';
+    push_token(tokens, word, false);
   }
   return tokens;
 }
 
+struct tokens* tokens_create(char** words, size_t n) {
+  size_t length = 0;
+  for (size_t i = 0; i < n; i++)
+    length += strlen(words[i]) + 1;
+
+  struct tokens* tokens = (struct tokens*)malloc(sizeof(struct tokens));
+  char* arena = (char*)malloc(length + 1);
+  char** array = (char**)malloc((n + 1) * sizeof(char*));
+  bool* operators = (bool*)calloc(n + 1, sizeof(bool));
+  if (tokens == NULL || arena == NULL || array == NULL || operators == NULL)
+    abort();
+  tokens->tokens_length = n;
+  tokens->tokens_capacity = n + 1;
+  tokens->tokens = array;
+  tokens->operators = operators;
+  tokens->arena = arena;
+  for (size_t i = 0; i < n; i++) {
+    size_t len = strlen(words[i]) + 1;
+    memcpy(arena, words[i], len);
+    array[i] = arena;
+    arena += len;
+  }
+  return tokens;
+}
+
+struct tokens* tokens_slice(struct tokens* tokens, size_t start, size_t n) {
+  struct tokens* slice = tokens_create(tokens->tokens + start, n);
+  memcpy(slice->operators, tokens->operators + start, n * sizeof(bool));
+  return slice;
+}
+
 size_t tokens_get_length(struct tokens* tokens) {
   if (tokens == NULL) {
     return 0;
@@ -112,18 +155,16 @@ char* tokens_get_token(struct tokens* tokens, size_t n) {
   }
 }
 
+bool tokens_is_operator(struct tokens* tokens, size_t n) {
+  return tokens != NULL && n < tokens->tokens_length && tokens->operators[n];
+}
+
 void tokens_destroy(struct tokens* tokens) {
   if (tokens == NULL) {
     return;
   }
-  for (int i = 0; i < tokens->tokens_length; i++) {
-    free(tokens->tokens[i]);
-  }
-  for (int i = 0; i < tokens->buffers_length; i++) {
-    free(tokens->buffers[i]);
-  }
-  if (tokens->tokens) {
-    free(tokens->tokens);
-  }
+  free(tokens->tokens);
+  free(tokens->operators);
+  free(tokens->arena);
   free(tokens);
 }
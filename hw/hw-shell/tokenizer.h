@@ -1,16 +1,28 @@
 #pragma once
 
+#include <stdbool.h>
+
 /* A struct that represents a list of words. */
 struct tokens;
 
 /* Turn a string into a list of words. */
 struct tokens* tokenize(const char* line);
 
+/* Make a list of words from an array of strings, which are copied. None are operators. */
+struct tokens* tokens_create(char** words, size_t n);
+
+/* Copy the n words from the Nth on, keeping which of them are operators. */
+struct tokens* tokens_slice(struct tokens* tokens, size_t start, size_t n);
+
 /* How many words are there? */
 size_t tokens_get_length(struct tokens* tokens);
 
 /* Get me the Nth word (zero-indexed) */
 char* tokens_get_token(struct tokens* tokens, size_t n);
 
+/* Is the Nth word an operator, rather than a word that only spells one because it was
+ * quoted or escaped? */
+bool tokens_is_operator(struct tokens* tokens, size_t n);
+
 /* Free the memory */
 void tokens_destroy(struct tokens* tokens);
@@ -0,0 +1,268 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "zygote.h"
+
+#define ZYGOTE_FLAG "--zygote"
+
+/* Requests larger than this (very long argument lists) are started by the shell itself. */
+#define MAX_REQUEST (64 * 1024)
+
+/* Passed with each request: stdin, stdout, stderr and the working directory. */
+#define N_FDS 4
+
+typedef struct request {
+  pid_t pgid;
+  bool set_pgroup;
+  bool foreground;
+  bool reset_signals;
+  int n_args;
+  // followed by the path and each argument, NUL-terminated
+} request_t;
+
+typedef struct reply {
+  pid_t pid;
+  int error; // errno from exec, 0 if it succeeded
+} reply_t;
+
+/* The shell's end of the socket, or -1 without a helper. */
+static int zygote_fd = -1;
+
+int zygote_start(const char* self) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+    perror("socketpair");
+    return -1;
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    // the helper's end is the only descriptor beyond 0-2 to survive exec
+    int fd = fcntl(fds[1], F_DUPFD, 3);
+    char fd_arg[16];
+    snprintf(fd_arg, sizeof(fd_arg), "%d", fd);
+    execl(self, "shell-zygote", ZYGOTE_FLAG, fd_arg, (char*)NULL);
+    perror(self);
+    _exit(127);
+  }
+  close(fds[1]);
+  if (pid < 0) {
+    perror("fork");
+    close(fds[0]);
+    return -1;
+  }
+  zygote_fd = fds[0];
+  return 0;
+}
+
+bool zygote_requested(int argc, char* argv[]) {
+  return argc == 3 && strcmp(argv[1], ZYGOTE_FLAG) == 0;
+}
+
+/* Starts one command and waits until it has exec'd or failed to. */
+static reply_t launch(char* buffer, size_t length, int fds[N_FDS]) {
+  reply_t reply = {-1, EINVAL};
+  request_t* request = (request_t*)buffer;
+  if (length <= sizeof(request_t) || buffer[length - 1] != '\0' || request->n_args < 1)
+    return reply;
+
+  char** args = malloc((request->n_args + 1) * sizeof(char*));
+  char* path = buffer + sizeof(request_t);
+  char* next = path + strlen(path) + 1;
+  for (int i = 0; i < request->n_args; i++) {
+    if (next >= buffer + length) {
+      free(args);
+      return reply;
+    }
+    args[i] = next;
+    next += strlen(next) + 1;
+  }
+  args[request->n_args] = NULL;
+
+  // the child reports a failed exec through a close-on-exec pipe; end of file means success
+  int report[2];
+  if (pipe2(report, O_CLOEXEC) < 0) {
+    reply.error = errno;
+    free(args);
+    return reply;
+  }
+
+  // CLONE_PARENT makes the command a child of the shell rather than of the helper
+  pid_t pid = syscall(SYS_clone, CLONE_PARENT | SIGCHLD, NULL, NULL, NULL, NULL);
+  if (pid == 0) {
+    close(report[0]);
+    if (request->set_pgroup) {
+      setpgid(0, request->pgid);
+      // SIGTTOU is still ignored here, so the terminal can be taken from the background
+      if (request->foreground)
+        tcsetpgrp(STDIN_FILENO, getpgrp());
+    }
+    if (request->reset_signals) {
+      signal(SIGINT, SIG_DFL);
+      signal(SIGQUIT, SIG_DFL);
+      signal(SIGTSTP, SIG_DFL);
+      signal(SIGTTIN, SIG_DFL);
+      signal(SIGTTOU, SIG_DFL);
+    }
+    dup2(fds[0], STDIN_FILENO);
+    dup2(fds[1], STDOUT_FILENO);
+    dup2(fds[2], STDERR_FILENO);
+    if (fchdir(fds[3]) == 0)
+      execv(path, args);
+    int error = errno;
+    if (write(report[1], &error, sizeof(error)) < 0) {
+      // the helper then sees end of file and reports success; the command exits with 127
+    }
+    _exit(127);
+  }
+  close(report[1]);
+
+  if (pid < 0) {
+    reply.error = errno;
+  } else {
+    int error;
+    ssize_t n;
+    do {
+      n = read(report[0], &error, sizeof(error));
+    } while (n < 0 && errno == EINTR);
+    reply.pid = pid;
+    reply.error = n == sizeof(error) ? error : 0;
+  }
+  close(report[0]);
+  free(args);
+  return reply;
+}
+
+int zygote_main(int argc, char* argv[]) {
+  int fd = atoi(argv[2]);
+  // exec'd through /proc/self/exe, it would show up in ps as "exe"
+  prctl(PR_SET_NAME, "shell-zygote");
+  // the helper shares the shell's process group, so the terminal's signals reach it too
+  signal(SIGINT, SIG_IGN);
+  signal(SIGQUIT, SIG_IGN);
+  signal(SIGTSTP, SIG_IGN);
+  signal(SIGTTIN, SIG_IGN);
+  signal(SIGTTOU, SIG_IGN);
+
+  static char buffer[MAX_REQUEST];
+  for (;;) {
+    union {
+      char data[CMSG_SPACE(N_FDS * sizeof(int))];
+      struct cmsghdr align;
+    } control;
+    struct iovec iov = {buffer, sizeof(buffer)};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data;
+    msg.msg_controllen = sizeof(control.data);
+
+    ssize_t n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    if (n == 0)
+      return 0; // the shell has exited
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return 1;
+    }
+
+    int fds[N_FDS];
+    int n_fds = 0;
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      n_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      if (n_fds > N_FDS)
+        n_fds = N_FDS;
+      memcpy(fds, CMSG_DATA(cmsg), n_fds * sizeof(int));
+    }
+
+    reply_t reply = {-1, EINVAL};
+    if (n_fds == N_FDS && !(msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+      reply = launch(buffer, n, fds);
+    for (int i = 0; i < n_fds; i++)
+      close(fds[i]);
+    if (send(fd, &reply, sizeof(reply), MSG_NOSIGNAL) < 0)
+      return 1;
+  }
+}
+
+int zygote_spawn(pid_t* pid, const char* path, char** args, int fds[3], pid_t pgid,
+                 bool set_pgroup, bool foreground, bool reset_signals) {
+  if (zygote_fd < 0)
+    return -1;
+
+  static char buffer[MAX_REQUEST];
+  request_t* request = (request_t*)buffer;
+  request->pgid = pgid;
+  request->set_pgroup = set_pgroup;
+  request->foreground = foreground;
+  request->reset_signals = reset_signals;
+  request->n_args = 0;
+  size_t length = sizeof(request_t);
+  for (int i = -1; i < 0 || args[i] != NULL; i++) {
+    const char* word = i < 0 ? path : args[i];
+    size_t size = strlen(word) + 1;
+    if (length + size > sizeof(buffer))
+      return -1;
+    memcpy(buffer + length, word, size);
+    length += size;
+    if (i >= 0)
+      request->n_args++;
+  }
+
+  int cwd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+  if (cwd < 0)
+    return -1;
+  int sent[N_FDS] = {fds[0], fds[1], fds[2], cwd};
+  union {
+    char data[CMSG_SPACE(N_FDS * sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  memset(&control, 0, sizeof(control));
+  struct iovec iov = {buffer, length};
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data;
+  msg.msg_controllen = sizeof(control.data);
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(sent));
+  memcpy(CMSG_DATA(cmsg), sent, sizeof(sent));
+
+  ssize_t n;
+  do {
+    n = sendmsg(zygote_fd, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  close(cwd);
+
+  reply_t reply;
+  if (n == (ssize_t)length) {
+    do {
+      n = recv(zygote_fd, &reply, sizeof(reply), 0);
+    } while (n < 0 && errno == EINTR);
+  }
+  if (n != sizeof(reply)) {
+    fprintf(stderr, "launch helper has gone; starting commands directly\n");
+    close(zygote_fd);
+    zygote_fd = -1;
+    return -1;
+  }
+  if (reply.error != 0)
+    return reply.error;
+  *pid = reply.pid;
+  return 0;
+}
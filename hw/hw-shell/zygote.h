@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/*
+ * A launch helper (-z). At startup the shell forks and re-execs itself as a
+ * small process that does nothing but start commands for it: each request
+ * carries the program's path and arguments, its stdin, stdout and stderr and
+ * the shell's working directory as file descriptors, and the process group
+ * to join. The helper clones the command with CLONE_PARENT, so it is the
+ * shell's own child and is waited for like any other, and replies once it
+ * has exec'd, with its pid or the exec error.
+ *
+ * The helper's image stays a few hundred kilobytes however large the shell's
+ * heap grows, so the copy each launch makes does not grow with it.
+ */
+
+/* Starts the helper. Returns 0, or -1 if it could not be started. */
+int zygote_start(const char* self);
+
+/* Whether argv asks this process to be the helper, and its main loop if so. */
+bool zygote_requested(int argc, char* argv[]);
+int zygote_main(int argc, char* argv[]);
+
+/* Starts path with args in the helper. fds are the new process's stdin, stdout and stderr.
+ * With set_pgroup it joins process group pgid (0 for a new group of its own), and takes the
+ * terminal if foreground; with reset_signals the job-control signals go back to default.
+ * Returns 0 and sets *pid, the error exec gave (as posix_spawn does), or -1 if the helper
+ * could not take the request, in which case the caller should start the command itself. */
+int zygote_spawn(pid_t* pid, const char* path, char** args, int fds[3], pid_t pgid,
+                 bool set_pgroup, bool foreground, bool reset_signals);
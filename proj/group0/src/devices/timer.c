@@ -1,6 +1,7 @@
 #include "devices/timer.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
@@ -20,11 +21,25 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* List of threads blocked in timer_sleep(), in order of the
+   tick each is to wake at, so that timer_interrupt() only looks
+   at the threads it wakes. */
+static struct list sleep_list;
+
+/* A thread blocked in timer_sleep().  It lives on the sleeping
+   thread's own stack, as a semaphore_elem does in cond_wait(). */
+struct sleeper {
+  struct list_elem elem; /* List element for sleep_list. */
+  int64_t wakeup;        /* Tick at which to wake. */
+  struct thread* thread; /* The sleeping thread. */
+};
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static bool wakes_earlier(const struct list_elem*, const struct list_elem*, void* aux);
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
@@ -34,6 +49,7 @@ static void real_time_delay(int64_t num, int32_t denom);
    and registers the corresponding interrupt. */
 void timer_init(void) {
   pit_configure_channel(0, 2, TIMER_FREQ);
+  list_init(&sleep_list);
   intr_register_ext(0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -74,13 +90,29 @@ int64_t timer_ticks(void) {
 int64_t timer_elapsed(int64_t then) { return timer_ticks() - then; }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
-   be turned on. */
+   be turned on.
+
+   The thread is blocked, not left on the ready list, until
+   timer_interrupt() finds that its wake-up tick has come. */
 void timer_sleep(int64_t ticks) {
   int64_t start = timer_ticks();
+  struct sleeper sleeper;
+  enum intr_level old_level;
 
   ASSERT(intr_get_level() == INTR_ON);
-  while (timer_elapsed(start) < ticks)
-    thread_yield();
+  if (ticks <= 0)
+    return;
+
+  sleeper.wakeup = start + ticks;
+  sleeper.thread = thread_current();
+
+  old_level = intr_disable();
+  /* We may have been preempted for the whole interval already. */
+  if (timer_ticks() < sleeper.wakeup) {
+    list_insert_ordered(&sleep_list, &sleeper.elem, wakes_earlier, NULL);
+    thread_block();
+  }
+  intr_set_level(old_level);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -125,12 +157,40 @@ void timer_ndelay(int64_t ns) { real_time_delay(ns, 1000 * 1000 * 1000); }
 /* Prints timer statistics. */
 void timer_print_stats(void) { printf("Timer: %" PRId64 " ticks\n", timer_ticks()); }
 
-/* Timer interrupt handler. */
+/* Timer interrupt handler.  Wakes the sleepers whose time has
+   come; they are at the front of sleep_list, so this stops at the
+   first one that must sleep on.  A woken thread that outranks the
+   running one takes over on return from the interrupt. */
 static void timer_interrupt(struct intr_frame* args UNUSED) {
+  bool woke = false;
+
   ticks++;
+
+  while (!list_empty(&sleep_list)) {
+    struct sleeper* s = list_entry(list_front(&sleep_list), struct sleeper, elem);
+    if (s->wakeup > ticks)
+      break;
+    list_pop_front(&sleep_list);
+    thread_unblock(s->thread);
+    woke = true;
+  }
+  if (woke)
+    thread_check_preemption();
+
   thread_tick();
 }
 
+/* Returns true if sleeper A wakes before sleeper B.  Sleepers
+   that wake at the same tick stay in the order they went to
+   sleep. */
+static bool wakes_earlier(const struct list_elem* a_, const struct list_elem* b_,
+                          void* aux UNUSED) {
+  const struct sleeper* a = list_entry(a_, struct sleeper, elem);
+  const struct sleeper* b = list_entry(b_, struct sleeper, elem);
+
+  return a->wakeup < b->wakeup;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool too_many_loops(unsigned loops) {
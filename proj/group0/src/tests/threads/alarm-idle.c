@@ -0,0 +1,71 @@
+/* Puts N threads to sleep at once, ROUNDS times over, and counts
+   how many of the timer ticks that pass meanwhile are spent in
+   the idle thread.  Sleeping threads have nothing to run, so the
+   CPU should be idle for nearly all of them however many threads
+   are asleep. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of times each thread sleeps, and for how long. */
+#define ROUNDS 10
+#define DURATION 10
+
+static thread_func sleeper;
+static void test_alarm_idle(int thread_cnt);
+
+#define TEST(n)                                                                                    \
+  void test_alarm_idle_##n(void) { test_alarm_idle(n); }
+
+TEST(16);
+TEST(256);
+
+static struct semaphore done_sema;
+
+static void test_alarm_idle(int thread_cnt) {
+  int64_t start_ticks;
+  long long start_idle;
+  int64_t elapsed;
+  long long idle;
+  int i;
+
+  ASSERT(active_sched_policy == SCHED_FIFO);
+
+  msg("Creating %d threads to sleep %d ticks %d times each.", thread_cnt, DURATION, ROUNDS);
+  sema_init(&done_sema, 0);
+
+  /* Wait for a tick boundary so the window starts cleanly. */
+  timer_sleep(1);
+  start_ticks = timer_ticks();
+  start_idle = thread_get_idle_ticks();
+
+  for (i = 0; i < thread_cnt; i++) {
+    char name[32];
+    snprintf(name, sizeof name, "sleeper %d", i);
+    thread_create(name, PRI_DEFAULT, sleeper, NULL);
+  }
+  for (i = 0; i < thread_cnt; i++)
+    sema_down(&done_sema);
+
+  elapsed = timer_elapsed(start_ticks);
+  idle = thread_get_idle_ticks() - start_idle;
+
+  /* Benchmark output, checked against a threshold by the .ck. */
+  msg("idle ticks: %lld of %lld", idle, elapsed);
+  if (idle * 2 < elapsed)
+    fail("CPU was busy for %lld of %lld ticks while every thread slept", elapsed - idle,
+         elapsed);
+}
+
+/* Sleeper thread. */
+static void sleeper(void* aux UNUSED) {
+  int i;
+
+  for (i = 0; i < ROUNDS; i++)
+    timer_sleep(DURATION);
+  sema_up(&done_sema);
+}
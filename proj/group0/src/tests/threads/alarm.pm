@@ -29,4 +29,22 @@ sub check_alarm {
     pass;
 }
 
+sub check_alarm_idle {
+    my ($thread_cnt) = @_;
+    our ($test);
+
+    @output = read_text_file ("$test.output");
+    common_checks ("run", @output);
+
+    my ($idle, $elapsed);
+    foreach (@output) {
+	($idle, $elapsed) = /idle ticks: (\d+) of (\d+)$/;
+	last if defined $idle;
+    }
+    fail "No idle tick count in output.\n" if !defined $idle;
+    fail "CPU idle for only $idle of $elapsed ticks "
+      . "with $thread_cnt threads asleep.\n" if $idle * 2 < $elapsed;
+    pass;
+}
+
 1;
@@ -10,6 +10,8 @@ static const struct test threads_tests[] = {
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-idle-16", test_alarm_idle_16},
+    {"alarm-idle-256", test_alarm_idle_256},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
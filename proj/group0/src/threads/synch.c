@@ -32,6 +32,9 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+static bool thread_priority_less(const struct list_elem*, const struct list_elem*, void* aux);
+static bool waiter_priority_less(const struct list_elem*, const struct list_elem*, void* aux);
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -94,6 +97,9 @@ bool sema_try_down(struct semaphore* sema) {
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
    and wakes up one thread of those waiting for SEMA, if any.
+   Under the strict-priority scheduler, that is the waiter with
+   the highest priority, which runs at once if it outranks the
+   running thread.
 
    This function may be called from an interrupt handler. */
 void sema_up(struct semaphore* sema) {
@@ -102,10 +108,25 @@ void sema_up(struct semaphore* sema) {
   ASSERT(sema != NULL);
 
   old_level = intr_disable();
-  if (!list_empty(&sema->waiters))
-    thread_unblock(list_entry(list_pop_front(&sema->waiters), struct thread, elem));
+  if (!list_empty(&sema->waiters)) {
+    struct list_elem* e = active_sched_policy == SCHED_PRIO
+                              ? list_max(&sema->waiters, thread_priority_less, NULL)
+                              : list_front(&sema->waiters);
+    list_remove(e);
+    thread_unblock(list_entry(e, struct thread, elem));
+  }
   sema->value++;
   intr_set_level(old_level);
+
+  thread_check_preemption();
+}
+
+/* Returns true if the priority of the thread whose `elem' is A
+   is less than that of the thread whose `elem' is B. */
+static bool thread_priority_less(const struct list_elem* a, const struct list_elem* b,
+                                 void* aux UNUSED) {
+  return list_entry(a, struct thread, elem)->priority <
+         list_entry(b, struct thread, elem)->priority;
 }
 
 static void sema_test_helper(void* sema_);
@@ -165,17 +186,32 @@ void lock_init(struct lock* lock) {
    necessary.  The lock must not already be held by the current
    thread.
 
+   Under the strict-priority scheduler, a thread that has to wait
+   donates its priority to the holder (see
+   thread_donate_priority()) until the lock is released.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
    we need to sleep. */
 void lock_acquire(struct lock* lock) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+
   ASSERT(lock != NULL);
   ASSERT(!intr_context());
   ASSERT(!lock_held_by_current_thread(lock));
 
+  old_level = intr_disable();
+  if (lock->holder != NULL && active_sched_policy == SCHED_PRIO) {
+    cur->waiting_lock = lock;
+    thread_donate_priority(cur);
+  }
   sema_down(&lock->semaphore);
-  lock->holder = thread_current();
+  cur->waiting_lock = NULL;
+  lock->holder = cur;
+  list_push_back(&cur->held_locks, &lock->elem);
+  intr_set_level(old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -185,28 +221,44 @@ void lock_acquire(struct lock* lock) {
    This function will not sleep, so it may be called within an
    interrupt handler. */
 bool lock_try_acquire(struct lock* lock) {
+  enum intr_level old_level;
   bool success;
 
   ASSERT(lock != NULL);
   ASSERT(!lock_held_by_current_thread(lock));
 
+  old_level = intr_disable();
   success = sema_try_down(&lock->semaphore);
-  if (success)
+  if (success) {
     lock->holder = thread_current();
+    list_push_back(&lock->holder->held_locks, &lock->elem);
+  }
+  intr_set_level(old_level);
   return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
 
+   Any priority donated through LOCK is given up, which may let a
+   waiter preempt the current thread at once.
+
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
    handler. */
 void lock_release(struct lock* lock) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+
   ASSERT(lock != NULL);
   ASSERT(lock_held_by_current_thread(lock));
 
+  old_level = intr_disable();
+  list_remove(&lock->elem);
   lock->holder = NULL;
+  if (active_sched_policy == SCHED_PRIO)
+    thread_update_priority(cur);
   sema_up(&lock->semaphore);
+  intr_set_level(old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -280,6 +332,7 @@ void rw_lock_release(struct rw_lock* rw_lock, bool reader) {
 struct semaphore_elem {
   struct list_elem elem;      /* List element. */
   struct semaphore semaphore; /* This semaphore. */
+  struct thread* thread;      /* Thread waiting on it. */
 };
 
 /* Initializes condition variable COND.  A condition variable
@@ -320,6 +373,7 @@ void cond_wait(struct condition* cond, struct lock* lock) {
   ASSERT(lock_held_by_current_thread(lock));
 
   sema_init(&waiter.semaphore, 0);
+  waiter.thread = thread_current();
   list_push_back(&cond->waiters, &waiter.elem);
   lock_release(lock);
   sema_down(&waiter.semaphore);
@@ -330,6 +384,9 @@ void cond_wait(struct condition* cond, struct lock* lock) {
    this function signals one of them to wake up from its wait.
    LOCK must be held before calling this function.
 
+   Under the strict-priority scheduler, the waiter with the
+   highest priority is signaled.
+
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
    interrupt handler. */
@@ -339,8 +396,21 @@ void cond_signal(struct condition* cond, struct lock* lock UNUSED) {
   ASSERT(!intr_context());
   ASSERT(lock_held_by_current_thread(lock));
 
-  if (!list_empty(&cond->waiters))
-    sema_up(&list_entry(list_pop_front(&cond->waiters), struct semaphore_elem, elem)->semaphore);
+  if (!list_empty(&cond->waiters)) {
+    struct list_elem* e = active_sched_policy == SCHED_PRIO
+                              ? list_max(&cond->waiters, waiter_priority_less, NULL)
+                              : list_front(&cond->waiters);
+    list_remove(e);
+    sema_up(&list_entry(e, struct semaphore_elem, elem)->semaphore);
+  }
+}
+
+/* Returns true if the priority of the thread waiting on
+   semaphore_elem A is less than that of the one waiting on B. */
+static bool waiter_priority_less(const struct list_elem* a, const struct list_elem* b,
+                                 void* aux UNUSED) {
+  return list_entry(a, struct semaphore_elem, elem)->thread->priority <
+         list_entry(b, struct semaphore_elem, elem)->thread->priority;
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -24,6 +24,17 @@
    that are ready to run but not actually running. */
 static struct list fifo_ready_list;
 
+/* Run queues of the strict-priority scheduler: a FIFO list of
+   THREAD_READY threads for each priority, and a bitmap in which
+   bit P is set whenever prio_ready_lists[P] is non-empty, so
+   that the highest non-empty list is found in constant time. */
+static struct list prio_ready_lists[PRI_MAX + 1];
+static uint64_t prio_ready_bitmap;
+
+#if PRI_MAX >= 64
+#error prio_ready_bitmap requires PRI_MAX < 64
+#endif
+
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
@@ -58,6 +69,9 @@ static bool is_thread(struct thread*) UNUSED;
 static void* alloc_frame(struct thread*, size_t size);
 static void schedule(void);
 static void thread_enqueue(struct thread* t);
+static void thread_dequeue(struct thread* t);
+static void thread_set_effective_priority(struct thread* t, int priority);
+static int highest_ready_priority(void);
 static tid_t allocate_tid(void);
 void thread_switch_tail(struct thread* prev);
 
@@ -104,10 +118,14 @@ scheduler_func* scheduler_jump_table[8] = {thread_schedule_fifo,     thread_sche
    It is not safe to call thread_current() until this function
    finishes. */
 void thread_init(void) {
+  int i;
+
   ASSERT(intr_get_level() == INTR_OFF);
 
   lock_init(&tid_lock);
   list_init(&fifo_ready_list);
+  for (i = PRI_MIN; i <= PRI_MAX; i++)
+    list_init(&prio_ready_lists[i]);
   list_init(&all_list);
 
   /* Set up a thread structure for the running thread. */
@@ -158,6 +176,14 @@ void thread_print_stats(void) {
          user_ticks);
 }
 
+/* Returns the number of timer ticks spent idle since boot. */
+long long thread_get_idle_ticks(void) {
+  enum intr_level old_level = intr_disable();
+  long long t = idle_ticks;
+  intr_set_level(old_level);
+  return t;
+}
+
 /* Creates a new kernel thread named NAME with the given initial
    PRIORITY, which executes FUNCTION passing AUX as the argument,
    and adds it to the ready queue.  Returns the thread identifier
@@ -170,9 +196,9 @@ void thread_print_stats(void) {
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   Under the strict-priority scheduler, a new thread with a
+   higher priority than the running thread preempts it before
+   thread_create() returns. */
 tid_t thread_create(const char* name, int priority, thread_func* function, void* aux) {
   struct thread* t;
   struct kernel_thread_frame* kf;
@@ -208,6 +234,7 @@ tid_t thread_create(const char* name, int priority, thread_func* function, void*
 
   /* Add to run queue. */
   thread_unblock(t);
+  thread_check_preemption();
 
   return tid;
 }
@@ -236,10 +263,41 @@ static void thread_enqueue(struct thread* t) {
 
   if (active_sched_policy == SCHED_FIFO)
     list_push_back(&fifo_ready_list, &t->elem);
-  else
+  else if (active_sched_policy == SCHED_PRIO) {
+    list_push_back(&prio_ready_lists[t->priority], &t->elem);
+    prio_ready_bitmap |= (uint64_t)1 << t->priority;
+  } else
     PANIC("Unimplemented scheduling policy value: %d", active_sched_policy);
 }
 
+/* Takes ready thread T off the strict-priority run queue it is
+   on.
+
+   This function must be called with interrupts turned off. */
+static void thread_dequeue(struct thread* t) {
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(t->status == THREAD_READY);
+  ASSERT(active_sched_policy == SCHED_PRIO);
+
+  list_remove(&t->elem);
+  if (list_empty(&prio_ready_lists[t->priority]))
+    prio_ready_bitmap &= ~((uint64_t)1 << t->priority);
+}
+
+/* Returns the priority of the highest-priority thread on the
+   strict-priority run queues, or -1 if they are empty. */
+static int highest_ready_priority(void) {
+  uint32_t high = prio_ready_bitmap >> 32;
+  uint32_t low = prio_ready_bitmap;
+
+  if (high != 0)
+    return 63 - __builtin_clz(high);
+  else if (low != 0)
+    return 31 - __builtin_clz(low);
+  else
+    return -1;
+}
+
 /* Transitions a blocked thread T to the ready-to-run state.
    This is an error if T is not blocked.  (Use thread_yield() to
    make the running thread ready.)
@@ -327,8 +385,106 @@ void thread_foreach(thread_action_func* func, void* aux) {
   }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
-void thread_set_priority(int new_priority) { thread_current()->priority = new_priority; }
+/* Sets the current thread's priority to NEW_PRIORITY.  Under
+   the strict-priority scheduler, priority donated to the thread
+   still counts, and the thread yields if it no longer has the
+   highest priority. */
+void thread_set_priority(int new_priority) {
+  struct thread* cur = thread_current();
+  enum intr_level old_level;
+
+  ASSERT(PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  old_level = intr_disable();
+  cur->base_priority = new_priority;
+  if (active_sched_policy == SCHED_PRIO)
+    thread_update_priority(cur);
+  else
+    cur->priority = new_priority;
+  intr_set_level(old_level);
+
+  thread_check_preemption();
+}
+
+/* Sets T's effective priority to PRIORITY, moving T to the
+   matching run queue if it is ready.
+
+   This function must be called with interrupts turned off. */
+static void thread_set_effective_priority(struct thread* t, int priority) {
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (t->status == THREAD_READY && t != idle_thread && t->priority != priority) {
+    thread_dequeue(t);
+    t->priority = priority;
+    thread_enqueue(t);
+  } else
+    t->priority = priority;
+}
+
+/* Donates T's priority to the holder of the lock T is waiting
+   for, and on through the holders of the locks those are waiting
+   for, up to DONATION_DEPTH holders.
+
+   This function must be called with interrupts turned off. */
+void thread_donate_priority(struct thread* t) {
+  struct lock* lock = t->waiting_lock;
+  int depth;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  for (depth = 0; lock != NULL && depth < DONATION_DEPTH; depth++) {
+    struct thread* holder = lock->holder;
+    if (holder == NULL || holder->priority >= t->priority)
+      break;
+    thread_set_effective_priority(holder, t->priority);
+    t = holder;
+    lock = holder->waiting_lock;
+  }
+}
+
+/* Recomputes T's effective priority as the highest of its own
+   priority and those of the threads waiting for locks it holds.
+
+   This function must be called with interrupts turned off. */
+void thread_update_priority(struct thread* t) {
+  int priority = t->base_priority;
+  struct list_elem *e, *w;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  for (e = list_begin(&t->held_locks); e != list_end(&t->held_locks); e = list_next(e)) {
+    struct list* waiters = &list_entry(e, struct lock, elem)->semaphore.waiters;
+    for (w = list_begin(waiters); w != list_end(waiters); w = list_next(w)) {
+      struct thread* waiter = list_entry(w, struct thread, elem);
+      if (waiter->priority > priority)
+        priority = waiter->priority;
+    }
+  }
+  thread_set_effective_priority(t, priority);
+}
+
+/* Under the strict-priority scheduler, yields the CPU if a ready
+   thread has a higher priority than the running thread.  In an
+   interrupt handler, the yield happens on return from the
+   interrupt. */
+void thread_check_preemption(void) {
+  enum intr_level old_level;
+  bool preempt;
+
+  if (active_sched_policy != SCHED_PRIO)
+    return;
+
+  old_level = intr_disable();
+  preempt = highest_ready_priority() > thread_current()->priority;
+  intr_set_level(old_level);
+
+  if (preempt) {
+    if (intr_context())
+      intr_yield_on_return();
+    else
+      thread_yield();
+  }
+}
 
 /* Returns the current thread's priority. */
 int thread_get_priority(void) { return thread_current()->priority; }
@@ -427,7 +583,8 @@ static void init_thread(struct thread* t, const char* name, int priority) {
   t->status = THREAD_BLOCKED;
   strlcpy(t->name, name, sizeof t->name);
   t->stack = (uint8_t*)t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  list_init(&t->held_locks);
   t->pcb = NULL;
   t->magic = THREAD_MAGIC;
 
@@ -455,9 +612,18 @@ static struct thread* thread_schedule_fifo(void) {
     return idle_thread;
 }
 
-/* Strict priority scheduler */
+/* Strict priority scheduler, round-robin within a priority */
 static struct thread* thread_schedule_prio(void) {
-  PANIC("Unimplemented scheduler policy: \"-sched=prio\"");
+  int priority = highest_ready_priority();
+  struct thread* t;
+
+  if (priority < 0)
+    return idle_thread;
+
+  t = list_entry(list_pop_front(&prio_ready_lists[priority]), struct thread, elem);
+  if (list_empty(&prio_ready_lists[priority]))
+    prio_ready_bitmap &= ~((uint64_t)1 << priority);
+  return t;
 }
 
 /* Fair priority scheduler */
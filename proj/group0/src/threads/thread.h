@@ -25,6 +25,10 @@ typedef int tid_t;
 #define PRI_DEFAULT 31 /* Default priority. */
 #define PRI_MAX 63     /* Highest priority. */
 
+/* Priority donation is followed through at most this many
+   nested lock holders. */
+#define DONATION_DEPTH 8
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -87,11 +91,14 @@ struct thread {
   enum thread_status status; /* Thread state. */
   char name[16];             /* Name (for debugging purposes). */
   uint8_t* stack;            /* Saved stack pointer. */
-  int priority;              /* Priority. */
+  int priority;              /* Effective priority, with donations. */
+  int base_priority;         /* Priority set by thread_set_priority(). */
   struct list_elem allelem;  /* List element for all threads list. */
 
   /* Shared between thread.c and synch.c. */
-  struct list_elem elem; /* List element. */
+  struct list_elem elem;     /* List element. */
+  struct list held_locks;    /* Locks held, whose waiters donate. */
+  struct lock* waiting_lock; /* Lock being waited for, or NULL. */
 
 #ifdef USERPROG
   /* Owned by process.c. */
@@ -123,6 +130,7 @@ void thread_start(void);
 
 void thread_tick(void);
 void thread_print_stats(void);
+long long thread_get_idle_ticks(void);
 
 typedef void thread_func(void* aux);
 tid_t thread_create(const char* name, int priority, thread_func*, void*);
@@ -143,6 +151,9 @@ void thread_foreach(thread_action_func*, void*);
 
 int thread_get_priority(void);
 void thread_set_priority(int);
+void thread_donate_priority(struct thread*);
+void thread_update_priority(struct thread*);
+void thread_check_preemption(void);
 
 int thread_get_nice(void);
 void thread_set_nice(int);